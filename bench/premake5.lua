@@ -0,0 +1,31 @@
+baseName = path.getbasename(os.getcwd());
+
+project (baseName)
+    kind "ConsoleApp"
+    location "../_build"
+    targetdir "../_bin/%{cfg.buildcfg}"
+
+    filter "action:vs*"
+        debugdir "$(SolutionDir)"
+
+    filter{}
+
+    vpaths 
+    {
+        ["Header Files/*"] = { "include/**.h",  "include/**.hpp", "src/**.h", "src/**.hpp", "**.h", "**.hpp"},
+        ["Source Files/*"] = {"src/**.c", "src/**.cpp","**.c", "**.cpp"},
+    }
+    files {"**.c", "**.cpp", "**.h", "**.hpp"}
+
+    includedirs { "./" }
+    includedirs { "src" }
+    includedirs { "include" }
+    -- The bench compiles the game's sources as its own translation unit
+    includedirs { "../game/src" }
+
+    link_raylib()
+
+    -- The game's co-op code comes along with its sources and talks UDP through winsock
+    filter "system:windows"
+        links {"ws2_32"}
+    filter {}
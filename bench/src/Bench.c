@@ -0,0 +1,365 @@
+/**
+ * @file Bench.c
+ * @author Kevin Pluas
+ * @brief Stress test that sweeps entity counts, spawn rates and fire rates
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * Runs the real game code from game/src at caps far beyond what the game uses and
+ * writes one CSV row per configuration to stdout, so results can be charted per commit.
+ *
+ * bench [--enemies 1000,10000,100000] [--spawn 1,16,256] [--fire 1,4,16] [--particles 0]
+ *       [--bullets N] [--frames N] [--warmup N] [--threads N] [--seed N] [--label TEXT] [--headless]
+ */
+
+// Pull the whole game in as this project's translation unit, minus its main()
+#define SWARM_NO_MAIN
+#include "Swarm.c"
+
+#if defined(GRAPHICS_API_OPENGL_33) || defined(GRAPHICS_API_OPENGL_43)
+    // raylib loads OpenGL through glad, whose function pointers are global. Wrapping
+    // the draw entry points counts every draw call raylib and the sprite batch make.
+    #include "external/glad.h"
+    #define BENCH_COUNT_DRAW_CALLS
+#endif
+
+#define BENCH_MAX_VALUES 16             // Values per swept option
+
+/**
+ * @brief One point of the sweep.
+ *
+ */
+typedef struct BenchConfig
+{
+    int enemies;        /**< Enemy cap, the pool is filled to it before measuring */
+    int bullets;        /**< Bullet cap */
+    int spawn;          /**< Enemies spawned per tick */
+    int fire;           /**< Ticks between shots */
+    int particles;      /**< Live particles kept on top of the game's own effects */
+} BenchConfig;
+
+/**
+ * @brief What one configuration measured. Times are per frame, in milliseconds.
+ *
+ */
+typedef struct BenchResult
+{
+    double liveEnemies;
+    double liveBullets;
+    double frameAvg;
+    double frameP99;
+    double updateAvg;
+    double renderAvg;
+    double drawCalls;
+    double spritesDrawn;    /**< Sprites the sprite queue drew and culled */
+    double spritesCulled;
+    double liveParticles;
+    size_t memoryBytes; /**< Pools and grid */
+} BenchResult;
+
+int drawCalls = 0;      // Draw calls since the start of the frame
+
+#if defined(BENCH_COUNT_DRAW_CALLS)
+PFNGLDRAWARRAYSPROC drawArrays = NULL;
+PFNGLDRAWELEMENTSPROC drawElements = NULL;
+PFNGLDRAWARRAYSINSTANCEDPROC drawArraysInstanced = NULL;
+PFNGLDRAWELEMENTSINSTANCEDPROC drawElementsInstanced = NULL;
+
+static void GLAD_API_PTR countDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    drawCalls++;
+    drawArrays(mode, first, count);
+}
+
+static void GLAD_API_PTR countDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices)
+{
+    drawCalls++;
+    drawElements(mode, count, type, indices);
+}
+
+static void GLAD_API_PTR countDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+{
+    drawCalls++;
+    drawArraysInstanced(mode, first, count, instances);
+}
+
+static void GLAD_API_PTR countDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instances)
+{
+    drawCalls++;
+    drawElementsInstanced(mode, count, type, indices, instances);
+}
+#endif
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+int parseList(const char *text, int *values, int minimum);
+void hookDrawCalls();
+BenchResult runBenchConfig(BenchConfig config, int warmup, int frames, bool render);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+    int enemyCounts[BENCH_MAX_VALUES] = { 1000, 10000, 100000 };
+    int spawnRates[BENCH_MAX_VALUES] = { 1, 16, 256 };
+    int fireRates[BENCH_MAX_VALUES] = { 1, 4, 16 };
+    int particleCounts[BENCH_MAX_VALUES] = { 0 };
+    int enemyCountTotal = 3;
+    int spawnRateTotal = 3;
+    int fireRateTotal = 3;
+    int particleCountTotal = 1;
+    int bullets = 1000;
+    int frames = 300;
+    int warmup = 60;
+    int threads = 0;
+    uint64_t seed = 1;
+    const char *label = "";
+    bool render = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--headless") == 0) render = false;
+        else if (i + 1 < argc)
+        {
+            if (strcmp(argv[i], "--enemies") == 0) enemyCountTotal = parseList(argv[++i], enemyCounts, 1);
+            else if (strcmp(argv[i], "--spawn") == 0) spawnRateTotal = parseList(argv[++i], spawnRates, 1);
+            else if (strcmp(argv[i], "--fire") == 0) fireRateTotal = parseList(argv[++i], fireRates, 1);
+            else if (strcmp(argv[i], "--particles") == 0) particleCountTotal = parseList(argv[++i], particleCounts, 0);
+            else if (strcmp(argv[i], "--bullets") == 0) bullets = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--frames") == 0) frames = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--warmup") == 0) warmup = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--threads") == 0) threads = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--seed") == 0) seed = strtoull(argv[++i], NULL, 10);
+            else if (strcmp(argv[i], "--label") == 0) label = argv[++i];
+        }
+    }
+    if (frames <= 0)
+    {
+        TraceLog(LOG_ERROR, "--frames must be at least 1");
+        return 1;
+    }
+
+    SetTraceLogLevel(LOG_WARNING);
+    if (render)
+    {
+        // Hidden and uncapped, so frame time is the work and not the frame limiter
+        SetConfigFlags(FLAG_WINDOW_HIDDEN);
+        InitWindow(screenWidth, screenHeight, "Swarm bench");
+        SetTargetFPS(0);
+        loadResources();
+        hookDrawCalls();
+    }
+    initJobSystem(threads);
+
+    printf("label,enemies,bullets,spawn,fire,threads,simd,frames,live_enemies,live_bullets,"
+           "frame_ms,frame_p99_ms,update_ms,render_ms,draw_calls,memory_kb,sprites_drawn,sprites_culled,particles,live_particles\n");
+    for (int e = 0; e < enemyCountTotal; e++)
+    {
+        for (int s = 0; s < spawnRateTotal; s++)
+        {
+            for (int f = 0; f < fireRateTotal; f++)
+            {
+                for (int p = 0; p < particleCountTotal; p++)
+                {
+                    BenchConfig config = { enemyCounts[e], bullets, spawnRates[s], fireRates[f], particleCounts[p] };
+                    seedRandom(seed);
+
+                    BenchResult result = runBenchConfig(config, warmup, frames, render);
+                    printf("%s,%d,%d,%d,%d,%d,%s,%d,%.1f,%.1f,%.4f,%.4f,%.4f,%.4f,%.1f,%zu,%.1f,%.1f,%d,%.1f\n",
+                           label, config.enemies, config.bullets, config.spawn, config.fire,
+                           jobSystem.threadCount, steeringBackend, frames,
+                           result.liveEnemies, result.liveBullets,
+                           result.frameAvg, result.frameP99, result.updateAvg, result.renderAvg,
+                           result.drawCalls, result.memoryBytes / 1024, result.spritesDrawn, result.spritesCulled,
+                           config.particles, result.liveParticles);
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+
+    shutdownJobSystem();
+    if (render)
+    {
+        unloadResources();
+        CloseWindow();
+    }
+    return 0;
+}
+
+// Reads a comma separated list of up to BENCH_MAX_VALUES integers, skipping any below minimum
+int parseList(const char *text, int *values, int minimum)
+{
+    int count = 0;
+    while (*text != '\0' && count < BENCH_MAX_VALUES)
+    {
+        int value = atoi(text);
+        if (value >= minimum)
+        {
+            values[count++] = value;
+        }
+        const char *comma = strchr(text, ',');
+        if (comma == NULL)
+        {
+            break;
+        }
+        text = comma + 1;
+    }
+    return count;
+}
+
+// Swaps glad's draw entry points for counting wrappers. Needs the window's context
+void hookDrawCalls()
+{
+#if defined(BENCH_COUNT_DRAW_CALLS)
+    drawArrays = glad_glDrawArrays;
+    drawElements = glad_glDrawElements;
+    drawArraysInstanced = glad_glDrawArraysInstanced;
+    drawElementsInstanced = glad_glDrawElementsInstanced;
+
+    glad_glDrawArrays = countDrawArrays;
+    glad_glDrawElements = countDrawElements;
+    if (drawArraysInstanced != NULL) glad_glDrawArraysInstanced = countDrawArraysInstanced;
+    if (drawElementsInstanced != NULL) glad_glDrawElementsInstanced = countDrawElementsInstanced;
+#else
+    TraceLog(LOG_WARNING, "Draw calls are only counted on OpenGL 3.3 and 4.3 builds");
+#endif
+}
+
+/**
+ * @brief Fills the enemy pool to its cap, then runs one tick and (unless render is
+ * false) renders one frame per measured frame. Every configuration starts from the
+ * same seed and a fresh game.
+ *
+ * @param config
+ * @param warmup Frames run before measuring
+ * @param frames Frames measured
+ * @param render False to only time the simulation
+ * @return BenchResult
+ */
+BenchResult runBenchConfig(BenchConfig config, int warmup, int frames, bool render)
+{
+    BenchResult result = { 0 };
+
+    MAX_ENEMIES = config.enemies;
+    MAX_BULLETS = config.bullets;
+    Entity *player = initPlayer();
+    EntityPool *bullets = initBullets();
+    EntityPool *enemies = initEnemies();
+    SpatialGrid *grid = initGrid(worldWidth, worldHeight, GRID_CELL_SIZE, MAX_ENEMIES, ENEMY_SIZE);
+    FlowField *flow = initFlowField(worldWidth, worldHeight, FLOW_CELL_SIZE);
+    Flock *flock = initFlock(worldWidth, worldHeight, MAX_ENEMIES);
+    if (player == NULL || bullets == NULL || enemies == NULL || grid == NULL || flow == NULL || flock == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error initializing the bench session");
+        cleanupEntities(bullets, enemies, grid, flow, flock, player);
+        return result;
+    }
+    // The game's own effects only run when there is something to see, or to stress
+    if ((render || config.particles > 0) && !initParticles(&particles, MAX_PARTICLES + config.particles))
+    {
+        cleanupEntities(bullets, enemies, grid, flow, flock, player);
+        return result;
+    }
+    result.memoryBytes = getPoolBytes(bullets) + getPoolBytes(enemies) + getGridBytes(grid) + getFlockBytes(flock) +
+                         getParticleBytes(&particles);
+
+    // The player never moves far, so the swarm stays around the view it starts in
+    Rectangle view = getWorldView(getPlayerFocus(player, 1.0f));
+    PowerUp powerup;
+    createPowerup(&powerup, view);
+    long long frame = 0;
+    int previousScore = 0;
+    GameScreen currentScreen = GAMEPLAY;
+    PlayerInput input = { 0 };
+
+    currentScore = 0;
+    CURRENT_MAX_ENEMIES = ENEMY_CAP_LIMIT = MAX_ENEMIES;
+    CURRENT_MAX_BULLETS = BULLET_CAP_LIMIT = MAX_BULLETS;
+    playerV = createVector2(player->body.x, player->body.y);
+    while (enemies->count < MAX_ENEMIES)
+    {
+        generateNewEnemy(enemies, playerV, view, &defaultEnemyKind);
+    }
+
+    float *frameTimes = MemAlloc(sizeof(float) * frames);
+    for (int f = 0; f < warmup + frames; f++)
+    {
+        bool measured = f >= warmup;
+        double frameStart = getTimerSeconds();
+
+        // Bursts all over the screen keep the particle count topped up
+        while (particles.count < config.particles)
+        {
+            Vector2 position = { view.x + randomInt(RANDOM_EFFECTS, 0, screenWidth), view.y + randomInt(RANDOM_EFFECTS, 0, screenHeight) };
+            emitParticles(&particles, &enemyDeath, position, Vector2Zero());
+        }
+
+        // The game itself spawns one enemy per tick
+        for (int s = 1; s < config.spawn; s++)
+        {
+            generateNewEnemy(enemies, playerV, view, &defaultEnemyKind);
+        }
+        if (f % config.fire == 0)
+        {
+            input.fire = true;
+            input.aim = (Vector2){ view.x + randomInt(RANDOM_INPUT, 0, screenWidth), view.y + randomInt(RANDOM_INPUT, 0, screenHeight) };
+        }
+        updateGameplay(player, bullets, enemies, grid, flow, flock, &powerup, &input, &frame, &previousScore, &currentScreen);
+        if (currentScreen == ENDING)
+        { // Keep the swarm at full size instead of restarting
+            player->health = PLAYER_HEALTH;
+            currentScreen = GAMEPLAY;
+        }
+        double updateEnd = getTimerSeconds();
+
+        drawCalls = 0;
+        if (render)
+        {
+            BeginDrawing();
+            ClearBackground(RAYWHITE);
+            renderScreen(player, NULL, bullets, enemies, &powerup, frame, 1.0f);
+            renderHUD(player, NULL, frame, currentScore);
+            EndDrawing();
+        }
+        double frameEnd = getTimerSeconds();
+
+        if (measured)
+        {
+            frameTimes[f - warmup] = (float)((frameEnd - frameStart) * 1000.0);
+            result.updateAvg += (updateEnd - frameStart) * 1000.0;
+            result.renderAvg += (frameEnd - updateEnd) * 1000.0;
+            result.drawCalls += drawCalls;
+            result.spritesDrawn += spriteStats.drawn;
+            result.spritesCulled += spriteStats.culled;
+            result.liveParticles += particles.count;
+            result.liveEnemies += enemies->count;
+            result.liveBullets += bullets->count;
+        }
+    }
+
+    for (int f = 0; f < frames; f++)
+    {
+        result.frameAvg += frameTimes[f];
+    }
+    qsort(frameTimes, frames, sizeof(float), compareFloats);
+    result.frameP99 = frameTimes[(frames * 99 + 99) / 100 - 1];
+    result.frameAvg /= frames;
+    result.updateAvg /= frames;
+    result.renderAvg /= frames;
+    result.drawCalls /= frames;
+    result.spritesDrawn /= frames;
+    result.spritesCulled /= frames;
+    result.liveParticles /= frames;
+    result.liveEnemies /= frames;
+    result.liveBullets /= frames;
+
+    MemFree(frameTimes);
+    unloadParticles(&particles);
+    cleanupEntities(bullets, enemies, grid, flow, flock, player);
+    return result;
+}
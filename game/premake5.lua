@@ -30,5 +30,10 @@ project (workspaceName)
     includedirs { "include" }
 	
 	link_raylib()
+
+	-- Co-op play talks UDP through winsock
+	filter "system:windows"
+		links {"ws2_32"}
+	filter {}
 	
 	-- To link to a lib use link_to("LIB_FOLDER_NAME")
\ No newline at end of file
@@ -0,0 +1,195 @@
+/**
+ * @file Atlas.h
+ * @author Kevin Pluas
+ * @brief Packs the game's sprites into one texture at load time
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _ATLAS_H
+#define _ATLAS_H
+
+#include <string.h>
+
+#include "Structs.h"
+#include "rlgl.h"
+
+#if defined(__GNUC__)
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+// raylib exports its own copy for font packing, so keep this one private
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "external/stb_rect_pack.h"
+#if defined(__GNUC__)
+    #pragma GCC diagnostic pop
+#endif
+
+#define ATLAS_PADDING 2         // Empty pixels around every region so neighbours never bleed in
+#define ATLAS_MIN_SIZE 256
+#define ATLAS_MAX_SIZE 4096
+#define ATLAS_WHITE "white"     // Name of the solid white region used for shapes
+
+TextureAtlas spriteAtlas = { 0 };
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+bool loadAtlas(const char *directory);
+Rectangle getAtlasRegion(const char *name);
+void drawAtlasSprite(Rectangle sprite, Rectangle dest, Vector2 origin, float rotation, Color tint);
+void drawAtlasSpriteEx(Rectangle sprite, Vector2 position, float scale, Color tint);
+void unloadAtlas();
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+/**
+ * @brief Packs every .png in directory, plus a small white square, into spriteAtlas.
+ * The texture starts at ATLAS_MIN_SIZE and doubles until everything fits.
+ *
+ * Shapes are pointed at the white square, so rectangles and circles are drawn from the
+ * atlas too and don't break the batch either.
+ *
+ * @param directory e.g. "resources". Subdirectories are ignored.
+ * @return true if the atlas was built
+ */
+bool loadAtlas(const char *directory)
+{
+    FilePathList files = LoadDirectoryFilesEx(directory, ".png", false);
+    int count = files.count + 1;
+
+    Image *images = MemAlloc(sizeof(Image) * count);
+    stbrp_rect *rects = MemAlloc(sizeof(stbrp_rect) * count);
+    stbrp_node *nodes = MemAlloc(sizeof(stbrp_node) * ATLAS_MAX_SIZE);
+    spriteAtlas.regions = MemAlloc(sizeof(AtlasRegion) * count);
+    if (images == NULL || rects == NULL || nodes == NULL || spriteAtlas.regions == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error initializing sprite atlas");
+        MemFree(images);
+        MemFree(rects);
+        MemFree(nodes);
+        MemFree(spriteAtlas.regions);
+        UnloadDirectoryFiles(files);
+        spriteAtlas = (TextureAtlas){ 0 };
+        return false;
+    }
+
+    for (unsigned int i = 0; i < files.count; i++)
+    {
+        images[i] = LoadImage(files.paths[i]);
+        strncpy(spriteAtlas.regions[i].name, GetFileNameWithoutExt(files.paths[i]), sizeof(spriteAtlas.regions[i].name) - 1);
+    }
+    images[count - 1] = GenImageColor(4, 4, WHITE);
+    strncpy(spriteAtlas.regions[count - 1].name, ATLAS_WHITE, sizeof(spriteAtlas.regions[count - 1].name) - 1);
+
+    for (int i = 0; i < count; i++)
+    {
+        rects[i] = (stbrp_rect){ .id = i, .w = images[i].width + 2 * ATLAS_PADDING, .h = images[i].height + 2 * ATLAS_PADDING };
+    }
+
+    int size = ATLAS_MIN_SIZE;
+    bool packed = false;
+    for (; size <= ATLAS_MAX_SIZE && !packed; size *= 2)
+    {
+        stbrp_context context;
+        stbrp_init_target(&context, size, size, nodes, size);
+        packed = stbrp_pack_rects(&context, rects, count);
+    }
+    size /= 2;
+
+    if (packed)
+    {
+        Image atlasImage = GenImageColor(size, size, BLANK);
+        for (int i = 0; i < count; i++)
+        {
+            Rectangle source = { rects[i].x + ATLAS_PADDING, rects[i].y + ATLAS_PADDING, images[i].width, images[i].height };
+            ImageDraw(&atlasImage, images[i], (Rectangle){ 0, 0, images[i].width, images[i].height }, source, WHITE);
+            spriteAtlas.regions[i].source = source;
+        }
+        spriteAtlas.texture = LoadTextureFromImage(atlasImage);
+        spriteAtlas.count = count;
+        UnloadImage(atlasImage);
+
+        TraceLog(LOG_INFO, "Packed %d sprites into a %dx%d atlas", count, size, size);
+    }
+    else
+    {
+        TraceLog(LOG_ERROR, "Sprites in %s don't fit a %dx%d atlas", directory, ATLAS_MAX_SIZE, ATLAS_MAX_SIZE);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        UnloadImage(images[i]);
+    }
+    MemFree(images);
+    MemFree(rects);
+    MemFree(nodes);
+    UnloadDirectoryFiles(files);
+
+    if (!packed)
+    {
+        MemFree(spriteAtlas.regions);
+        spriteAtlas = (TextureAtlas){ 0 };
+        return false;
+    }
+
+    // Inset by a pixel so shapes never sample the padding
+    Rectangle white = getAtlasRegion(ATLAS_WHITE);
+    SetShapesTexture(spriteAtlas.texture, (Rectangle){ white.x + 1, white.y + 1, white.width - 2, white.height - 2 });
+
+    return true;
+}
+
+/**
+ * @brief Looks a region up by name. Meant for load time, keep the result rather than
+ * calling this every frame.
+ *
+ * @param name File name without the extension
+ * @return Rectangle The region, or an empty one if there is no such sprite
+ */
+Rectangle getAtlasRegion(const char *name)
+{
+    for (int i = 0; i < spriteAtlas.count; i++)
+    {
+        if (strcmp(spriteAtlas.regions[i].name, name) == 0)
+        {
+            return spriteAtlas.regions[i].source;
+        }
+    }
+
+    TraceLog(LOG_WARNING, "No sprite named %s in the atlas", name);
+    return (Rectangle){ 0 };
+}
+
+// DrawTexturePro() for a region of the atlas
+void drawAtlasSprite(Rectangle sprite, Rectangle dest, Vector2 origin, float rotation, Color tint)
+{
+    DrawTexturePro(spriteAtlas.texture, sprite, dest, origin, rotation, tint);
+}
+
+// DrawTextureEx() without rotation for a region of the atlas
+void drawAtlasSpriteEx(Rectangle sprite, Vector2 position, float scale, Color tint)
+{
+    DrawTexturePro(spriteAtlas.texture, sprite, (Rectangle){ position.x, position.y, sprite.width * scale, sprite.height * scale }, Vector2Zero(), 0.0f, tint);
+}
+
+// Frees the atlas and gives shapes back raylib's default texture
+void unloadAtlas()
+{
+    if (spriteAtlas.count == 0)
+    {
+        return;
+    }
+
+    SetShapesTexture((Texture2D){ rlGetTextureIdDefault(), 1, 1, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 }, (Rectangle){ 0, 0, 1, 1 });
+    UnloadTexture(spriteAtlas.texture);
+    MemFree(spriteAtlas.regions);
+    spriteAtlas = (TextureAtlas){ 0 };
+}
+#endif
@@ -0,0 +1,156 @@
+/**
+ * @file Bot.h
+ * @author Kevin Pluas
+ * @brief A bot that plays the game from its state, for long unattended runs
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _BOT_H
+#define _BOT_H
+
+#include <math.h>
+#include <float.h>
+
+#include "Structs.h"
+#include "Globals.h"
+
+#define BOT_DANGER_RADIUS 320.0f    // Enemies closer than this push the bot away
+#define BOT_WALL_MARGIN 160.0f      // Walls closer than this push the bot back towards the middle
+#define BOT_POWERUP_RANGE 640.0f    // Power-ups further than this aren't worth the walk
+#define BOT_ORBIT 0.6f              // How much the bot circles the swarm rather than backing straight off
+#define BOT_TURN 0.2f               // Share of its new heading the bot turns towards each tick
+#define BOT_KEY_THRESHOLD 0.38f     // Heading needed on an axis to hold its key, about 22 degrees off the other axis
+#define BOT_PINNED_TICKS 60         // Ticks against a wall before the bot circles the other way
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+void initBot(Bot *bot);
+void updateBot(Bot *bot, PlayerInput *input, Entity *player, EntityPool *enemies, PowerUp *powerup);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+void initBot(Bot *bot)
+{
+    bot->heading = Vector2Zero();
+    bot->orbit = 1.0f;
+    bot->wallTicks = 0;
+}
+
+/**
+ * @brief Decides the bot's input for the next tick. It backs away from the enemies close
+ * to it while circling them, so the swarm follows it around instead of cornering it,
+ * walks over to power-ups when nothing is in the way and shoots the nearest enemy,
+ * leading it by the time the bullet takes to get there.
+ *
+ * Reads every live enemy once, which costs about as much as one of the enemy passes of
+ * a tick.
+ *
+ * @param bot
+ * @param input Written in full, fire included
+ * @param player The player the bot plays
+ * @param enemies
+ * @param powerup
+ */
+void updateBot(Bot *bot, PlayerInput *input, Entity *player, EntityPool *enemies, PowerUp *powerup)
+{
+    Vector2 center = { player->body.x + player->body.width / 2, player->body.y + player->body.height / 2 };
+
+    // Closer enemies push harder, fading to nothing at BOT_DANGER_RADIUS
+    int nearest = -1;
+    float nearestDistance = FLT_MAX;
+    Vector2 flee = Vector2Zero();
+    float danger = 0.0f;
+    for (int i = 0; i < enemies->count; i++)
+    {
+        float dx = center.x - (enemies->x[i] + enemies->width[i] / 2);
+        float dy = center.y - (enemies->y[i] + enemies->height[i] / 2);
+        float distance = dx * dx + dy * dy;
+        if (distance < nearestDistance)
+        {
+            nearestDistance = distance;
+            nearest = i;
+        }
+        if (distance < BOT_DANGER_RADIUS * BOT_DANGER_RADIUS && distance > 1.0f)
+        {
+            distance = sqrtf(distance);
+            float weight = 1.0f - distance / BOT_DANGER_RADIUS;
+            flee.x += dx / distance * weight;
+            flee.y += dy / distance * weight;
+            danger += weight;
+        }
+    }
+
+    Vector2 desired = Vector2Zero();
+    if (danger > 0.0f)
+    {
+        flee = Vector2Normalize(flee);
+        desired = Vector2Add(flee, Vector2Scale((Vector2){ -flee.y, flee.x }, BOT_ORBIT * bot->orbit));
+    }
+
+    // Power-ups are worth less the more enemies are in the way
+    if (powerup->isActive && Vector2Distance(center, powerup->position) < BOT_POWERUP_RANGE)
+    {
+        Vector2 towards = Vector2Normalize(Vector2Subtract(powerup->position, center));
+        desired = Vector2Add(desired, Vector2Scale(towards, 1.0f / (1.0f + danger)));
+    }
+    else if (danger == 0.0f)
+    { // Nothing to run from or pick up, drift back to the middle where there is room to run
+        Vector2 middle = { worldWidth / 2.0f, worldHeight / 2.0f };
+        if (Vector2Distance(center, middle) > BOT_DANGER_RADIUS)
+        {
+            desired = Vector2Scale(Vector2Normalize(Vector2Subtract(middle, center)), 0.5f);
+        }
+    }
+
+    // Walls push back. Stuck against one, the bot turns round and circles the other way
+    float left = center.x;
+    float right = worldWidth - center.x;
+    float top = center.y;
+    float bottom = worldHeight - center.y;
+    if (left < BOT_WALL_MARGIN) desired.x += 2.0f * (1.0f - left / BOT_WALL_MARGIN);
+    if (right < BOT_WALL_MARGIN) desired.x -= 2.0f * (1.0f - right / BOT_WALL_MARGIN);
+    if (top < BOT_WALL_MARGIN) desired.y += 2.0f * (1.0f - top / BOT_WALL_MARGIN);
+    if (bottom < BOT_WALL_MARGIN) desired.y -= 2.0f * (1.0f - bottom / BOT_WALL_MARGIN);
+    if (fminf(fminf(left, right), fminf(top, bottom)) < BOT_WALL_MARGIN / 2)
+    {
+        if (++bot->wallTicks > BOT_PINNED_TICKS)
+        {
+            bot->orbit = -bot->orbit;
+            bot->wallTicks = 0;
+        }
+    }
+    else
+    {
+        bot->wallTicks = 0;
+    }
+
+    bot->heading = Vector2Lerp(bot->heading, Vector2Normalize(desired), BOT_TURN);
+    input->right = bot->heading.x > BOT_KEY_THRESHOLD;
+    input->left = bot->heading.x < -BOT_KEY_THRESHOLD;
+    input->down = bot->heading.y > BOT_KEY_THRESHOLD;
+    input->up = bot->heading.y < -BOT_KEY_THRESHOLD;
+
+    if (nearest < 0)
+    {
+        input->fire = false;
+        return;
+    }
+
+    // Bullets leave from the player's corner, see createBullet(). Aim so that the bullet's
+    // center crosses where the enemy's center will be when it gets there
+    Vector2 muzzle = { player->body.x + 5 + BULLET_SIZE / 2, player->body.y + 5 + BULLET_SIZE / 2 };
+    Vector2 target = { enemies->x[nearest] + enemies->width[nearest] / 2, enemies->y[nearest] + enemies->height[nearest] / 2 };
+    float flightTicks = Vector2Distance(muzzle, target) / BULLET_SPEED;
+    target.x += enemies->directionX[nearest] * enemies->speed[nearest] * flightTicks;
+    target.y += enemies->directionY[nearest] * enemies->speed[nearest] * flightTicks;
+    input->aim = Vector2Add((Vector2){ player->body.x, player->body.y }, Vector2Subtract(target, muzzle));
+    input->fire = true;
+}
+
+#endif
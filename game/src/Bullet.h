@@ -12,35 +12,42 @@
 #ifndef _BULLET_H
 #define _BULLET_H
 
+#include <math.h>
 #include <stdlib.h>
 
 #include "Structs.h"
+#include "Pool.h"
+#include "Jobs.h"
+#include "Steering.h"
+#include "SpriteBatch.h"
+#include "Atlas.h"
+#include "Particles.h"
 
 //----------------------------------------------------------------------------------
 // Function Declarations
 //----------------------------------------------------------------------------------
-Entity **initBullets();
+EntityPool *initBullets();
 
-void createBullet(Entity **bullets, Vector2 playerV, Vector2 mouseV);
-void updateBullets(Entity **bullets);
-void checkBulletCollisions(Entity **bullets);
-void renderBullets(Entity **bullets);
+void createBullet(EntityPool *bullets, Vector2 playerV, Vector2 mouseV);
+int spawnBullet(EntityPool *bullets, int limit, Vector2 playerV, Vector2 direction, float speed, float size);
+void updateBullets(EntityPool *bullets, EntityPool *enemies);
+void steerBullets(EntityPool *bullets, EntityPool *enemies);
+void updateBulletRange(void *data, int start, int end);
+void checkBulletCollisions(EntityPool *bullets, Rectangle view);
+bool sweepBullet(EntityPool *bullets, int bullet, Rectangle target, float *time);
+void renderBullets(EntityPool *bullets);
 
 //----------------------------------------------------------------------------------
 // Function Definitions
 //----------------------------------------------------------------------------------
-Entity **initBullets()
+EntityPool *initBullets()
 {
-    Entity **bullets = MemAlloc(sizeof(Entity) * MAX_BULLETS);
+    EntityPool *bullets = initPool(MAX_BULLETS, ARCHETYPE_BULLET);
     if (bullets == NULL)
     {
         TraceLog(LOG_ERROR, "Error initializing bullets");
         return NULL;
     }
-    for (int i = 0; i < MAX_BULLETS; i++)
-    {
-        bullets[i] = NULL;
-    }
 
     return bullets;
 }
@@ -52,99 +59,226 @@ Entity **initBullets()
  * @param playerV 
  * @param mouseV 
  */
-void createBullet(Entity **bullets, Vector2 playerV, Vector2 mouseV)
+void createBullet(EntityPool *bullets, Vector2 playerV, Vector2 mouseV)
 {
-    for (int i = 0; i < CURRENT_MAX_BULLETS; i++)
-    { // create a single bullet in the first non null space
-        if (bullets[i] == NULL)
-        {
-            Entity *bullet = MemAlloc(sizeof(Entity));
-            if (!bullet)
-            {
-                TraceLog(LOG_ERROR, "Error: Unable to create bullet");
-                return;
-            }
+    Vector2 direction = Vector2Normalize(Vector2Subtract(mouseV, playerV));
+    int bullet = spawnBullet(bullets, CURRENT_MAX_BULLETS, playerV, direction, BULLET_SPEED, BULLET_SIZE);
+    if (bullet < 0)
+    { // Every bullet allowed on screen is already in flight
+        return;
+    }
 
-            // Setting the initial stats
-            bullet->body.height = bullet->body.width = 10;
-            bullet->body.x = playerV.x + 5;
-            bullet->body.y = playerV.y + 5;
-            bullet->speed = 8.0f;
-            bullet->health = 1;
-            bullet->direction = Vector2Normalize(Vector2Subtract(mouseV, playerV));
-
-            // put bullet in bullets :)
-            bullets[i] = bullet;
-            PlaySound(gunFx);
-            // TraceLog(LOG_INFO, "BULLET CREATED");
-            return;
-        }
+    if (!resimulating)
+    {
+        PlaySound(gunFx);
     }
+    emitParticles(&particles, &muzzleFlash,
+                  (Vector2){ bullets->x[bullet] + BULLET_SIZE / 2, bullets->y[bullet] + BULLET_SIZE / 2 }, direction);
+    // TraceLog(LOG_INFO, "BULLET CREATED");
+}
+
+/**
+ * @brief Spawns a bullet leaving the player's corner along direction, with no sound or
+ * effect. Patterns fire through this, so a volley only plays its effects once.
+ *
+ * @param bullets
+ * @param limit Bullets allowed in flight
+ * @param playerV Top left corner of the shooter
+ * @param direction Normalized
+ * @param speed Pixels per tick
+ * @param size
+ * @return int The bullet's index, or -1 if limit bullets are already in flight
+ */
+int spawnBullet(EntityPool *bullets, int limit, Vector2 playerV, Vector2 direction, float speed, float size)
+{
+    int bullet = spawnEntity(bullets, limit);
+    if (bullet < 0)
+    {
+        return -1;
+    }
+
+    // Setting the initial stats
+    bullets->height[bullet] = bullets->width[bullet] = size;
+    bullets->x[bullet] = bullets->previousX[bullet] = playerV.x + 5;
+    bullets->y[bullet] = bullets->previousY[bullet] = playerV.y + 5;
+    bullets->speed[bullet] = speed;
+    bullets->directionX[bullet] = direction.x;
+    bullets->directionY[bullet] = direction.y;
+    return bullet;
 }
 
 /**
  * @brief Check if a bullet has gone out of bounds. If it has, destroy it.
  * 
  * @param bullets 
+ * @param view The area of the world on screen. Bullets that leave it are gone
  */
-void checkBulletCollisions(Entity **bullets)
+void checkBulletCollisions(EntityPool *bullets, Rectangle view)
 {
-    for (int i = 0; i < CURRENT_MAX_BULLETS; i++)
+    for (int i = bullets->count - 1; i >= 0; i--)
     { // one of two things happen, either it goes out of bounds , or it collides with an enemy
-        if (bullets[i] != NULL)
+        if (
+            bullets->x[i] > view.x + view.width ||
+            bullets->x[i] < view.x ||
+            bullets->y[i] > view.y + view.height ||
+            bullets->y[i] < view.y)
+        {
+            TraceLog(LOG_INFO, "BULLET DESTROYED");
+            despawnEntity(bullets, i);
+        }
+    }
+}
+
+/**
+ * @brief Tests the path a bullet covered during the last tick against target, rather
+ * than only where it ended up, so a bullet faster than target is wide can't skip over
+ * it. The bullet's body is swept from its previous position to its current one, which
+ * is a segment against target grown by the size of the bullet.
+ *
+ * @param bullets
+ * @param bullet
+ * @param target Tested where it is now
+ * @param time Set to how far along the path the bullet first touches target, from 0 to 1
+ * @return true if the bullet touched target
+ */
+bool sweepBullet(EntityPool *bullets, int bullet, Rectangle target, float *time)
+{
+    float origin[2] = { bullets->previousX[bullet], bullets->previousY[bullet] };
+    float delta[2] = { bullets->x[bullet] - origin[0], bullets->y[bullet] - origin[1] };
+    float min[2] = { target.x - bullets->width[bullet], target.y - bullets->height[bullet] };
+    float max[2] = { target.x + target.width, target.y + target.height };
+
+    // Bodies only collide when they overlap, as in CheckCollisionRecs(), so touching
+    // edges don't count
+    float enter = 0.0f, exit = 1.0f;
+    for (int axis = 0; axis < 2; axis++)
+    {
+        if (delta[axis] == 0.0f)
         {
-            if (
-                bullets[i]->body.x > screenWidth ||
-                bullets[i]->body.x < 0 ||
-                bullets[i]->body.y > screenHeight ||
-                bullets[i]->body.y < 0)
+            if (origin[axis] <= min[axis] || origin[axis] >= max[axis])
             {
-                TraceLog(LOG_INFO, "BULLET DESTROYED");
-                MemFree(bullets[i]);
-                bullets[i] = NULL;
+                return false;
             }
+            continue;
+        }
+
+        float near = (min[axis] - origin[axis]) / delta[axis];
+        float far = (max[axis] - origin[axis]) / delta[axis];
+        if (near > far)
+        {
+            float swap = near;
+            near = far;
+            far = swap;
+        }
+        enter = fmaxf(enter, near);
+        exit = fminf(exit, far);
+        if (enter >= exit)
+        {
+            return false;
         }
     }
+
+    *time = enter;
+    return true;
 }
 
 /**
- * @brief Updates the position of all the bullets on screen
+ * @brief Updates the position of all the bullets on screen. Homing bullets turn first.
+ * Large volleys are split across the job threads.
  * 
  * @param bullets 
+ * @param enemies What homing bullets are after
  */
-void updateBullets(Entity **bullets)
+void updateBullets(EntityPool *bullets, EntityPool *enemies)
 {
-    for (int i = 0; i < CURRENT_MAX_BULLETS; i++)
+    if (!queryPool(bullets, COMPONENT_POSITION | COMPONENT_PREVIOUS | COMPONENT_DIRECTION | COMPONENT_SPEED, "updateBullets"))
     {
-        if (bullets[i] != NULL)
+        return;
+    }
+    steerBullets(bullets, enemies);
+    UpdateJob job = { .pool = bullets };
+    parallelFor(bullets->count, UPDATE_GRAIN_SIZE, updateBulletRange, &job);
+}
+
+/**
+ * @brief Turns homing bullets towards their targets, at most their turn per tick. A bullet
+ * whose target is gone flies straight from then on.
+ *
+ * @param bullets
+ * @param enemies
+ */
+void steerBullets(EntityPool *bullets, EntityPool *enemies)
+{
+    if (bullets->turn == NULL)
+    {
+        return;
+    }
+
+    for (int i = 0; i < bullets->count; i++)
+    {
+        if (bullets->turn[i] <= 0.0f)
+        {
+            continue;
+        }
+
+        int target = getHandleIndex(enemies, (EntityHandle){ bullets->targetSlot[i], bullets->targetGeneration[i] });
+        if (target < 0)
         {
-            // TraceLog(LOG_INFO, "BULLET UPDATED");
-            bullets[i]->body.x += bullets[i]->direction.x * bullets[i]->speed;
-            bullets[i]->body.y += bullets[i]->direction.y * bullets[i]->speed;
+            bullets->turn[i] = 0.0f;
+            continue;
         }
+
+        // Signed angle from the bullet's heading to the target, clamped to the turn
+        float dx = (enemies->x[target] + enemies->width[target] / 2) - (bullets->x[i] + bullets->width[i] / 2);
+        float dy = (enemies->y[target] + enemies->height[target] / 2) - (bullets->y[i] + bullets->height[i] / 2);
+        float headingX = bullets->directionX[i];
+        float headingY = bullets->directionY[i];
+        float angle = atan2f(headingX * dy - headingY * dx, headingX * dx + headingY * dy);
+        angle = fmaxf(-bullets->turn[i], fminf(bullets->turn[i], angle));
+
+        float c = cosf(angle);
+        float s = sinf(angle);
+        bullets->directionX[i] = headingX * c - headingY * s;
+        bullets->directionY[i] = headingX * s + headingY * c;
     }
 }
 
+// Advances bullets [start, end) along their direction. Runs on the job threads
+void updateBulletRange(void *data, int start, int end)
+{
+    UpdateJob *job = (UpdateJob *)data;
+    advanceEntities(job->pool, start, end);
+}
+
 void updateBullet(Entity* bullet)
 {
+    bullet->previous = (Vector2){bullet->body.x, bullet->body.y};
     bullet->body.x += bullet->direction.x * bullet->speed;
     bullet->body.y += bullet->direction.y * bullet->speed;
 }
 
 /**
- * @brief Renders all the bullets on screen
+ * @brief Queues the bullets on screen to be drawn with the rest of the sprite queue
  * 
  * @param bullets 
  */
-void renderBullets(Entity **bullets)
+void renderBullets(EntityPool *bullets)
 {
-    for (int i = 0; i < CURRENT_MAX_BULLETS; i++)
-    {
-        if (bullets[i] != NULL)
-        {
-            // TraceLog(LOG_INFO, "BULLET RENDERED");
-            DrawRectangleRec(bullets[i]->body, BLUE);
-        }
-    }
+    // Plain squares, drawn from the middle of the atlas' white square. Patterns pick each
+    // bullet's size, so a unit square is scaled by the bullet's width
+    SpriteLayout layout = {
+        .source = (Rectangle){ whiteSprite.x + 1, whiteSprite.y + 1, whiteSprite.width - 2, whiteSprite.height - 2 },
+        .size = (Vector2){ 1, 1 },
+    };
+    SpriteColumns columns = {
+        .x = bullets->x,
+        .y = bullets->y,
+        .previousX = bullets->previousX,
+        .previousY = bullets->previousY,
+        .scale = bullets->width,
+        .count = bullets->count,
+    };
+
+    queueSprites(SPRITE_LAYER_BULLETS, spriteAtlas.texture, layout, columns, BLUE);
 }
 #endif
\ No newline at end of file
@@ -16,106 +16,172 @@
 
 #include "Structs.h"
 #include "Globals.h"
-
-Entity **initEnemies();
-
-void generateNewEnemy(Entity **enemies, Vector2 playerV);
-void updateEnemies(Entity **enemies, Vector2 playerV);
-void renderEnemies(Entity **enemies);
-void clearEnemies(Entity **enemies);
-
-Entity **initEnemies()
+#include "Pool.h"
+#include "Random.h"
+#include "Jobs.h"
+#include "Steering.h"
+#include "FlowField.h"
+#include "Flocking.h"
+#include "Levels.h"
+#include "SpriteBatch.h"
+#include "Atlas.h"
+
+EntityPool *initEnemies();
+
+void spawnEnemies(EntityPool *enemies, Vector2 playerV, Rectangle view, LevelTable *levels, int score, long long tick);
+void generateNewEnemy(EntityPool *enemies, Vector2 playerV, Rectangle view, const EnemyKind *kind);
+void updateEnemies(EntityPool *enemies, Vector2 playerV, const Vector2 *partnerV, FlowField *field, Flock *flock);
+void updateEnemyRange(void *data, int start, int end);
+void renderEnemies(EntityPool *enemies, float alpha);
+void clearEnemies(EntityPool *enemies);
+
+EntityPool *initEnemies()
 {
-    Entity **enemies = MemAlloc(sizeof(Entity) * MAX_ENEMIES);
+    EntityPool *enemies = initPool(MAX_ENEMIES, ARCHETYPE_ENEMY);
     if (enemies == NULL)
     {
         TraceLog(LOG_ERROR, "Error initializing enemies");
         return NULL;
     }
 
-    for (int i = 0; i < MAX_ENEMIES; i++)
-    {
-        enemies[i] = NULL;
-    }
     return enemies;
 }
 
 /**
- * @brief Generate a new enemy and initialize its stats. Also generate
- * a direction vector towards the player
+ * @brief Spawns the enemies due this tick under the level the score has reached, which
+ * also sets the enemy cap. With no levels loaded, one default enemy is spawned every
+ * tick up to MAX_ENEMIES.
  *
  * @param enemies
+ * @param playerV
+ * @param view The area of the world on screen, enemies come in from its edges
+ * @param levels
+ * @param score
+ * @param tick The number of ticks simulated so far
  */
-void generateNewEnemy(Entity **enemies, Vector2 playerV)
+void spawnEnemies(EntityPool *enemies, Vector2 playerV, Rectangle view, LevelTable *levels, int score, long long tick)
 {
-    Entity *newEnemy = MemAlloc(sizeof(Entity));
-    bool spaceAvail = false;
-    // check for an empty spot in enemies before anything else
-    for (int i = 0; i < CURRENT_MAX_ENEMIES; i++)
+    int level = getLevelIndex(levels, score);
+    int cap = (level < 0)? MAX_ENEMIES : levels->levels[level].maxEnemies;
+    CURRENT_MAX_ENEMIES = (cap < ENEMY_CAP_LIMIT)? cap : ENEMY_CAP_LIMIT;
+
+    if (level < 0)
+    {
+        generateNewEnemy(enemies, playerV, view, &defaultEnemyKind);
+        return;
+    }
+    if (tick % levels->levels[level].spawnInterval == 0)
     {
-        if (enemies[i] == NULL)
+        for (int s = 0; s < levels->levels[level].spawnBudget && enemies->count < CURRENT_MAX_ENEMIES; s++)
         {
-            enemies[i] = newEnemy;
-            spaceAvail = true;
-            break;
+            generateNewEnemy(enemies, playerV, view, pickEnemyKind(levels, level));
         }
     }
-    if (!spaceAvail)
+}
+
+/**
+ * @brief Generate a new enemy and initialize its stats. Also generate
+ * a direction vector towards the player
+ *
+ * @param enemies
+ * @param playerV
+ * @param view The area of the world on screen. The enemy spawns on one of its edges
+ * @param kind The kind of enemy to spawn
+ */
+void generateNewEnemy(EntityPool *enemies, Vector2 playerV, Rectangle view, const EnemyKind *kind)
+{
+    int newEnemy = spawnEntity(enemies, CURRENT_MAX_ENEMIES);
+    if (newEnemy < 0)
     {
         TraceLog(LOG_INFO, "No space for enemy");
-        MemFree(newEnemy);
         return;
     }
 
-    newEnemy->body.height = newEnemy->body.width = 65.5;
-    newEnemy->speed = GetRandomValue(1, 5);
-    newEnemy->sprite = zombieSprite;
+    enemies->height[newEnemy] = enemies->width[newEnemy] = ENEMY_SIZE;
+    enemies->health[newEnemy] = kind->health;
+    enemies->speed[newEnemy] = randomInt(RANDOM_SPAWN, kind->minSpeed, kind->maxSpeed);
 
     // Determining which side of the screen the enemy will spawn from
-    switch (GetRandomValue(0, 3))
+    switch (randomInt(RANDOM_SPAWN, 0, 3))
     {
     // UP
     case 0:
-        newEnemy->body.x = GetRandomValue(0, screenWidth - 25);
-        newEnemy->body.y = screenHeight - 25;
+        enemies->x[newEnemy] = view.x + randomInt(RANDOM_SPAWN, 0, view.width - 25);
+        enemies->y[newEnemy] = view.y + view.height - 25;
         break;
     // DOWN
     case 1:
-        newEnemy->body.x = GetRandomValue(0, screenWidth - 25);
-        newEnemy->body.y = 0;
+        enemies->x[newEnemy] = view.x + randomInt(RANDOM_SPAWN, 0, view.width - 25);
+        enemies->y[newEnemy] = view.y;
         break;
     case 2:
-        newEnemy->body.x = 0;
-        newEnemy->body.y = GetRandomValue(0, screenHeight - 25);
+        enemies->x[newEnemy] = view.x;
+        enemies->y[newEnemy] = view.y + randomInt(RANDOM_SPAWN, 0, view.height - 25);
         break;
     case 3:
-        newEnemy->body.x = screenWidth - 25;
-        newEnemy->body.y = GetRandomValue(0, screenHeight - 25);
+        enemies->x[newEnemy] = view.x + view.width - 25;
+        enemies->y[newEnemy] = view.y + randomInt(RANDOM_SPAWN, 0, view.height - 25);
         break;
     }
 
+    enemies->previousX[newEnemy] = enemies->x[newEnemy];
+    enemies->previousY[newEnemy] = enemies->y[newEnemy];
+
     // In this frame, generate a direction vector towards the player
-    newEnemy->direction = Vector2Normalize(Vector2Subtract(playerV, createVector2(newEnemy->body.x, newEnemy->body.y)));
+    Vector2 direction = Vector2Normalize(Vector2Subtract(playerV, createVector2(enemies->x[newEnemy], enemies->y[newEnemy])));
+    enemies->directionX[newEnemy] = direction.x;
+    enemies->directionY[newEnemy] = direction.y;
 
     return;
 }
 
 /**
- * @brief Update the enemies' position based on the player's position
+ * @brief Update the enemies' position based on the player's position. Large swarms
+ * are split across the job threads.
  * 
  * @param enemies 
  * @param playerV 
+ * @param partnerV The second player in co-op, or NULL. Enemies go for whichever player is nearer
+ * @param field Routes around obstacles, or NULL
+ * @param flock Pushes from computeFlocking() to add on top, or NULL
  */
-void updateEnemies(Entity **enemies, Vector2 playerV)
+void updateEnemies(EntityPool *enemies, Vector2 playerV, const Vector2 *partnerV, FlowField *field, Flock *flock)
 { // In one frame, advance the enemies towards the player.
-    for (int i = 0; i < CURRENT_MAX_ENEMIES; i++)
-    { // go through every enemy
-        if (enemies[i] != NULL)
-        { //
-            enemies[i]->direction = Vector2Normalize(Vector2Subtract(playerV, createVector2(enemies[i]->body.x, enemies[i]->body.y)));
-            enemies[i]->body.y += enemies[i]->direction.y * enemies[i]->speed;
-            enemies[i]->body.x += enemies[i]->direction.x * enemies[i]->speed;
-        }
+    if (!queryPool(enemies, COMPONENT_POSITION | COMPONENT_PREVIOUS | COMPONENT_DIRECTION | COMPONENT_SPEED | COMPONENT_SIZE, "updateEnemies"))
+    {
+        return;
+    }
+    if (flock != NULL && flock->capacity < enemies->count)
+    { // computeFlocking() couldn't grow to fit
+        flock = NULL;
+    }
+    UpdateJob job = { enemies, playerV, partnerV, field, flock };
+    parallelFor(enemies->count, UPDATE_GRAIN_SIZE, updateEnemyRange, &job);
+}
+
+// Advances enemies [start, end) towards the job's target. Runs on the job threads
+void updateEnemyRange(void *data, int start, int end)
+{
+    UpdateJob *job = (UpdateJob *)data;
+
+    // On an open arena every cell can see the player, so skip the lookups. The flow
+    // field only leads to the first player, so around obstacles the partner is ignored
+    if (job->field != NULL && job->field->blockedCount > 0 && job->field->readyGoal >= 0)
+    {
+        followFlowField(job->pool, start, end, job->field, job->target);
+    }
+    else if (job->partner != NULL)
+    {
+        chaseNearest(job->pool, start, end, job->target, *job->partner);
+    }
+    else
+    {
+        chaseTarget(job->pool, start, end, job->target);
+    }
+
+    if (job->flock != NULL)
+    {
+        applyFlocking(job->flock, job->pool, start, end);
     }
 }
 
@@ -125,6 +191,7 @@ void updateEnemy(Entity *enemy)
     {
         return;
     }
+    enemy->previous = (Vector2){enemy->body.x, enemy->body.y};
     enemy->direction = Vector2Normalize(Vector2Subtract(playerV, createVector2(enemy->body.x, enemy->body.y)));
     enemy->body.y += enemy->direction.y * enemy->speed;
     enemy->body.x += enemy->direction.x * enemy->speed;
@@ -132,44 +199,48 @@ void updateEnemy(Entity *enemy)
 
 
 /**
- * @brief Render the enemies on screen
+ * @brief Queues the enemies on screen to be drawn with the rest of the sprite queue
  * 
  * @param enemies 
+ * @param alpha How far the current frame is between the last tick and the next one, for
+ * the hitboxes drawn in debug builds
  */
-void renderEnemies(Entity **enemies)
+void renderEnemies(EntityPool *enemies, float alpha)
 {
-    Vector2 enemyV;
-    Vector2 rotationCenter;
-    for (int i = 0; i < CURRENT_MAX_ENEMIES; i++)
-    {
-        if (enemies[i] != NULL)
+    // The sprite is centred on the corner of the body opposite its position, and faces
+    // the direction the enemy chased during the last tick
+    SpriteLayout layout = {
+        .source = zombieSprite,
+        .size = (Vector2){ zombieSprite.width, zombieSprite.height },
+        .offset = (Vector2){ ENEMY_SIZE - zombieSprite.width, ENEMY_SIZE - zombieSprite.height },
+        .origin = (Vector2){ zombieSprite.width / 2, zombieSprite.height / 2 },
+    };
+    SpriteColumns columns = {
+        .x = enemies->x,
+        .y = enemies->y,
+        .previousX = enemies->previousX,
+        .previousY = enemies->previousY,
+        .rotationX = enemies->directionX,
+        .rotationY = enemies->directionY,
+        .count = enemies->count,
+    };
+
+    (void)alpha;
+    #ifdef SWARM_DEBUG
+        //Show hitboxes
+        for (int i = 0; i < enemies->count; i++)
         {
-            enemyV = createVector2(enemies[i]->body.x, enemies[i]->body.y);
-            rotationCenter = (Vector2){enemies[i]->body.x + enemies[i]->body.width, enemies[i]->body.height + enemies[i]->body.y };
-
-            #ifdef SWARM_DEBUG
-                //Show hitboxes
-                DrawRectangle(enemies[i]->body.x, enemies[i]->body.y, enemies[i]->body.width, enemies[i]->body.width, (Color){155, 0, 0, 155});
-            #endif
-            DrawTexturePro(enemies[i]->sprite,
-                           (Rectangle){0, 0, zombieSprite.width, zombieSprite.height},
-                           (Rectangle){rotationCenter.x - enemies[i]->sprite.width / 2, rotationCenter.y - enemies[i]->sprite.height / 2, zombieSprite.width, zombieSprite.height},
-                           (Vector2) {zombieSprite.width / 2, zombieSprite.height / 2},
-                           calculateAngle(enemyV, playerV),
-                           WHITE);
+            DrawRectangle(Lerp(enemies->previousX[i], enemies->x[i], alpha), Lerp(enemies->previousY[i], enemies->y[i], alpha),
+                          enemies->width[i], enemies->width[i], (Color){155, 0, 0, 155});
         }
-    }
+    #endif
+    queueSprites(SPRITE_LAYER_ENEMIES, spriteAtlas.texture, layout, columns, WHITE);
 }
-void clearEnemies(Entity **enemies)
+
+// Despawns every enemy on screen, awarding a point for each one
+void clearEnemies(EntityPool *enemies)
 {
-    for (int i = 0; i < CURRENT_MAX_ENEMIES; i++)
-    {
-        if (enemies[i] != NULL)
-        {
-            MemFree(enemies[i]);
-            enemies[i] = NULL;
-            currentScore++;
-        }
-    }
+    currentScore += enemies->count;
+    clearPool(enemies);
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,276 @@
+/**
+ * @file Flocking.h
+ * @author Kevin Pluas
+ * @brief Separation and alignment between neighbouring enemies
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _FLOCKING_H
+#define _FLOCKING_H
+
+#include <math.h>
+
+#include "Structs.h"
+#include "Globals.h"
+#include "Jobs.h"
+#include "Pool.h"
+#include "Grid.h"
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+Flock *initFlock(float width, float height, int capacity);
+bool reserveFlock(Flock *flock, int capacity);
+
+void computeFlocking(Flock *flock, EntityPool *pool);
+void computeFlockRange(void *data, int start, int end);
+void applyFlocking(Flock *flock, EntityPool *pool, int start, int end);
+size_t getFlockBytes(Flock *flock);
+void unloadFlock(Flock *flock);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+/**
+ * @brief Allocates a flock for a pool of up to capacity entities on a width x height
+ * playfield.
+ *
+ * @param width
+ * @param height
+ * @param capacity
+ * @return Flock* or NULL if the allocation failed
+ */
+Flock *initFlock(float width, float height, int capacity)
+{
+    Flock *flock = MemAlloc(sizeof(Flock));
+    if (flock == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error initializing flock");
+        return NULL;
+    }
+
+    *flock = (Flock){ 0 };
+    flock->grid = initGrid(width, height, FLOCK_RADIUS, capacity, 0.0f);
+    if (flock->grid == NULL || !reserveFlock(flock, capacity))
+    {
+        TraceLog(LOG_ERROR, "Error initializing flock storage");
+        unloadFlock(flock);
+        return NULL;
+    }
+
+    return flock;
+}
+
+/**
+ * @brief Makes room for the pushes of capacity entities. computeFlocking() calls this
+ * when the pool has outgrown the flock.
+ *
+ * @param flock
+ * @param capacity
+ * @return true if the flock can now handle capacity entities
+ */
+bool reserveFlock(Flock *flock, int capacity)
+{
+    if (capacity <= flock->capacity)
+    {
+        return true;
+    }
+
+    // Every column is rewritten each tick, so there is nothing to copy over
+    float **columns[6] = { &flock->binnedX, &flock->binnedY, &flock->binnedDirectionX, &flock->binnedDirectionY, &flock->pushX, &flock->pushY };
+    for (int c = 0; c < 6; c++)
+    {
+        MemFree(*columns[c]);
+        *columns[c] = MemAlloc(sizeof(float) * capacity);
+    }
+    for (int c = 0; c < 6; c++)
+    {
+        if (*columns[c] == NULL)
+        {
+            flock->capacity = 0;
+            return false;
+        }
+    }
+
+    flock->capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief Bins the pool by position and works out every entity's push for the coming
+ * tick. Entities only read their neighbours and write their own push, so the result is
+ * the same however the work is split across threads. If the flock can't grow to fit the
+ * pool, no pushes are computed and updateEnemies() leaves them out.
+ *
+ * @param flock
+ * @param pool
+ */
+void computeFlocking(Flock *flock, EntityPool *pool)
+{
+    if (!queryPool(pool, COMPONENT_POSITION | COMPONENT_DIRECTION | COMPONENT_SPEED, "computeFlocking"))
+    {
+        return;
+    }
+    if (!reserveFlock(flock, pool->capacity) || !reserveGrid(flock->grid, pool->capacity))
+    {
+        TraceLog(LOG_ERROR, "Error growing flock to %d entities", pool->capacity);
+        return;
+    }
+
+    buildPointGrid(flock->grid, pool);
+    for (int k = 0; k < pool->count; k++)
+    {
+        int i = flock->grid->items[k];
+        flock->binnedX[k] = pool->x[i];
+        flock->binnedY[k] = pool->y[i];
+        flock->binnedDirectionX[k] = pool->directionX[i];
+        flock->binnedDirectionY[k] = pool->directionY[i];
+    }
+
+    UpdateJob job = { pool, Vector2Zero(), NULL, NULL, flock };
+    parallelFor(pool->count, UPDATE_GRAIN_SIZE, computeFlockRange, &job);
+}
+
+/**
+ * @brief Computes the pushes of entities [start, end). Runs on the job threads.
+ *
+ * Cells are as wide as FLOCK_RADIUS, so every neighbour is in the entity's own cell or
+ * the ring around it. The search stops after FLOCK_MAX_NEIGHBOURS neighbours, which keeps
+ * a dense crowd as cheap as a sparse one. It starts with the entity's own cell, the
+ * closest candidates, then goes round the ring from a different side for each entity so
+ * the cut off doesn't favour one direction.
+ *
+ * @param data The UpdateJob
+ * @param start
+ * @param end
+ */
+void computeFlockRange(void *data, int start, int end)
+{
+    static const int ringColumns[9] = { 0, -1, 0, 1, 1, 1, 0, -1, -1 };
+    static const int ringRows[9] = { 0, -1, -1, -1, 0, 1, 1, 1, 0 };
+
+    UpdateJob *job = (UpdateJob *)data;
+    EntityPool *pool = job->pool;
+    Flock *flock = job->flock;
+    SpatialGrid *grid = flock->grid;
+    const float radiusSquared = FLOCK_RADIUS * FLOCK_RADIUS;
+    const float inverseRadiusSquared = 1.0f / radiusSquared;
+
+    for (int i = start; i < end; i++)
+    {
+        float x = pool->x[i];
+        float y = pool->y[i];
+        float separationX = 0.0f, separationY = 0.0f;
+        float headingX = 0.0f, headingY = 0.0f;
+        int neighbours = 0;
+
+        int home = getGridCell(grid, x, y);
+        int homeColumn = home % grid->columns;
+        int homeRow = home / grid->columns;
+
+        for (int n = 0; n < 9 && neighbours < FLOCK_MAX_NEIGHBOURS; n++)
+        {
+            int ring = (n == 0)? 0 : 1 + (n - 1 + i) % 8;
+            int column = homeColumn + ringColumns[ring];
+            int row = homeRow + ringRows[ring];
+            if (column < 0 || column >= grid->columns || row < 0 || row >= grid->rows)
+            {
+                continue;
+            }
+
+            int cell = row * grid->columns + column;
+            for (int k = grid->cellStart[cell]; k < grid->cellStart[cell + 1]; k++)
+            {
+                float dx = x - flock->binnedX[k];
+                float dy = y - flock->binnedY[k];
+                float distanceSquared = dx * dx + dy * dy;
+                if (distanceSquared >= radiusSquared)
+                {
+                    continue;
+                }
+                int j = grid->items[k];
+                if (j == i)
+                {
+                    continue;
+                }
+
+                // Push away harder the closer j is, fading out at FLOCK_RADIUS. Stacked
+                // entities split along their index
+                if (distanceSquared > 0.0f)
+                {
+                    float scale = (1.0f / distanceSquared - inverseRadiusSquared) * FLOCK_RADIUS;
+                    separationX += dx * scale;
+                    separationY += dy * scale;
+                }
+                else
+                {
+                    separationX += (i < j)? -1.0f : 1.0f;
+                }
+                headingX += flock->binnedDirectionX[k];
+                headingY += flock->binnedDirectionY[k];
+
+                if (++neighbours == FLOCK_MAX_NEIGHBOURS)
+                {
+                    break;
+                }
+            }
+        }
+
+        float pushX = 0.0f, pushY = 0.0f;
+        if (neighbours > 0)
+        {
+            // Steer towards the neighbours' average heading
+            pushX = separationX * FLOCK_SEPARATION + (headingX / neighbours - pool->directionX[i]) * FLOCK_ALIGNMENT;
+            pushY = separationY * FLOCK_SEPARATION + (headingY / neighbours - pool->directionY[i]) * FLOCK_ALIGNMENT;
+
+            // Never outrun the chase itself
+            float length = sqrtf(pushX * pushX + pushY * pushY);
+            if (length > pool->speed[i])
+            {
+                pushX *= pool->speed[i] / length;
+                pushY *= pool->speed[i] / length;
+            }
+        }
+        flock->pushX[i] = pushX;
+        flock->pushY[i] = pushY;
+    }
+}
+
+// Adds the pushes of entities [start, end) to their positions, after they have moved
+void applyFlocking(Flock *flock, EntityPool *pool, int start, int end)
+{
+    for (int i = start; i < end; i++)
+    {
+        pool->x[i] += flock->pushX[i];
+        pool->y[i] += flock->pushY[i];
+    }
+}
+
+// Returns how many bytes initFlock() allocated for this flock
+size_t getFlockBytes(Flock *flock)
+{
+    return sizeof(Flock) + getGridBytes(flock->grid) + sizeof(float) * 6 * flock->capacity;
+}
+
+// Frees the flock and its storage
+void unloadFlock(Flock *flock)
+{
+    if (flock == NULL)
+    {
+        return;
+    }
+    unloadGrid(flock->grid);
+    MemFree(flock->binnedX);
+    MemFree(flock->binnedY);
+    MemFree(flock->binnedDirectionX);
+    MemFree(flock->binnedDirectionY);
+    MemFree(flock->pushX);
+    MemFree(flock->pushY);
+    MemFree(flock);
+}
+#endif
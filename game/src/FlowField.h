@@ -0,0 +1,446 @@
+/**
+ * @file FlowField.h
+ * @author Kevin Pluas
+ * @brief Flow field pathfinding shared by the whole swarm
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _FLOWFIELD_H
+#define _FLOWFIELD_H
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "Structs.h"
+#include "Steering.h"
+
+#define FLOW_UNREACHED INT_MAX
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+FlowField *initFlowField(float width, float height, float cellSize);
+
+void resetFlowField(FlowField *field);
+void setFlowObstacle(FlowField *field, Rectangle area, bool blocked);
+void setFlowGoal(FlowField *field, Vector2 goal);
+void stepFlowField(FlowField *field, int budget);
+void followFlowField(EntityPool *pool, int start, int end, FlowField *field, Vector2 target);
+void drawFlowField(FlowField *field);
+int countBlockedEntities(FlowField *field, EntityPool *pool);
+size_t getFlowFieldBytes(FlowField *field);
+void unloadFlowField(FlowField *field);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+/**
+ * @brief Allocates a flow field covering width x height with no obstacles. Nothing
+ * is integrated until setFlowGoal() is called.
+ *
+ * @param width Width of the playfield
+ * @param height Height of the playfield
+ * @param cellSize Size of a cell
+ * @return FlowField* or NULL if the allocation failed
+ */
+FlowField *initFlowField(float width, float height, float cellSize)
+{
+    FlowField *field = MemAlloc(sizeof(FlowField));
+    if (field == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error initializing flow field");
+        return NULL;
+    }
+
+    field->cellSize = cellSize;
+    field->columns = (int)ceilf(width / cellSize);
+    field->rows = (int)ceilf(height / cellSize);
+    field->readyGoal = -1;
+    field->goal = -1;
+    field->pendingGoal = -1;
+    field->cursor = -1;
+
+    int cellCount = field->columns * field->rows;
+    field->blocked = MemAlloc(cellCount);
+    field->directionX = MemAlloc(sizeof(float) * cellCount);
+    field->directionY = MemAlloc(sizeof(float) * cellCount);
+    field->direct = MemAlloc(cellCount);
+    field->nextDirectionX = MemAlloc(sizeof(float) * cellCount);
+    field->nextDirectionY = MemAlloc(sizeof(float) * cellCount);
+    field->nextDirect = MemAlloc(cellCount);
+    field->distance = MemAlloc(sizeof(int) * cellCount);
+    field->queue = MemAlloc(sizeof(int) * cellCount);
+
+    if (field->blocked == NULL || field->directionX == NULL || field->directionY == NULL || field->direct == NULL ||
+        field->nextDirectionX == NULL || field->nextDirectionY == NULL || field->nextDirect == NULL ||
+        field->distance == NULL || field->queue == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error initializing flow field storage");
+        unloadFlowField(field);
+        return NULL;
+    }
+
+    return field;
+}
+
+// Returns the cell containing a point, clamped to the field
+static inline int getFlowCell(FlowField *field, float x, float y)
+{
+    int column = Clamp((int)floorf(x / field->cellSize), 0, field->columns - 1);
+    int row = Clamp((int)floorf(y / field->cellSize), 0, field->rows - 1);
+    return row * field->columns + column;
+}
+
+// The goal the front buffers will end up pointing at once every requested pass is done
+static inline int getLatestFlowGoal(FlowField *field)
+{
+    if (field->pendingGoal >= 0) return field->pendingGoal;
+    if (field->goal >= 0) return field->goal;
+    return field->readyGoal;
+}
+
+// Drops the current and pending passes but keeps the obstacles. Enemies chase the
+// player directly until the next pass is done
+void resetFlowField(FlowField *field)
+{
+    field->readyGoal = -1;
+    field->goal = -1;
+    field->pendingGoal = -1;
+    field->cursor = -1;
+    field->queueHead = field->queueTail = 0;
+}
+
+/**
+ * @brief Marks the cells overlapping area as blocked or open, and queues a new pass
+ * so the field routes around the change.
+ *
+ * @param field
+ * @param area
+ * @param blocked
+ */
+void setFlowObstacle(FlowField *field, Rectangle area, bool blocked)
+{
+    int minColumn = Clamp((int)floorf(area.x / field->cellSize), 0, field->columns - 1);
+    int minRow = Clamp((int)floorf(area.y / field->cellSize), 0, field->rows - 1);
+    int maxColumn = Clamp((int)floorf((area.x + area.width) / field->cellSize), 0, field->columns - 1);
+    int maxRow = Clamp((int)floorf((area.y + area.height) / field->cellSize), 0, field->rows - 1);
+
+    for (int row = minRow; row <= maxRow; row++)
+    {
+        for (int column = minColumn; column <= maxColumn; column++)
+        {
+            int cell = row * field->columns + column;
+            if (field->blocked[cell] != blocked)
+            {
+                field->blockedCount += blocked? 1 : -1;
+                field->blocked[cell] = blocked;
+            }
+        }
+    }
+
+    field->pendingGoal = getLatestFlowGoal(field);
+}
+
+// Queues a pass towards the cell containing goal, unless the field already leads there
+void setFlowGoal(FlowField *field, Vector2 goal)
+{
+    int cell = getFlowCell(field, goal.x, goal.y);
+    if (cell != getLatestFlowGoal(field))
+    {
+        field->pendingGoal = cell;
+    }
+}
+
+// True if the straight line between the centres of two cells crosses no blocked cell.
+// Walks every cell the line touches, including both sides of an exact corner, and adds
+// the cells it looked at to steps
+static bool hasLineOfSight(FlowField *field, int from, int to, int *steps)
+{
+    int x = from % field->columns;
+    int y = from / field->columns;
+    int targetX = to % field->columns;
+    int targetY = to / field->columns;
+    int dx = abs(targetX - x);
+    int dy = abs(targetY - y);
+    int stepX = (targetX > x)? 1 : -1;
+    int stepY = (targetY > y)? 1 : -1;
+    int error = dx - dy;
+
+    for (int n = 1 + dx + dy; n > 0; n--)
+    {
+        (*steps)++;
+        if (field->blocked[y * field->columns + x]) return false;
+        if (x == targetX && y == targetY) return true;
+
+        if (error > 0)
+        {
+            x += stepX;
+            error -= 2 * dy;
+        }
+        else if (error < 0)
+        {
+            y += stepY;
+            error += 2 * dx;
+        }
+        else
+        { // Through a corner: both cells beside it count
+            *steps += 2;
+            if (field->blocked[y * field->columns + x + stepX] || field->blocked[(y + stepY) * field->columns + x]) return false;
+            x += stepX;
+            y += stepY;
+            error += 2 * (dx - dy);
+            n--;
+        }
+    }
+
+    return true;
+}
+
+// True if a walker in cell (column, row) may step by (dx, dy). Diagonal steps need both
+// cells beside them to be open so nobody cuts through a wall's corner
+static inline bool canFlowStep(FlowField *field, int column, int row, int dx, int dy)
+{
+    int x = column + dx;
+    int y = row + dy;
+    if (x < 0 || y < 0 || x >= field->columns || y >= field->rows) return false;
+    if (field->blocked[y * field->columns + x]) return false;
+    if (dx != 0 && dy != 0)
+    {
+        return !field->blocked[row * field->columns + x] && !field->blocked[y * field->columns + column];
+    }
+    return true;
+}
+
+// Works out which way enemies in cell should walk, from the finished distances. Returns
+// the cells looked at, the line of sight to the goal included
+static int resolveFlowCell(FlowField *field, int cell)
+{
+    int steps = 1;
+    field->nextDirectionX[cell] = 0.0f;
+    field->nextDirectionY[cell] = 0.0f;
+    field->nextDirect[cell] = 1;
+
+    // Blocked and unreachable cells have nowhere better to point, and cells that can
+    // see the goal get the exact chase
+    if (field->blocked[cell] || field->distance[cell] == FLOW_UNREACHED || hasLineOfSight(field, cell, field->goal, &steps))
+    {
+        return steps;
+    }
+
+    int column = cell % field->columns;
+    int row = cell / field->columns;
+    int best = field->distance[cell];
+    int bestX = 0;
+    int bestY = 0;
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            if ((dx == 0 && dy == 0) || !canFlowStep(field, column, row, dx, dy)) continue;
+
+            int distance = field->distance[(row + dy) * field->columns + column + dx];
+            if (distance < best)
+            {
+                best = distance;
+                bestX = dx;
+                bestY = dy;
+            }
+        }
+    }
+
+    float length = sqrtf((float)(bestX * bestX + bestY * bestY));
+    if (length > 0)
+    {
+        field->nextDirectionX[cell] = bestX / length;
+        field->nextDirectionY[cell] = bestY / length;
+        field->nextDirect[cell] = 0;
+    }
+    return steps;
+}
+
+/**
+ * @brief Advances the pass in progress by about budget cell visits, starting the pending
+ * pass first if the field is idle. A pass is a breadth first search out from the goal
+ * cell followed by one sweep that picks a direction for every cell. When it's done the
+ * new directions replace the ones enemies are reading.
+ *
+ * A searched cell costs one visit. A swept cell costs one plus the cells its line of
+ * sight to the goal walks, which is most of a pass. The last cell of a call may run over
+ * the budget by one line, at most columns + rows visits.
+ *
+ * @param field
+ * @param budget Cell visits this call. Bounds the time spent per tick
+ */
+void stepFlowField(FlowField *field, int budget)
+{
+    int cellCount = field->columns * field->rows;
+
+    if (field->goal < 0)
+    {
+        if (field->pendingGoal < 0)
+        {
+            return;
+        }
+
+        field->goal = field->pendingGoal;
+        field->pendingGoal = -1;
+        for (int i = 0; i < cellCount; i++)
+        {
+            field->distance[i] = FLOW_UNREACHED;
+        }
+        field->distance[field->goal] = 0;
+        field->queue[0] = field->goal;
+        field->queueHead = 0;
+        field->queueTail = 1;
+        field->cursor = -1;
+    }
+
+    while (budget > 0)
+    {
+        if (field->cursor < 0)
+        { // Search
+            if (field->queueHead == field->queueTail)
+            {
+                field->cursor = 0;
+                continue;
+            }
+            budget--;
+
+            int cell = field->queue[field->queueHead++];
+            int column = cell % field->columns;
+            int row = cell / field->columns;
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    if ((dx == 0 && dy == 0) || !canFlowStep(field, column, row, dx, dy)) continue;
+
+                    int next = (row + dy) * field->columns + column + dx;
+                    if (field->distance[next] == FLOW_UNREACHED)
+                    {
+                        field->distance[next] = field->distance[cell] + 1;
+                        field->queue[field->queueTail++] = next;
+                    }
+                }
+            }
+        }
+        else
+        { // Resolve directions
+            budget -= resolveFlowCell(field, field->cursor++);
+            if (field->cursor == cellCount)
+            {
+                float *swapX = field->directionX;
+                float *swapY = field->directionY;
+                unsigned char *swapDirect = field->direct;
+                field->directionX = field->nextDirectionX;
+                field->directionY = field->nextDirectionY;
+                field->direct = field->nextDirect;
+                field->nextDirectionX = swapX;
+                field->nextDirectionY = swapY;
+                field->nextDirect = swapDirect;
+
+                field->readyGoal = field->goal;
+                field->goal = -1;
+                field->cursor = -1;
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Moves entities [start, end) one tick along the flow field, reading the cell
+ * under each entity's centre. Entities in a cell that can see the goal chase target
+ * directly, exactly like chaseTarget().
+ *
+ * @param pool
+ * @param start
+ * @param end
+ * @param field A field with at least one finished pass
+ * @param target
+ */
+void followFlowField(EntityPool *pool, int start, int end, FlowField *field, Vector2 target)
+{
+    for (int i = start; i < end; i++)
+    {
+        int cell = getFlowCell(field, pool->x[i] + pool->width[i] / 2, pool->y[i] + pool->height[i] / 2);
+        if (field->direct[cell])
+        {
+            chaseTargetScalar(pool, i, i + 1, target);
+            continue;
+        }
+
+        pool->previousX[i] = pool->x[i];
+        pool->previousY[i] = pool->y[i];
+        pool->directionX[i] = field->directionX[cell];
+        pool->directionY[i] = field->directionY[cell];
+        pool->x[i] += pool->directionX[i] * pool->speed[i];
+        pool->y[i] += pool->directionY[i] * pool->speed[i];
+    }
+}
+
+// Draws blocked cells and the direction of every cell that doesn't chase directly
+void drawFlowField(FlowField *field)
+{
+    for (int cell = 0; cell < field->columns * field->rows; cell++)
+    {
+        float x = (cell % field->columns) * field->cellSize;
+        float y = (cell / field->columns) * field->cellSize;
+        if (field->blocked[cell])
+        {
+            DrawRectangleRec((Rectangle){ x, y, field->cellSize, field->cellSize }, (Color){ 0, 0, 0, 120 });
+        }
+        else if (field->readyGoal >= 0 && !field->direct[cell])
+        {
+            Vector2 centre = { x + field->cellSize / 2, y + field->cellSize / 2 };
+            Vector2 tip = Vector2Add(centre, Vector2Scale((Vector2){ field->directionX[cell], field->directionY[cell] }, field->cellSize / 3));
+            DrawLineV(centre, tip, DARKGREEN);
+            DrawCircleV(tip, 2, DARKGREEN);
+        }
+    }
+}
+
+// Counts the entities of pool whose centre is in a blocked cell, to check the swarm
+// walks around obstacles rather than through them
+int countBlockedEntities(FlowField *field, EntityPool *pool)
+{
+    int count = 0;
+    for (int i = 0; i < pool->count; i++)
+    {
+        count += field->blocked[getFlowCell(field, pool->x[i] + pool->width[i] / 2, pool->y[i] + pool->height[i] / 2)] != 0;
+    }
+    return count;
+}
+
+// Returns how many bytes initFlowField() allocated for this field
+size_t getFlowFieldBytes(FlowField *field)
+{
+    size_t cells = (size_t)field->columns * field->rows;
+    return sizeof(FlowField) + cells * (3 + sizeof(float) * 4 + sizeof(int) * 2);
+}
+
+// Frees the field and its storage
+void unloadFlowField(FlowField *field)
+{
+    if (field == NULL)
+    {
+        return;
+    }
+    MemFree(field->blocked);
+    MemFree(field->directionX);
+    MemFree(field->directionY);
+    MemFree(field->direct);
+    MemFree(field->nextDirectionX);
+    MemFree(field->nextDirectionY);
+    MemFree(field->nextDirect);
+    MemFree(field->distance);
+    MemFree(field->queue);
+    MemFree(field);
+}
+#endif
@@ -12,8 +12,12 @@
 #ifndef _GLOBALS_H
 #define _GLOBALS_H
 
+#include <limits.h>
+
 const int screenWidth = 1280;
 const int screenHeight = 720;
+const int worldWidth = 3840; // The world is 3x3 screens, the camera follows the player around it
+const int worldHeight = 2160;
 const char *windowTitle = "Swarm";
 const char *logoString = "A GAME BY\n\nKEVIN PLUAS";
 
@@ -25,14 +29,39 @@ float PLAYER_SPEED = 2.5;
 float PLAYER_WIDTH = 45;
 float PLAYER_HEIGHT = 45;
 
-int ENEMY_SPAWN_INTERVAL = 100; //in frames
-const int POWERUP_SPAWN_INTERVAL = 300; //in frames
+float ENEMY_SIZE = 65.5;
+
+float BULLET_SPEED = 8.0f; // Pixels per tick. Collisions are swept, so any speed is safe
+float BULLET_SIZE = 10.0f;
+
+const int MAX_PARTICLES = 131072; // Capacity of the particle system, effects past it are dropped
+const float PARTICLE_DRAG = 0.92f; // Velocity kept by a particle from one tick to the next
+const float PARTICLE_SHRINK = 0.95f; // Size kept by a particle from one tick to the next
+
+// Simulation timing. Gameplay runs at a fixed tick rate no matter how fast frames are rendered
+const int TARGET_FPS = 60;
+const float TICK_TIME = 1.0f / 60.0f;   // Length of one simulation tick in seconds
+const int MAX_TICKS_PER_FRAME = 8;      // Caps catch-up after a long frame so the game can't fall further and further behind
 
-const int MAX_ENEMIES = 50; // The upper capacity on the number of enemies on screen at once. Should only really be used when MemAllocing the array
-const int MAX_BULLETS = 10;
+const int POWERUP_SPAWN_INTERVAL = 300; //in ticks
+
+int MAX_ENEMIES = 50; // Starting capacity of the enemy pool. The pool grows past it when a wave needs more
+int MAX_BULLETS = 10; // Starting capacity of the bullet pool
 int CURRENT_MAX_BULLETS = 1;
 int CURRENT_MAX_ENEMIES = 1; // The current capacity. Used for all the other loops.
+int ENEMY_CAP_LIMIT = INT_MAX; // Ceiling for CURRENT_MAX_ENEMIES. Only lowered by the benchmarks, so a run keeps its cap
+int BULLET_CAP_LIMIT = INT_MAX; // Ceiling for CURRENT_MAX_BULLETS
 int currentScore = 0;
+bool resimulating = false; // Set while a rollback simulates ticks again. Their sounds and effects already played
+
+const int UPDATE_GRAIN_SIZE = 2048; // Entities per job when an update phase is split across threads
+const float GRID_CELL_SIZE = 80.0f; // Collision grid cell size. Should stay larger than ENEMY_SIZE
+const float FLOW_CELL_SIZE = 40.0f; // Flow field cell size, the resolution obstacles are routed around at
+const int FLOW_STEPS_PER_TICK = 4096; // Flow field cell visits per tick, line of sight walks included, bounding its cost on any tick
+const float FLOCK_RADIUS = 48.0f; // Enemies closer than this push each other apart
+const int FLOCK_MAX_NEIGHBOURS = 8; // Neighbours looked at per enemy, bounding the cost of a dense crowd
+const float FLOCK_SEPARATION = 0.5f; // Scales the push apart. A neighbour half FLOCK_RADIUS away pushes 1.5x this many pixels per tick
+const float FLOCK_ALIGNMENT = 0.5f; // How strongly an enemy turns towards its neighbours' heading
 
 Vector2 mousePos;
 Vector2 playerV;
@@ -43,17 +72,15 @@ Sound impactFx;
 Music backgroundSong;
 Music introSong;
 
-Image floorBackground;
-Image healthTic;
-Image crosshairImage;
-
-Texture2D floorTexture;
-Texture2D healthTexture;
-Texture2D crosshairTexture;
-Texture2D zombieSprite;
-Texture2D playerSprite;
+// Regions of the sprite atlas
+Rectangle floorSprite;
+Rectangle healthSprite;
+Rectangle crosshairSprite;
+Rectangle zombieSprite;
+Rectangle playerSprite;
+Rectangle whiteSprite;
 
-Texture2D powerupSprites[6];
+Rectangle powerupSprites[6];
 
 static inline Vector2 createVector2(int x, int y)
 {
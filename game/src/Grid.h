@@ -0,0 +1,310 @@
+/**
+ * @file Grid.h
+ * @author Kevin Pluas
+ * @brief Spatial grid broadphase function declarations and definitions
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _GRID_H
+#define _GRID_H
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+#include "Structs.h"
+#include "Pool.h"
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+SpatialGrid *initGrid(float width, float height, float cellSize, int entityCapacity, float maxEntitySize);
+bool reserveGrid(SpatialGrid *grid, int entityCapacity);
+
+void buildGrid(SpatialGrid *grid, EntityPool *pool);
+void buildPointGrid(SpatialGrid *grid, EntityPool *pool);
+int queryGrid(SpatialGrid *grid, Rectangle area);
+size_t getGridBytes(SpatialGrid *grid);
+void unloadGrid(SpatialGrid *grid);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+/**
+ * @brief Allocates a grid covering width x height. All storage is sized up front
+ * so rebuilding the grid every tick never touches the heap.
+ *
+ * @param width Width of the playfield
+ * @param height Height of the playfield
+ * @param cellSize Size of a cell. Should be at least as big as the largest entity
+ * @param entityCapacity The maximum number of entities that will be inserted
+ * @param maxEntitySize Width or height of the largest entity that will be inserted
+ * @return SpatialGrid* or NULL if the allocation failed
+ */
+SpatialGrid *initGrid(float width, float height, float cellSize, int entityCapacity, float maxEntitySize)
+{
+    SpatialGrid *grid = MemAlloc(sizeof(SpatialGrid));
+    if (grid == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error initializing spatial grid");
+        return NULL;
+    }
+
+    // An entity can straddle at most this many cells on each axis
+    int cellsPerEntity = (int)ceilf(maxEntitySize / cellSize) + 1;
+
+    grid->cellSize = cellSize;
+    grid->columns = (int)ceilf(width / cellSize);
+    grid->rows = (int)ceilf(height / cellSize);
+    grid->entityCapacity = entityCapacity;
+    grid->itemCapacity = entityCapacity * cellsPerEntity * cellsPerEntity;
+    grid->queryStamp = 0;
+
+    int cellCount = grid->columns * grid->rows;
+    grid->cellStart = MemAlloc(sizeof(int) * (cellCount + 1));
+    grid->cellFill = MemAlloc(sizeof(int) * cellCount);
+    grid->items = MemAlloc(sizeof(int) * grid->itemCapacity);
+    grid->lastQuery = MemAlloc(sizeof(int) * entityCapacity);
+    grid->results = MemAlloc(sizeof(int) * entityCapacity);
+
+    if (grid->cellStart == NULL || grid->cellFill == NULL || grid->items == NULL ||
+        grid->lastQuery == NULL || grid->results == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error initializing spatial grid storage");
+        unloadGrid(grid);
+        return NULL;
+    }
+
+    return grid;
+}
+
+/**
+ * @brief Makes room for entityCapacity entities, keeping the items per entity the
+ * grid was created with. Called by the builds when the pool has outgrown the grid.
+ *
+ * @param grid
+ * @param entityCapacity
+ * @return true if the grid can now hold entityCapacity entities
+ */
+bool reserveGrid(SpatialGrid *grid, int entityCapacity)
+{
+    if (entityCapacity <= grid->entityCapacity)
+    {
+        return true;
+    }
+
+    int itemsPerEntity = grid->itemCapacity / grid->entityCapacity;
+    int *items = MemRealloc(grid->items, sizeof(int) * entityCapacity * itemsPerEntity);
+    if (items != NULL)
+    {
+        grid->items = items;
+    }
+    int *lastQuery = MemRealloc(grid->lastQuery, sizeof(int) * entityCapacity);
+    if (lastQuery != NULL)
+    {
+        grid->lastQuery = lastQuery;
+    }
+    int *results = MemRealloc(grid->results, sizeof(int) * entityCapacity);
+    if (results != NULL)
+    {
+        grid->results = results;
+    }
+
+    if (items == NULL || lastQuery == NULL || results == NULL)
+    { // Whatever did grow is kept, but the capacity stays where it was
+        TraceLog(LOG_ERROR, "Error growing spatial grid to %d entities", entityCapacity);
+        return false;
+    }
+
+    // Older stamps are all smaller than the next one, so zero is never mistaken for it
+    memset(grid->lastQuery + grid->entityCapacity, 0, sizeof(int) * (entityCapacity - grid->entityCapacity));
+    grid->entityCapacity = entityCapacity;
+    grid->itemCapacity = entityCapacity * itemsPerEntity;
+    return true;
+}
+
+// Number of pool entities a build can bin, growing the grid to fit if needed
+static inline int getGridEntityCount(SpatialGrid *grid, EntityPool *pool)
+{
+    if (pool->count > grid->entityCapacity)
+    {
+        reserveGrid(grid, pool->capacity);
+    }
+
+    return (pool->count < grid->entityCapacity)? pool->count : grid->entityCapacity;
+}
+
+// Clamps the cells covered by area to the grid
+static inline void getGridCells(SpatialGrid *grid, Rectangle area, int *minColumn, int *minRow, int *maxColumn, int *maxRow)
+{
+    *minColumn = (int)floorf(area.x / grid->cellSize);
+    *minRow = (int)floorf(area.y / grid->cellSize);
+    *maxColumn = (int)floorf((area.x + area.width) / grid->cellSize);
+    *maxRow = (int)floorf((area.y + area.height) / grid->cellSize);
+
+    *minColumn = Clamp(*minColumn, 0, grid->columns - 1);
+    *minRow = Clamp(*minRow, 0, grid->rows - 1);
+    *maxColumn = Clamp(*maxColumn, 0, grid->columns - 1);
+    *maxRow = Clamp(*maxRow, 0, grid->rows - 1);
+}
+
+// Index of the cell holding a point, clamped to the grid
+static inline int getGridCell(SpatialGrid *grid, float x, float y)
+{
+    int column = Clamp((int)floorf(x / grid->cellSize), 0, grid->columns - 1);
+    int row = Clamp((int)floorf(y / grid->cellSize), 0, grid->rows - 1);
+    return row * grid->columns + column;
+}
+
+// Turns the per cell counts in cellFill into offsets, and resets cellFill to the
+// start of each cell for the scatter pass
+static inline void startGridCells(SpatialGrid *grid)
+{
+    int cellCount = grid->columns * grid->rows;
+
+    grid->cellStart[0] = 0;
+    for (int c = 0; c < cellCount; c++)
+    {
+        grid->cellStart[c + 1] = grid->cellStart[c] + grid->cellFill[c];
+        grid->cellFill[c] = grid->cellStart[c];
+    }
+}
+
+/**
+ * @brief Rebuilds the grid from every live entity in the pool. Entities are
+ * inserted into every cell their body overlaps.
+ *
+ * @param grid
+ * @param pool
+ */
+void buildGrid(SpatialGrid *grid, EntityPool *pool)
+{
+    int cellCount = grid->columns * grid->rows;
+    int count = getGridEntityCount(grid, pool);
+    int minColumn, minRow, maxColumn, maxRow;
+
+    // Count how many entities land in each cell
+    memset(grid->cellFill, 0, sizeof(int) * cellCount);
+    for (int i = 0; i < count; i++)
+    {
+        getGridCells(grid, getEntityBody(pool, i), &minColumn, &minRow, &maxColumn, &maxRow);
+        for (int row = minRow; row <= maxRow; row++)
+        {
+            for (int column = minColumn; column <= maxColumn; column++)
+            {
+                grid->cellFill[row * grid->columns + column]++;
+            }
+        }
+    }
+
+    startGridCells(grid);
+
+    // Scatter the entity indices into their cells
+    for (int i = 0; i < count; i++)
+    {
+        getGridCells(grid, getEntityBody(pool, i), &minColumn, &minRow, &maxColumn, &maxRow);
+        for (int row = minRow; row <= maxRow; row++)
+        {
+            for (int column = minColumn; column <= maxColumn; column++)
+            {
+                grid->items[grid->cellFill[row * grid->columns + column]++] = i;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Rebuilds the grid with every live entity in the single cell holding its
+ * position, no matter how big it is. Meant for neighbour searches, where each entity
+ * should be found once.
+ *
+ * @param grid
+ * @param pool
+ */
+void buildPointGrid(SpatialGrid *grid, EntityPool *pool)
+{
+    int cellCount = grid->columns * grid->rows;
+    int count = getGridEntityCount(grid, pool);
+
+    memset(grid->cellFill, 0, sizeof(int) * cellCount);
+    for (int i = 0; i < count; i++)
+    {
+        grid->cellFill[getGridCell(grid, pool->x[i], pool->y[i])]++;
+    }
+
+    startGridCells(grid);
+
+    for (int i = 0; i < count; i++)
+    {
+        grid->items[grid->cellFill[getGridCell(grid, pool->x[i], pool->y[i])]++] = i;
+    }
+}
+
+/**
+ * @brief Finds every entity sharing a cell with area. Each entity is returned
+ * once even if it shares several cells with area.
+ *
+ * @param grid
+ * @param area
+ * @return int The number of indices written to grid->results
+ */
+int queryGrid(SpatialGrid *grid, Rectangle area)
+{
+    int minColumn, minRow, maxColumn, maxRow;
+    int resultCount = 0;
+
+    // Stamps only ever grow, so stamps left over from earlier builds can't match
+    if (grid->queryStamp == INT_MAX)
+    {
+        memset(grid->lastQuery, 0, sizeof(int) * grid->entityCapacity);
+        grid->queryStamp = 0;
+    }
+    grid->queryStamp++;
+    getGridCells(grid, area, &minColumn, &minRow, &maxColumn, &maxRow);
+    for (int row = minRow; row <= maxRow; row++)
+    {
+        for (int column = minColumn; column <= maxColumn; column++)
+        {
+            int cell = row * grid->columns + column;
+            for (int k = grid->cellStart[cell]; k < grid->cellStart[cell + 1]; k++)
+            {
+                int index = grid->items[k];
+                if (grid->lastQuery[index] != grid->queryStamp)
+                {
+                    grid->lastQuery[index] = grid->queryStamp;
+                    grid->results[resultCount++] = index;
+                }
+            }
+        }
+    }
+
+    return resultCount;
+}
+
+// Returns how many bytes initGrid() allocated for this grid
+size_t getGridBytes(SpatialGrid *grid)
+{
+    int cellCount = grid->columns * grid->rows;
+    return sizeof(SpatialGrid) + sizeof(int) * ((cellCount + 1) + cellCount + grid->itemCapacity + 2 * grid->entityCapacity);
+}
+
+// Frees the grid and its storage
+void unloadGrid(SpatialGrid *grid)
+{
+    if (grid == NULL)
+    {
+        return;
+    }
+    MemFree(grid->cellStart);
+    MemFree(grid->cellFill);
+    MemFree(grid->items);
+    MemFree(grid->lastQuery);
+    MemFree(grid->results);
+    MemFree(grid);
+}
+#endif
@@ -0,0 +1,408 @@
+/**
+ * @file Jobs.h
+ * @author Kevin Pluas
+ * @brief Work-stealing job system used to run update phases across threads
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _JOBS_H
+#define _JOBS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+//----------------------------------------------------------------------------------
+// Platform threads and atomics. windows.h clashes with raylib (Rectangle, CloseWindow...)
+// so the few Win32 functions needed are declared by hand, the same way raylib does.
+//----------------------------------------------------------------------------------
+#if defined(_WIN32)
+    typedef struct { void *ptr; } JobLock;
+    typedef struct { void *ptr; } JobCondition;
+    typedef void *JobThread;
+
+    __declspec(dllimport) void *__stdcall CreateThread(void *attributes, size_t stackSize, unsigned long (__stdcall *start)(void *), void *parameter, unsigned long flags, unsigned long *threadId);
+    __declspec(dllimport) unsigned long __stdcall WaitForSingleObject(void *handle, unsigned long milliseconds);
+    __declspec(dllimport) int __stdcall CloseHandle(void *handle);
+    __declspec(dllimport) int __stdcall SwitchToThread(void);
+    __declspec(dllimport) unsigned long __stdcall GetActiveProcessorCount(unsigned short groupNumber);
+    __declspec(dllimport) void __stdcall InitializeSRWLock(JobLock *lock);
+    __declspec(dllimport) void __stdcall AcquireSRWLockExclusive(JobLock *lock);
+    __declspec(dllimport) void __stdcall ReleaseSRWLockExclusive(JobLock *lock);
+    __declspec(dllimport) void __stdcall InitializeConditionVariable(JobCondition *condition);
+    __declspec(dllimport) int __stdcall SleepConditionVariableSRW(JobCondition *condition, JobLock *lock, unsigned long milliseconds, unsigned long flags);
+    __declspec(dllimport) void __stdcall WakeAllConditionVariable(JobCondition *condition);
+#else
+    #include <pthread.h>
+    #include <sched.h>
+    #include <unistd.h>
+
+    typedef pthread_mutex_t JobLock;
+    typedef pthread_cond_t JobCondition;
+    typedef pthread_t JobThread;
+#endif
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+    #define ATOMIC_LOAD(ptr) _InterlockedOr((volatile long *)(ptr), 0)
+    #define ATOMIC_STORE(ptr, value) _InterlockedExchange((volatile long *)(ptr), (value))
+    #define ATOMIC_ADD(ptr, value) _InterlockedExchangeAdd((volatile long *)(ptr), (value))
+    #define ATOMIC_CAS(ptr, expected, desired) (_InterlockedCompareExchange((volatile long *)(ptr), (desired), (expected)) == (expected))
+#else
+    #define ATOMIC_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+    #define ATOMIC_STORE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_SEQ_CST)
+    #define ATOMIC_ADD(ptr, value) __atomic_fetch_add((ptr), (value), __ATOMIC_SEQ_CST)
+    #define ATOMIC_CAS(ptr, expected, desired) __atomic_compare_exchange_n((ptr), &(__typeof__(*(ptr))){expected}, (desired), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+#endif
+
+#define MAX_JOB_THREADS 64
+#define JOB_DEQUE_SIZE 256      // Ranges are split in halves, so a deque never holds more than ~32 jobs
+
+// Processes items [start, end) of a parallel for
+typedef void (*JobFunction)(void *data, int start, int end);
+
+/**
+ * @brief A range of items waiting to be processed.
+ *
+ */
+typedef struct Job
+{
+    int start;
+    int end;
+} Job;
+
+/**
+ * @brief Chase-Lev work-stealing deque. Only the owning thread pushes and pops at the
+ * bottom, any other thread may steal from the top.
+ *
+ * Both ends only ever count up, so they are unsigned and allowed to wrap. What the deque
+ * holds is always bottom - top, which stays right across the wrap.
+ *
+ */
+typedef struct JobDeque
+{
+    unsigned int top;
+    unsigned int bottom;
+    Job jobs[JOB_DEQUE_SIZE];
+    char padding[64];           // Keeps neighbouring deques off each other's cache lines
+} JobDeque;
+
+/**
+ * @brief The worker threads and the parallel for they are currently running.
+ *
+ */
+typedef struct JobSystem
+{
+    int threadCount;                        // Workers plus the calling thread
+    JobThread threads[MAX_JOB_THREADS];
+    JobDeque deques[MAX_JOB_THREADS];       // deques[0] belongs to the calling thread
+
+    JobLock lock;
+    JobCondition wake;
+    unsigned int generation;                // Bumped for every parallel for, wakes the workers. Wraps
+    bool quit;
+
+    JobFunction function;                   // The parallel for being run
+    void *data;
+    int grainSize;
+    int remaining;                          // Items not processed yet
+} JobSystem;
+
+typedef struct JobWorker
+{
+    JobSystem *system;
+    int index;
+} JobWorker;
+
+JobSystem jobSystem = {0};
+JobWorker jobWorkers[MAX_JOB_THREADS];
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+int getCoreCount();
+
+void initJobSystem(int threadCount);
+void parallelFor(int count, int grainSize, JobFunction function, void *data);
+void shutdownJobSystem();
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+// Returns the number of logical cores
+int getCoreCount()
+{
+#if defined(_WIN32)
+    return (int)GetActiveProcessorCount(0xffff);
+#else
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+static inline void lockJobs(JobSystem *system)
+{
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(&system->lock);
+#else
+    pthread_mutex_lock(&system->lock);
+#endif
+}
+
+static inline void unlockJobs(JobSystem *system)
+{
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive(&system->lock);
+#else
+    pthread_mutex_unlock(&system->lock);
+#endif
+}
+
+// Must be called with the lock held
+static inline void waitForJobs(JobSystem *system)
+{
+#if defined(_WIN32)
+    SleepConditionVariableSRW(&system->wake, &system->lock, 0xffffffff, 0);
+#else
+    pthread_cond_wait(&system->wake, &system->lock);
+#endif
+}
+
+static inline void wakeWorkers(JobSystem *system)
+{
+#if defined(_WIN32)
+    WakeAllConditionVariable(&system->wake);
+#else
+    pthread_cond_broadcast(&system->wake);
+#endif
+}
+
+static inline void yieldThread()
+{
+#if defined(_WIN32)
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+// Owner only: adds a job at the bottom of the deque
+static inline void pushJob(JobDeque *deque, Job job)
+{
+    unsigned int bottom = ATOMIC_LOAD(&deque->bottom);
+    deque->jobs[bottom & (JOB_DEQUE_SIZE - 1)] = job;
+    ATOMIC_STORE(&deque->bottom, bottom + 1);
+}
+
+// Owner only: takes the most recently pushed job
+static inline bool popJob(JobDeque *deque, Job *job)
+{
+    unsigned int bottom = ATOMIC_LOAD(&deque->bottom) - 1;
+    ATOMIC_STORE(&deque->bottom, bottom);
+    unsigned int top = ATOMIC_LOAD(&deque->top);
+
+    if ((int)(bottom - top) < 0)
+    { // Empty
+        ATOMIC_STORE(&deque->bottom, bottom + 1);
+        return false;
+    }
+
+    *job = deque->jobs[bottom & (JOB_DEQUE_SIZE - 1)];
+    if (top == bottom)
+    { // Last job, race the thieves for it
+        bool won = ATOMIC_CAS(&deque->top, top, top + 1);
+        ATOMIC_STORE(&deque->bottom, bottom + 1);
+        return won;
+    }
+    return true;
+}
+
+// Any thread: takes the oldest job, which is also the biggest range
+static inline bool stealJob(JobDeque *deque, Job *job)
+{
+    unsigned int top = ATOMIC_LOAD(&deque->top);
+    unsigned int bottom = ATOMIC_LOAD(&deque->bottom);
+
+    if ((int)(bottom - top) <= 0)
+    {
+        return false;
+    }
+
+    *job = deque->jobs[top & (JOB_DEQUE_SIZE - 1)];
+    return ATOMIC_CAS(&deque->top, top, top + 1);
+}
+
+/**
+ * @brief Works on the current parallel for until every item is processed. Big ranges
+ * are split in half and the far half is left on this thread's deque for others to steal.
+ *
+ * @param system
+ * @param index The deque owned by the calling thread
+ */
+static void runJobs(JobSystem *system, int index)
+{
+    JobDeque *own = &system->deques[index];
+    Job job;
+
+    while (ATOMIC_LOAD(&system->remaining) > 0)
+    {
+        bool found = popJob(own, &job);
+        for (int i = 1; !found && i < system->threadCount; i++)
+        {
+            found = stealJob(&system->deques[(index + i) % system->threadCount], &job);
+        }
+        if (!found)
+        {
+            yieldThread();
+            continue;
+        }
+
+        while (job.end - job.start > system->grainSize)
+        {
+            int middle = job.start + (job.end - job.start) / 2;
+            pushJob(own, (Job){middle, job.end});
+            job.end = middle;
+        }
+
+        system->function(system->data, job.start, job.end);
+        ATOMIC_ADD(&system->remaining, -(job.end - job.start));
+    }
+}
+
+#if defined(_WIN32)
+static unsigned long __stdcall jobWorkerMain(void *argument)
+#else
+static void *jobWorkerMain(void *argument)
+#endif
+{
+    JobWorker *worker = (JobWorker *)argument;
+    JobSystem *system = worker->system;
+    unsigned int seen = 0;
+
+    for (;;)
+    {
+        lockJobs(system);
+        while (!system->quit && system->generation == seen)
+        {
+            waitForJobs(system);
+        }
+        bool quit = system->quit;
+        seen = system->generation;
+        unlockJobs(system);
+
+        if (quit)
+        {
+            break;
+        }
+        runJobs(system, worker->index);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Starts the worker threads.
+ *
+ * @param threadCount Threads to run jobs on, counting the calling thread. 0 uses one per core
+ */
+void initJobSystem(int threadCount)
+{
+    JobSystem *system = &jobSystem;
+
+    if (threadCount <= 0)
+    {
+        threadCount = getCoreCount();
+    }
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > MAX_JOB_THREADS) threadCount = MAX_JOB_THREADS;
+
+    system->threadCount = threadCount;
+    system->generation = 0;
+    system->quit = false;
+    system->remaining = 0;
+
+#if defined(_WIN32)
+    InitializeSRWLock(&system->lock);
+    InitializeConditionVariable(&system->wake);
+#else
+    pthread_mutex_init(&system->lock, NULL);
+    pthread_cond_init(&system->wake, NULL);
+#endif
+
+    for (int i = 1; i < threadCount; i++)
+    {
+        jobWorkers[i].system = system;
+        jobWorkers[i].index = i;
+#if defined(_WIN32)
+        system->threads[i] = CreateThread(NULL, 0, jobWorkerMain, &jobWorkers[i], 0, NULL);
+#else
+        pthread_create(&system->threads[i], NULL, jobWorkerMain, &jobWorkers[i]);
+#endif
+    }
+
+    TraceLog(LOG_INFO, "JOBS: Running jobs on %d threads", threadCount);
+}
+
+/**
+ * @brief Calls function over [0, count) in ranges of at most grainSize items, spread
+ * over every thread, and returns once all of them are done. Each item must only touch
+ * its own data so the result is the same no matter how many threads there are.
+ *
+ * @param count The number of items
+ * @param grainSize The smallest range worth handing to another thread
+ * @param function
+ * @param data Passed to function
+ */
+void parallelFor(int count, int grainSize, JobFunction function, void *data)
+{
+    JobSystem *system = &jobSystem;
+
+    if (count <= 0)
+    {
+        return;
+    }
+    if (system->threadCount <= 1 || count <= grainSize)
+    { // Not worth waking anyone up
+        function(data, 0, count);
+        return;
+    }
+
+    system->function = function;
+    system->data = data;
+    system->grainSize = grainSize;
+    ATOMIC_STORE(&system->remaining, count);
+    pushJob(&system->deques[0], (Job){0, count});
+
+    lockJobs(system);
+    system->generation++;
+    wakeWorkers(system);
+    unlockJobs(system);
+
+    runJobs(system, 0);
+}
+
+// Stops and joins the worker threads
+void shutdownJobSystem()
+{
+    JobSystem *system = &jobSystem;
+
+    lockJobs(system);
+    system->quit = true;
+    wakeWorkers(system);
+    unlockJobs(system);
+
+    for (int i = 1; i < system->threadCount; i++)
+    {
+#if defined(_WIN32)
+        WaitForSingleObject(system->threads[i], 0xffffffff);
+        CloseHandle(system->threads[i]);
+#else
+        pthread_join(system->threads[i], NULL);
+#endif
+    }
+    system->threadCount = 0;
+}
+#endif
@@ -0,0 +1,342 @@
+/**
+ * @file Levels.h
+ * @author Kevin Pluas
+ * @brief Level and enemy definitions loaded from a text file, reloaded when it changes
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * A levels file has one definition per line. Blank lines and lines starting with #
+ * are ignored.
+ *
+ *     k <name> <min speed> <max speed> <health>
+ *     l <score> <enemy cap> <spawn interval> <spawn budget> <weight of each kind...>
+ *     o <x> <y> <width> <height>
+ *
+ * Every kind has to come before the first level. A level's weights follow the order
+ * the kinds were listed in, and kinds left off the end get a weight of 0. Levels are
+ * listed by increasing score, starting at 0. Obstacles are areas of the playfield the
+ * swarm routes around, in pixels, and hold whatever the level.
+ */
+
+#ifndef _LEVELS_H
+#define _LEVELS_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Structs.h"
+#include "Globals.h"
+#include "Random.h"
+#include "FlowField.h"
+
+#define LEVELS_FILE "resources/levels.txt"
+#define LEVELS_RELOAD_INTERVAL 0.5  // Seconds between checks of the levels file for changes
+
+// The enemy the game spawned before it had levels, used by the benchmarks and when no
+// levels are loaded
+const EnemyKind defaultEnemyKind = { "zombie", 1, 5, 1 };
+
+LevelTable levelTable = { 0 };  // The levels of the current session
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+bool loadLevels(LevelTable *table, const char *fileName);
+bool reloadLevels(LevelTable *table);
+void unloadLevels(LevelTable *table);
+
+int getLevelIndex(LevelTable *table, int score);
+const EnemyKind *pickEnemyKind(LevelTable *table, int level);
+
+void applyLevelObstacles(LevelTable *table, FlowField *field);
+void drawLevelObstacles(LevelTable *table);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+/**
+ * @brief Parses text, the contents of a levels file, into table. Counts the
+ * definitions first so the tables can be carved out of one allocation.
+ *
+ * @param table Zeroed, filled in on success
+ * @param text Modified while parsing
+ * @param fileName Only used in error messages
+ * @return true if every line was valid
+ */
+static bool parseLevels(LevelTable *table, char *text, const char *fileName)
+{
+    int kindCount = 0, levelCount = 0, obstacleCount = 0;
+    for (char *line = text; line != NULL; line = strchr(line, '\n'))
+    {
+        line += (*line == '\n')? 1 : 0;
+        line += strspn(line, " \t");
+        kindCount += (*line == 'k');
+        levelCount += (*line == 'l');
+        obstacleCount += (*line == 'o');
+    }
+    if (levelCount == 0)
+    {
+        TraceLog(LOG_ERROR, "%s has no levels", fileName);
+        return false;
+    }
+
+    table->storage = MemAlloc(sizeof(EnemyKind) * kindCount + sizeof(Level) * levelCount + sizeof(Rectangle) * obstacleCount +
+                              sizeof(int) * levelCount * kindCount);
+    if (table->storage == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error allocating the levels of %s", fileName);
+        return false;
+    }
+    table->kinds = (EnemyKind *)table->storage;
+    table->levels = (Level *)(table->kinds + kindCount);
+    table->obstacles = (Rectangle *)(table->levels + levelCount);
+    table->weights = (int *)(table->obstacles + obstacleCount);
+
+    int lineNumber = 0;
+    char *next = text;
+    while (next != NULL)
+    {
+        char *line = next;
+        next = strchr(line, '\n');
+        if (next != NULL)
+        {
+            *next++ = '\0';
+        }
+        lineNumber++;
+        line += strspn(line, " \t\r");
+
+        if (*line == 'k')
+        {
+            EnemyKind *kind = &table->kinds[table->kindCount];
+            if (table->levelCount > 0)
+            {
+                TraceLog(LOG_ERROR, "%s:%d: kinds have to come before the first level", fileName, lineNumber);
+                return false;
+            }
+            if (sscanf(line, "k %31s %d %d %d", kind->name, &kind->minSpeed, &kind->maxSpeed, &kind->health) != 4 ||
+                kind->minSpeed < 0 || kind->maxSpeed < kind->minSpeed || kind->health < 1)
+            {
+                TraceLog(LOG_ERROR, "%s:%d: expected k <name> <min speed> <max speed> <health>", fileName, lineNumber);
+                return false;
+            }
+            table->kindCount++;
+        }
+        else if (*line == 'l')
+        {
+            Level *level = &table->levels[table->levelCount];
+            int *weights = &table->weights[table->levelCount * kindCount];
+            int read = 0;
+            if (sscanf(line, "l %d %d %d %d%n", &level->scoreReq, &level->maxEnemies, &level->spawnInterval,
+                       &level->spawnBudget, &read) != 4 ||
+                level->maxEnemies < 0 || level->spawnInterval < 1 || level->spawnBudget < 0)
+            {
+                TraceLog(LOG_ERROR, "%s:%d: expected l <score> <enemy cap> <spawn interval> <spawn budget> <weights...>", fileName, lineNumber);
+                return false;
+            }
+
+            int expected = (table->levelCount == 0)? 0 : table->levels[table->levelCount - 1].scoreReq + 1;
+            if ((table->levelCount == 0 && level->scoreReq != 0) || level->scoreReq < expected)
+            {
+                TraceLog(LOG_ERROR, "%s:%d: levels have to start at score 0 and go up from there", fileName, lineNumber);
+                return false;
+            }
+
+            level->totalWeight = 0;
+            for (int k = 0; k < kindCount; k++)
+            {
+                int weight = 0, used = 0;
+                if (sscanf(line + read, "%d%n", &weight, &used) == 1)
+                {
+                    read += used;
+                }
+                if (weight < 0)
+                {
+                    TraceLog(LOG_ERROR, "%s:%d: weights can't be negative", fileName, lineNumber);
+                    return false;
+                }
+                weights[k] = weight;
+                level->totalWeight += weight;
+            }
+            if (sscanf(line + read, " %*s") != EOF)
+            {
+                TraceLog(LOG_ERROR, "%s:%d: more weights than there are kinds, or a weight that isn't a number", fileName, lineNumber);
+                return false;
+            }
+            if (level->spawnBudget > 0 && level->totalWeight == 0)
+            {
+                TraceLog(LOG_ERROR, "%s:%d: the level spawns enemies but gives every kind a weight of 0", fileName, lineNumber);
+                return false;
+            }
+            table->levelCount++;
+        }
+        else if (*line == 'o')
+        {
+            Rectangle *obstacle = &table->obstacles[table->obstacleCount];
+            if (sscanf(line, "o %f %f %f %f", &obstacle->x, &obstacle->y, &obstacle->width, &obstacle->height) != 4 ||
+                obstacle->width <= 0 || obstacle->height <= 0)
+            {
+                TraceLog(LOG_ERROR, "%s:%d: expected o <x> <y> <width> <height>", fileName, lineNumber);
+                return false;
+            }
+            table->obstacleCount++;
+        }
+        else if (*line != '#' && *line != '\0')
+        {
+            TraceLog(LOG_ERROR, "%s:%d: unknown definition '%c'", fileName, lineNumber, *line);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Loads the levels in fileName into table, replacing what it held. If the file
+ * can't be read or has a mistake in it, table is left as it was.
+ *
+ * @param table
+ * @param fileName
+ * @return true if the levels were loaded
+ */
+bool loadLevels(LevelTable *table, const char *fileName)
+{
+    char *text = LoadFileText(fileName);
+    if (text == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error reading levels from %s", fileName);
+        return false;
+    }
+
+    LevelTable loaded = { 0 };
+    bool parsed = parseLevels(&loaded, text, fileName);
+    UnloadFileText(text);
+    if (!parsed)
+    {
+        MemFree(loaded.storage);
+        return false;
+    }
+
+    // Copy the name first, fileName may be table's own
+    snprintf(loaded.fileName, sizeof(loaded.fileName), "%s", fileName);
+    loaded.modTime = GetFileModTime(fileName);
+    loaded.checkedAt = table->checkedAt;
+    unloadLevels(table);
+    *table = loaded;
+
+    TraceLog(LOG_INFO, "Loaded %d levels, %d enemy kinds and %d obstacles from %s", table->levelCount, table->kindCount,
+             table->obstacleCount, fileName);
+    return true;
+}
+
+/**
+ * @brief Loads table's file again if it has been saved since it was last read. Meant
+ * to be called every frame, it only looks at the file every LEVELS_RELOAD_INTERVAL
+ * seconds. Levels take effect from the next tick.
+ *
+ * @param table
+ * @return true if the levels were reloaded
+ */
+bool reloadLevels(LevelTable *table)
+{
+    double now = GetTime();
+    if (table->fileName[0] == '\0' || now - table->checkedAt < LEVELS_RELOAD_INTERVAL)
+    {
+        return false;
+    }
+    table->checkedAt = now;
+
+    long modTime = GetFileModTime(table->fileName);
+    if (modTime == table->modTime)
+    {
+        return false;
+    }
+
+    // Don't try a broken file again until it is saved again
+    table->modTime = modTime;
+    return loadLevels(table, table->fileName);
+}
+
+// Frees the tables and zeroes table
+void unloadLevels(LevelTable *table)
+{
+    MemFree(table->storage);
+    *table = (LevelTable){ 0 };
+}
+
+/**
+ * @brief Finds the level a score has reached.
+ *
+ * @param table
+ * @param score
+ * @return int Index into table->levels, or -1 when no levels are loaded
+ */
+int getLevelIndex(LevelTable *table, int score)
+{
+    int level = table->levelCount - 1;
+    while (level > 0 && table->levels[level].scoreReq > score)
+    {
+        level--;
+    }
+    return level;
+}
+
+/**
+ * @brief Picks the kind of the next enemy a level spawns, at random by the level's
+ * weights.
+ *
+ * @param table
+ * @param level Index from getLevelIndex()
+ * @return const EnemyKind* defaultEnemyKind when no levels are loaded
+ */
+const EnemyKind *pickEnemyKind(LevelTable *table, int level)
+{
+    if (level < 0 || table->levels[level].totalWeight == 0)
+    {
+        return &defaultEnemyKind;
+    }
+
+    const int *weights = &table->weights[level * table->kindCount];
+    int roll = randomInt(RANDOM_SPAWN, 0, table->levels[level].totalWeight - 1);
+    int kind = 0;
+    while (roll >= weights[kind])
+    {
+        roll -= weights[kind++];
+    }
+    return &table->kinds[kind];
+}
+
+/**
+ * @brief Blocks the table's obstacles in field, opening whatever it blocked before, so
+ * the swarm starts routing around them. A field that has no obstacles and gets none is
+ * left alone, and keeps costing nothing.
+ *
+ * @param table
+ * @param field
+ */
+void applyLevelObstacles(LevelTable *table, FlowField *field)
+{
+    if (field->blockedCount == 0 && table->obstacleCount == 0)
+    {
+        return;
+    }
+
+    setFlowObstacle(field, (Rectangle){ 0, 0, field->columns * field->cellSize, field->rows * field->cellSize }, false);
+    for (int i = 0; i < table->obstacleCount; i++)
+    {
+        setFlowObstacle(field, table->obstacles[i], true);
+    }
+}
+
+// Draws the obstacles, which only the swarm has to walk around
+void drawLevelObstacles(LevelTable *table)
+{
+    for (int i = 0; i < table->obstacleCount; i++)
+    {
+        DrawRectangleRec(table->obstacles[i], (Color){ 40, 40, 40, 200 });
+        DrawRectangleLinesEx(table->obstacles[i], 2, DARKGRAY);
+    }
+}
+#endif
@@ -0,0 +1,465 @@
+/**
+ * @file Memory.h
+ * @author Kevin Pluas
+ * @brief Tracking allocator behind raylib's RL_MALLOC and the game's MemAlloc, with
+ * per module statistics, an overlay and a report of what is left at shutdown
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _MEMORY_H
+#define _MEMORY_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "Structs.h"
+#include "Jobs.h"
+
+#define MEMORY_RATE_SMOOTHING 0.05f // Share of the latest frame in the averaged rates, about the last second at 60 FPS
+#define MEMORY_OVERLAY_ROWS 16      // Modules listed in the overlay, those holding the most first
+#define MEMORY_REPORT_BLOCKS 32     // Outstanding allocations listed one by one at shutdown
+
+bool memoryOverlayEnabled = false;  // Toggled with F5
+
+#if defined(SWARM_TRACK_MEMORY)
+
+#define MEMORY_HEADER_SIZE 32       // Put in front of every block. Keeps the caller's pointer aligned as malloc() left it
+#define MEMORY_MAGIC 0x4d454d53u    // Marks a block as the tracker's. Never the top half of a glibc chunk size
+#define MEMORY_MAX_SIZE ((size_t)PTRDIFF_MAX - MEMORY_HEADER_SIZE) // Largest block asked for. With its header it is still a valid object size
+
+/**
+ * @brief Kept at the end of each block's header, right in front of the caller's pointer.
+ * Every live block is on one list, so what is left at shutdown can be listed.
+ *
+ */
+typedef struct MemoryBlock
+{
+    struct MemoryBlock *prev;
+    struct MemoryBlock *next;
+    size_t size;            /**< Bytes the caller asked for. */
+    uint32_t module;        /**< Index into memoryModules. */
+    uint32_t magic;         /**< MEMORY_MAGIC while the block is live. Last, see getMemoryBlock(). */
+} MemoryBlock;
+
+MemoryModule memoryModules[MEMORY_MAX_MODULES]; // One per file that has allocated
+int memoryModuleCount = 0;
+MemoryModule memoryTotal = { .name = "total" }; // Every module added up
+MemoryBlock *memoryBlocks = NULL;               // Live blocks, newest first
+int memoryFrames = 0;                           // Calls to beginMemoryFrame()
+
+// raylib's audio thread allocates too. A zeroed SRW lock is an unlocked one
+#if defined(_WIN32)
+JobLock memoryLock = { 0 };
+#else
+JobLock memoryLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+#endif
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+void beginMemoryFrame();
+int getMemoryStats(MemoryModule *modules, MemoryModule *total);
+void drawMemoryOverlay(int x, int y);
+void reportMemory();
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+#if defined(SWARM_TRACK_MEMORY)
+
+static inline void lockMemory()
+{
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(&memoryLock);
+#else
+    pthread_mutex_lock(&memoryLock);
+#endif
+}
+
+static inline void unlockMemory()
+{
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive(&memoryLock);
+#else
+    pthread_mutex_unlock(&memoryLock);
+#endif
+}
+
+// The header of a block handed out by the tracker. Only its magic may be read before it
+// is known to be one: that sits in the last bytes in front of the pointer, where the C
+// library keeps its own chunk header, so reading it is safe for any block
+static inline MemoryBlock *getMemoryBlock(void *block)
+{
+    return (MemoryBlock *)((char *)block - sizeof(MemoryBlock));
+}
+
+/**
+ * @brief Index of the module a file's allocations count towards, adding it the first time
+ * the file allocates. Files are matched by pointer first, as a file passes the same
+ * __FILE__ every time, then by name, so a header included by several sources counts once.
+ * Must be called with the lock held.
+ *
+ * @param file __FILE__ of the allocation
+ * @return int
+ */
+static int findMemoryModule(const char *file)
+{
+    for (int i = 0; i < memoryModuleCount; i++)
+    {
+        if (memoryModules[i].file == file)
+        {
+            return i;
+        }
+    }
+
+    const char *name = file;
+    for (const char *c = file; *c != '\0'; c++)
+    {
+        if (*c == '/' || *c == '\\')
+        {
+            name = c + 1;
+        }
+    }
+    for (int i = 0; i < memoryModuleCount; i++)
+    {
+        if (strcmp(memoryModules[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+
+    // The last module is kept for every file that doesn't get one of its own
+    if (memoryModuleCount >= MEMORY_MAX_MODULES - 1)
+    {
+        memoryModules[MEMORY_MAX_MODULES - 1].file = "other";
+        memoryModules[MEMORY_MAX_MODULES - 1].name = "other";
+        memoryModuleCount = MEMORY_MAX_MODULES;
+        return MEMORY_MAX_MODULES - 1;
+    }
+    memoryModules[memoryModuleCount] = (MemoryModule){ .file = file, .name = name };
+    return memoryModuleCount++;
+}
+
+static inline void countAllocation(MemoryModule *module, size_t size)
+{
+    module->liveBytes += size;
+    if (module->liveBytes > module->peakBytes)
+    {
+        module->peakBytes = module->liveBytes;
+    }
+    module->liveBlocks++;
+    module->allocations++;
+    module->frameAllocations++;
+    module->frameBytes += size;
+}
+
+static inline void countRelease(MemoryModule *module, size_t size)
+{
+    module->liveBytes -= size;
+    module->liveBlocks--;
+}
+
+static inline void linkMemoryBlock(MemoryBlock *block)
+{
+    block->prev = NULL;
+    block->next = memoryBlocks;
+    if (memoryBlocks != NULL)
+    {
+        memoryBlocks->prev = block;
+    }
+    memoryBlocks = block;
+}
+
+static inline void unlinkMemoryBlock(MemoryBlock *block)
+{
+    if (block->prev != NULL)
+    {
+        block->prev->next = block->next;
+    }
+    else
+    {
+        memoryBlocks = block->next;
+    }
+    if (block->next != NULL)
+    {
+        block->next->prev = block->prev;
+    }
+}
+
+// Fills in the header of a block just allocated and counts it. Returns the caller's pointer
+static void *addMemoryBlock(char *raw, size_t size, const char *file)
+{
+    if (raw == NULL)
+    {
+        return NULL;
+    }
+
+    MemoryBlock *block = (MemoryBlock *)(raw + MEMORY_HEADER_SIZE - sizeof(MemoryBlock));
+    block->size = size;
+    block->magic = MEMORY_MAGIC;
+
+    lockMemory();
+    block->module = findMemoryModule(file);
+    linkMemoryBlock(block);
+    countAllocation(&memoryModules[block->module], size);
+    countAllocation(&memoryTotal, size);
+    unlockMemory();
+    return raw + MEMORY_HEADER_SIZE;
+}
+
+void *trackMalloc(size_t size, const char *file)
+{
+    if (size > MEMORY_MAX_SIZE)
+    {
+        return NULL;
+    }
+    return addMemoryBlock((char *)malloc(MEMORY_HEADER_SIZE + size), size, file);
+}
+
+void *trackCalloc(size_t count, size_t size, const char *file)
+{
+    if (size != 0 && count > MEMORY_MAX_SIZE / size)
+    {
+        return NULL;
+    }
+    return addMemoryBlock((char *)calloc(1, MEMORY_HEADER_SIZE + count * size), count * size, file);
+}
+
+/**
+ * @brief Resizes a block. It then counts towards the module of the file resizing it.
+ * Blocks that didn't come from the tracker, like those of libraries left on the C
+ * library's allocator, are passed through untracked.
+ *
+ * @param block
+ * @param size
+ * @param file __FILE__ of the call
+ * @return void* NULL if the block couldn't be resized, which leaves it as it was
+ */
+void *trackRealloc(void *block, size_t size, const char *file)
+{
+    if (block == NULL)
+    {
+        return trackMalloc(size, file);
+    }
+    MemoryBlock *header = getMemoryBlock(block);
+    if (header->magic != MEMORY_MAGIC)
+    {
+        return realloc(block, size);
+    }
+    if (size > MEMORY_MAX_SIZE)
+    {
+        return NULL;
+    }
+
+    // realloc() may move the header, so the block is off the list while it runs
+    lockMemory();
+    unlinkMemoryBlock(header);
+    size_t oldSize = header->size;
+    uint32_t oldModule = header->module;
+    char *raw = (char *)realloc((char *)block - MEMORY_HEADER_SIZE, MEMORY_HEADER_SIZE + size);
+    if (raw == NULL)
+    {
+        linkMemoryBlock(header);
+        unlockMemory();
+        return NULL;
+    }
+
+    countRelease(&memoryModules[oldModule], oldSize);
+    countRelease(&memoryTotal, oldSize);
+    header = (MemoryBlock *)(raw + MEMORY_HEADER_SIZE - sizeof(MemoryBlock));
+    header->size = size;
+    header->module = findMemoryModule(file);
+    linkMemoryBlock(header);
+    countAllocation(&memoryModules[header->module], size);
+    countAllocation(&memoryTotal, size);
+    unlockMemory();
+    return raw + MEMORY_HEADER_SIZE;
+}
+
+void trackFree(void *block)
+{
+    if (block == NULL)
+    {
+        return;
+    }
+    MemoryBlock *header = getMemoryBlock(block);
+    if (header->magic != MEMORY_MAGIC)
+    {
+        free(block);
+        return;
+    }
+
+    lockMemory();
+    unlinkMemoryBlock(header);
+    countRelease(&memoryModules[header->module], header->size);
+    countRelease(&memoryTotal, header->size);
+    header->magic = 0;
+    unlockMemory();
+    free((char *)block - MEMORY_HEADER_SIZE);
+}
+
+static void startMemoryFrame(MemoryModule *module)
+{
+    module->allocationRate += (module->frameAllocations - module->allocationRate) * MEMORY_RATE_SMOOTHING;
+    module->byteRate += ((float)module->frameBytes - module->byteRate) * MEMORY_RATE_SMOOTHING;
+    module->frameAllocations = 0;
+    module->frameBytes = 0;
+}
+
+static int compareMemoryModules(const void *a, const void *b)
+{
+    const MemoryModule *x = (const MemoryModule *)a;
+    const MemoryModule *y = (const MemoryModule *)b;
+    if (x->liveBytes != y->liveBytes)
+    {
+        return (x->liveBytes < y->liveBytes) - (x->liveBytes > y->liveBytes);
+    }
+    return (x->peakBytes < y->peakBytes) - (x->peakBytes > y->peakBytes);
+}
+
+#endif
+
+// Folds the allocations of the frame that just ended into the per frame rates
+void beginMemoryFrame()
+{
+#if defined(SWARM_TRACK_MEMORY)
+    lockMemory();
+    for (int i = 0; i < memoryModuleCount; i++)
+    {
+        startMemoryFrame(&memoryModules[i]);
+    }
+    startMemoryFrame(&memoryTotal);
+    memoryFrames++;
+    unlockMemory();
+#endif
+}
+
+/**
+ * @brief Copies the statistics of every module, those holding the most first.
+ *
+ * @param modules Room for MEMORY_MAX_MODULES, or NULL for only the total
+ * @param total Every module added up
+ * @return int Modules copied, 0 without memory tracking built in
+ */
+int getMemoryStats(MemoryModule *modules, MemoryModule *total)
+{
+#if defined(SWARM_TRACK_MEMORY)
+    lockMemory();
+    int count = memoryModuleCount;
+    if (modules != NULL)
+    {
+        memcpy(modules, memoryModules, sizeof(MemoryModule) * count);
+    }
+    *total = memoryTotal;
+    unlockMemory();
+
+    if (modules != NULL)
+    {
+        qsort(modules, count, sizeof(MemoryModule), compareMemoryModules);
+    }
+    return count;
+#else
+    (void)modules;
+    *total = (MemoryModule){ .name = "total" };
+    return 0;
+#endif
+}
+
+/**
+ * @brief Draws live and peak bytes, live blocks and allocation rates of the modules
+ * holding the most memory. GPU memory and allocations made outside raylib's and the
+ * game's allocators, like GLFW's or the driver's, aren't seen.
+ *
+ * @param x
+ * @param y
+ */
+void drawMemoryOverlay(int x, int y)
+{
+    const int rowHeight = 12;
+    const int width = 430;
+
+#if defined(SWARM_TRACK_MEMORY)
+    MemoryModule modules[MEMORY_MAX_MODULES];
+    MemoryModule total;
+    int count = getMemoryStats(modules, &total);
+    int rows = (count < MEMORY_OVERLAY_ROWS)? count : MEMORY_OVERLAY_ROWS;
+    int height = (rows + 3) * rowHeight + 10;
+
+    DrawRectangle(x, y, width, height, (Color){ 0, 0, 0, 180 });
+    x += 5;
+    y += 5;
+
+    DrawText("memory", x, y, 10, WHITE);
+    DrawText(TextFormat("%9s %9s %7s %8s %8s", "live KB", "peak KB", "blocks", "allocs/f", "KB/f"), x + 110, y, 10, WHITE);
+    y += rowHeight;
+    for (int i = -1; i < rows; i++)
+    {
+        MemoryModule *module = (i < 0)? &total : &modules[i];
+        DrawText(module->name, x, y, 10, (i < 0)? WHITE : LIGHTGRAY);
+        DrawText(TextFormat("%9.1f %9.1f %7d %8.1f %8.2f", module->liveBytes / 1024.0f, module->peakBytes / 1024.0f,
+                            module->liveBlocks, module->allocationRate, module->byteRate / 1024.0f),
+                 x + 110, y, 10, (i < 0)? WHITE : LIGHTGRAY);
+        y += rowHeight;
+    }
+    if (count > rows)
+    {
+        DrawText(TextFormat("%d more", count - rows), x, y, 10, GRAY);
+    }
+#else
+    DrawRectangle(x, y, width, 2 * rowHeight, (Color){ 0, 0, 0, 180 });
+    DrawText("Memory tracking isn't built in, see --track-memory in the README", x + 5, y + 6, 10, WHITE);
+#endif
+}
+
+/**
+ * @brief Logs what each module holds and has allocated, then every allocation that is
+ * still outstanding. Meant for after CloseWindow(), when raylib has freed what it holds,
+ * so anything listed was leaked by the game or raylib.
+ *
+ */
+void reportMemory()
+{
+#if defined(SWARM_TRACK_MEMORY)
+    MemoryModule modules[MEMORY_MAX_MODULES];
+    MemoryModule total;
+    int count = getMemoryStats(modules, &total);
+
+    // Runs that don't go frame by frame, like the co-op test, have no rate to give
+    TraceLog(LOG_INFO, "MEMORY: %-20s %10s %10s %8s %12s %10s", "module", "live B", "peak KB", "blocks", "allocations", "per frame");
+    for (int i = -1; i < count; i++)
+    {
+        MemoryModule *module = (i < 0)? &total : &modules[i];
+        TraceLog(LOG_INFO, "MEMORY: %-20s %10zu %10zu %8d %12lld %10s", module->name, module->liveBytes,
+                 module->peakBytes / 1024, module->liveBlocks, module->allocations,
+                 (memoryFrames > 0)? TextFormat("%.2f", (double)module->allocations / memoryFrames) : "-");
+    }
+
+    if (total.liveBlocks == 0)
+    {
+        TraceLog(LOG_INFO, "MEMORY: Everything allocated was freed");
+        return;
+    }
+
+    TraceLog(LOG_WARNING, "MEMORY: %d allocations holding %zu bytes were never freed", total.liveBlocks, total.liveBytes);
+    lockMemory();
+    int listed = 0;
+    for (MemoryBlock *block = memoryBlocks; block != NULL && listed < MEMORY_REPORT_BLOCKS; block = block->next, listed++)
+    {
+        TraceLog(LOG_WARNING, "MEMORY:     %zu bytes from %s", block->size, memoryModules[block->module].file);
+    }
+    unlockMemory();
+    if (total.liveBlocks > listed)
+    {
+        TraceLog(LOG_WARNING, "MEMORY:     and %d more", total.liveBlocks - listed);
+    }
+#endif
+}
+
+#endif
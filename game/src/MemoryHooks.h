@@ -0,0 +1,43 @@
+/**
+ * @file MemoryHooks.h
+ * @author Kevin Pluas
+ * @brief Points raylib's allocator macros at the tracking allocator in Memory.h
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+// Force included ahead of every raylib and game source when the workspace is generated
+// with --track-memory, see premake5.lua. raylib and the libraries it bundles only take
+// these macros when they are defined before raylib.h, so this can't include anything of
+// the game's. Both sides have to be built with it: a block from the tracker handed to the
+// C library's free() would crash
+
+#ifndef _MEMORY_HOOKS_H
+#define _MEMORY_HOOKS_H
+
+#include <stddef.h>
+
+#define SWARM_TRACK_MEMORY
+
+void *trackMalloc(size_t size, const char *file);
+void *trackCalloc(size_t count, size_t size, const char *file);
+void *trackRealloc(void *block, size_t size, const char *file);
+void trackFree(void *block);
+
+// Every allocation is tagged with the file it is made in, which names the module it counts towards
+#define RL_MALLOC(size) trackMalloc((size), __FILE__)
+#define RL_CALLOC(count, size) trackCalloc((count), (size), __FILE__)
+#define RL_REALLOC(block, size) trackRealloc((block), (size), __FILE__)
+#define RL_FREE(block) trackFree(block)
+
+// Libraries raylib leaves partly or wholly on the C library's allocator. raudio.c hands
+// miniaudio RL_MALLOC and RL_FREE but not a realloc, and rtext.c frees the glyph bitmaps
+// stb_truetype allocates with RL_FREE
+#define MA_REALLOC(block, size) trackRealloc((block), (size), __FILE__)
+#define STBTT_malloc(size, user) ((void)(user), trackMalloc((size), __FILE__))
+#define STBTT_free(block, user) ((void)(user), trackFree(block))
+
+#endif
@@ -0,0 +1,834 @@
+/**
+ * @file Net.h
+ * @author Kevin Pluas
+ * @brief Two player co-op over UDP, kept in lockstep with rollback
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _NET_H
+#define _NET_H
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include "Structs.h"
+#include "Globals.h"
+#include "Timer.h"
+#include "Random.h"
+#include "Snapshot.h"
+
+#if defined(_WIN32)
+    // winsock2.h pulls in windows.h, which clashes with raylib and with the Win32 functions
+    // Jobs.h and Timer.h declare by hand. The few Winsock calls needed are declared the same
+    // way, linked from ws2_32
+    typedef uintptr_t SOCKET;
+    typedef int socklen_t;
+
+    struct in_addr { uint32_t s_addr; };
+    struct sockaddr { unsigned short sa_family; char sa_data[14]; };
+    struct sockaddr_in { short sin_family; unsigned short sin_port; struct in_addr sin_addr; char sin_zero[8]; };
+
+    // WSADATA is laid out differently on 32 and 64 bits and nothing in it is read, so
+    // WSAStartup() only gets room for the bigger one
+    typedef union { void *align; unsigned char data[512]; } NetWinsockData;
+
+    #define AF_INET 2
+    #define SOCK_DGRAM 2
+    #define IPPROTO_UDP 17
+    #define INADDR_ANY 0u
+    #define FIONBIO ((long)0x8004667EUL)
+    #define MAKEWORD(low, high) ((unsigned short)(((low) & 0xFF) | (((high) & 0xFF) << 8)))
+
+    __declspec(dllimport) int __stdcall WSAStartup(unsigned short version, NetWinsockData *data);
+    __declspec(dllimport) int __stdcall WSACleanup(void);
+    __declspec(dllimport) SOCKET __stdcall socket(int family, int type, int protocol);
+    __declspec(dllimport) int __stdcall bind(SOCKET handle, const struct sockaddr *address, int addressSize);
+    __declspec(dllimport) int __stdcall closesocket(SOCKET handle);
+    __declspec(dllimport) int __stdcall ioctlsocket(SOCKET handle, long command, unsigned long *argument);
+    __declspec(dllimport) int __stdcall sendto(SOCKET handle, const char *data, int size, int flags, const struct sockaddr *to, int toSize);
+    __declspec(dllimport) int __stdcall recvfrom(SOCKET handle, char *data, int capacity, int flags, struct sockaddr *from, int *fromSize);
+    __declspec(dllimport) int __stdcall getsockname(SOCKET handle, struct sockaddr *address, int *addressSize);
+    __declspec(dllimport) int __stdcall inet_pton(int family, const char *text, void *address);
+    __declspec(dllimport) unsigned short __stdcall htons(unsigned short value);
+    __declspec(dllimport) unsigned short __stdcall ntohs(unsigned short value);
+    __declspec(dllimport) unsigned long __stdcall htonl(unsigned long value);
+    __declspec(dllimport) unsigned long __stdcall ntohl(unsigned long value);
+#else
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#define NET_DEFAULT_PORT 7777
+#define NET_MAGIC 0x4D525753u       // "SWRM", the first four bytes of every packet
+#define NET_INPUT_DELAY 2           // Ticks a local input waits before it is played, hiding that much latency
+#define NET_PACKET_INPUTS 32        // Most inputs sent in one packet
+#define NET_CHECKSUM_INTERVAL 15    // Ticks between the confirmed states compared with the peer
+#define NET_HELLO_INTERVAL 0.25     // Seconds between the guest's requests to join
+#define NET_DELAY_SLOTS 256         // Packets the latency shim can hold back at once
+
+// The flags of NetInput.buttons
+#define NET_BUTTON_UP (1 << 0)
+#define NET_BUTTON_DOWN (1 << 1)
+#define NET_BUTTON_LEFT (1 << 2)
+#define NET_BUTTON_RIGHT (1 << 3)
+#define NET_BUTTON_FIRE (1 << 4)
+
+/**
+ * @brief The kinds of packet.
+ *
+ */
+typedef enum NetPacketType
+{
+    NET_HELLO = 1,  // Guest to host, asking to join. Sent until the welcome arrives
+    NET_WELCOME,    // Host to guest, with the seed of the session
+    NET_INPUTS,     // Either way, the sender's inputs from startTick on
+} NetPacketType;
+
+/**
+ * @brief The start of every packet. Both peers run the same build, so it is sent as it
+ * is laid out in memory. NET_INPUTS packets are followed by count NetInputs.
+ *
+ */
+typedef struct NetPacketHeader
+{
+    uint32_t magic;
+    int32_t type;
+    int32_t count;          /**< Inputs after the header. */
+    int32_t startTick;      /**< Tick of the first input. */
+    int32_t ackTick;        /**< The sender has every input before this from the receiver. */
+    int32_t checkTick;      /**< Confirmed tick checksum is from, -1 if none yet. */
+    uint32_t checksum;
+    uint64_t seed;          /**< Only set in NET_WELCOME. */
+} NetPacketHeader;
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+bool openNetSocket(NetSocket *netSocket, int port);
+bool setNetPeer(NetSocket *netSocket, const char *address, int port);
+int getNetSocketPort(NetSocket *netSocket);
+bool setNetShim(NetSocket *netSocket, float latencyMs, float jitterMs, float lossPercent, uint64_t seed);
+void sendNetPacket(NetSocket *netSocket, const void *data, int size, double now);
+void flushNetSocket(NetSocket *netSocket, double now);
+int receiveNetPacket(NetSocket *netSocket, void *data, int capacity);
+void closeNetSocket(NetSocket *netSocket);
+
+bool hostNetSession(NetSession *session, int port, uint64_t seed);
+bool joinNetSession(NetSession *session, const char *address, int port);
+void pumpNetSession(NetSession *session, double now);
+bool advanceNetSession(NetSession *session, GameTick *game, PlayerInput *localInput, void (*runTick)(GameTick *game), double now);
+bool isNetSessionConfirmed(NetSession *session);
+void closeNetSession(NetSession *session);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+/**
+ * @brief Opens a non blocking UDP socket on every local address.
+ *
+ * @param netSocket
+ * @param port Port to listen on, 0 for any free one
+ * @return true if the socket is ready
+ */
+bool openNetSocket(NetSocket *netSocket, int port)
+{
+    *netSocket = (NetSocket){ 0 };
+    netSocket->handle = -1;
+
+#if defined(_WIN32)
+    NetWinsockData data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+    {
+        TraceLog(LOG_ERROR, "NET: Error starting Winsock");
+        return false;
+    }
+#endif
+
+    intptr_t handle = (intptr_t)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (handle < 0)
+    {
+        TraceLog(LOG_ERROR, "NET: Error opening a UDP socket");
+        return false;
+    }
+    netSocket->handle = handle;
+
+    struct sockaddr_in local = { 0 };
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons((uint16_t)port);
+    if (bind(handle, (struct sockaddr *)&local, sizeof(local)) != 0)
+    {
+        TraceLog(LOG_ERROR, "NET: Error binding UDP port %d", port);
+        closeNetSocket(netSocket);
+        return false;
+    }
+
+#if defined(_WIN32)
+    unsigned long nonBlocking = 1;
+    bool ready = ioctlsocket(handle, FIONBIO, &nonBlocking) == 0;
+#else
+    bool ready = fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+    if (!ready)
+    {
+        TraceLog(LOG_ERROR, "NET: Error making the socket non blocking");
+        closeNetSocket(netSocket);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Sets who the socket talks to. A socket with no peer takes the first one that
+ * sends it a packet.
+ *
+ * @param netSocket
+ * @param address IPv4 address in dotted form, or localhost
+ * @param port
+ * @return true if the address could be read
+ */
+bool setNetPeer(NetSocket *netSocket, const char *address, int port)
+{
+    struct in_addr parsed;
+    if (strcmp(address, "localhost") == 0)
+    {
+        address = "127.0.0.1";
+    }
+    if (inet_pton(AF_INET, address, &parsed) != 1)
+    {
+        TraceLog(LOG_ERROR, "NET: %s is not an IPv4 address", address);
+        return false;
+    }
+
+    netSocket->peerAddress = ntohl(parsed.s_addr);
+    netSocket->peerPort = (uint16_t)port;
+    return true;
+}
+
+// Returns the local port the socket is bound to, or 0 if it isn't open
+int getNetSocketPort(NetSocket *netSocket)
+{
+    struct sockaddr_in local;
+    socklen_t localSize = sizeof(local);
+    if (netSocket->handle < 0 || getsockname(netSocket->handle, (struct sockaddr *)&local, &localSize) != 0)
+    {
+        return 0;
+    }
+    return ntohs(local.sin_port);
+}
+
+/**
+ * @brief Makes the socket behave like a worse link than it is: every packet sent is
+ * held back by latency plus up to jitter, and some are dropped. Only what is sent is
+ * affected, so give both ends a shim to slow down both directions.
+ *
+ * @param netSocket
+ * @param latencyMs Delay added to every packet
+ * @param jitterMs Up to this much more delay, at random
+ * @param lossPercent Share of packets dropped
+ * @param seed Seed of the shim's own random numbers, so a test run drops the same packets
+ * @return true unless the shim's queue couldn't be allocated
+ */
+bool setNetShim(NetSocket *netSocket, float latencyMs, float jitterMs, float lossPercent, uint64_t seed)
+{
+    if (netSocket->delayed == NULL)
+    {
+        netSocket->delayed = MemAlloc(sizeof(NetDelayedPacket) * NET_DELAY_SLOTS);
+        if (netSocket->delayed == NULL)
+        {
+            TraceLog(LOG_ERROR, "NET: Error allocating the latency shim");
+            return false;
+        }
+    }
+
+    netSocket->latency = latencyMs / 1000.0f;
+    netSocket->jitter = jitterMs / 1000.0f;
+    netSocket->loss = lossPercent / 100.0f;
+    netSocket->shimRandom = seed;
+    netSocket->delayedCount = 0;
+    return true;
+}
+
+// Sends a datagram to the peer straight away
+static void sendNetDatagram(NetSocket *netSocket, const void *data, int size)
+{
+    struct sockaddr_in peer = { 0 };
+    peer.sin_family = AF_INET;
+    peer.sin_addr.s_addr = htonl(netSocket->peerAddress);
+    peer.sin_port = htons(netSocket->peerPort);
+    sendto(netSocket->handle, (const char *)data, size, 0, (struct sockaddr *)&peer, sizeof(peer));
+}
+
+// Returns a random float in [0, 1) from the shim's generator
+static inline float randomShimFloat(NetSocket *netSocket)
+{
+    return (splitMix64(&netSocket->shimRandom) >> 40) * (1.0f / 16777216.0f);
+}
+
+/**
+ * @brief Sends a packet to the peer, through the shim if it has one. Nothing is sent
+ * before the peer is known.
+ *
+ * @param netSocket
+ * @param data
+ * @param size At most NET_MAX_PACKET bytes
+ * @param now The current time in seconds, in the same clock flushNetSocket() is given
+ */
+void sendNetPacket(NetSocket *netSocket, const void *data, int size, double now)
+{
+    if (netSocket->peerPort == 0 || size > NET_MAX_PACKET)
+    {
+        return;
+    }
+    if (netSocket->delayed == NULL)
+    {
+        sendNetDatagram(netSocket, data, size);
+        return;
+    }
+
+    if (randomShimFloat(netSocket) < netSocket->loss)
+    {
+        return;
+    }
+    if (netSocket->delayedCount == NET_DELAY_SLOTS)
+    { // A link this congested would drop it too
+        return;
+    }
+
+    NetDelayedPacket *packet = &netSocket->delayed[netSocket->delayedCount++];
+    packet->sendAt = now + netSocket->latency + netSocket->jitter * randomShimFloat(netSocket);
+    packet->size = size;
+    memcpy(packet->data, data, size);
+    flushNetSocket(netSocket, now);
+}
+
+// Sends the packets the shim has held back for long enough
+void flushNetSocket(NetSocket *netSocket, double now)
+{
+    for (int i = netSocket->delayedCount - 1; i >= 0; i--)
+    {
+        NetDelayedPacket *packet = &netSocket->delayed[i];
+        if (packet->sendAt <= now)
+        {
+            sendNetDatagram(netSocket, packet->data, packet->size);
+            *packet = netSocket->delayed[--netSocket->delayedCount];
+        }
+    }
+}
+
+/**
+ * @brief Takes the next packet from the peer. Packets from anyone else are thrown
+ * away, and a socket with no peer yet makes the sender its peer.
+ *
+ * @param netSocket
+ * @param data
+ * @param capacity Size of data
+ * @return int Size of the packet, 0 if there is none waiting
+ */
+int receiveNetPacket(NetSocket *netSocket, void *data, int capacity)
+{
+    while (true)
+    {
+        struct sockaddr_in sender;
+        socklen_t senderSize = sizeof(sender);
+        int size = (int)recvfrom(netSocket->handle, (char *)data, capacity, 0, (struct sockaddr *)&sender, &senderSize);
+        if (size <= 0)
+        {
+            return 0;
+        }
+
+        uint32_t address = ntohl(sender.sin_addr.s_addr);
+        uint16_t port = ntohs(sender.sin_port);
+        if (netSocket->peerPort == 0)
+        {
+            netSocket->peerAddress = address;
+            netSocket->peerPort = port;
+        }
+        if (address == netSocket->peerAddress && port == netSocket->peerPort)
+        {
+            return size;
+        }
+    }
+}
+
+// Closes the socket and frees the shim
+void closeNetSocket(NetSocket *netSocket)
+{
+    if (netSocket->handle >= 0)
+    {
+#if defined(_WIN32)
+        closesocket(netSocket->handle);
+        WSACleanup();
+#else
+        close((int)netSocket->handle);
+#endif
+    }
+    MemFree(netSocket->delayed);
+    *netSocket = (NetSocket){ 0 };
+    netSocket->handle = -1;
+}
+
+// Packs a player's input for the wire. The fire flag is for this tick only
+static inline NetInput packNetInput(const PlayerInput *input)
+{
+    NetInput packed = { 0 };
+    packed.buttons = (input->up? NET_BUTTON_UP : 0) | (input->down? NET_BUTTON_DOWN : 0) |
+                     (input->left? NET_BUTTON_LEFT : 0) | (input->right? NET_BUTTON_RIGHT : 0) |
+                     (input->fire? NET_BUTTON_FIRE : 0);
+    packed.aimX = input->aim.x;
+    packed.aimY = input->aim.y;
+    return packed;
+}
+
+static inline PlayerInput unpackNetInput(NetInput input)
+{
+    return (PlayerInput){
+        .up = (input.buttons & NET_BUTTON_UP) != 0,
+        .down = (input.buttons & NET_BUTTON_DOWN) != 0,
+        .left = (input.buttons & NET_BUTTON_LEFT) != 0,
+        .right = (input.buttons & NET_BUTTON_RIGHT) != 0,
+        .fire = (input.buttons & NET_BUTTON_FIRE) != 0,
+        .aim = { input.aimX, input.aimY },
+    };
+}
+
+static inline bool sameNetInput(NetInput a, NetInput b)
+{
+    return a.buttons == b.buttons && a.aimX == b.aimX && a.aimY == b.aimY;
+}
+
+/**
+ * @brief Puts the session back at tick 0. The first NET_INPUT_DELAY ticks of either
+ * player are idle, since no input can reach them.
+ *
+ * @param session
+ */
+static void resetNetSession(NetSession *session)
+{
+    memset(session->localInputs, 0, sizeof(session->localInputs));
+    memset(session->remoteInputs, 0, sizeof(session->remoteInputs));
+    memset(session->usedInputs, 0, sizeof(session->usedInputs));
+    session->localTick = NET_INPUT_DELAY;
+    session->remoteTick = NET_INPUT_DELAY;
+    session->remoteAck = NET_INPUT_DELAY;
+    session->tick = 0;
+    session->rollbackTick = -1;
+    session->lastTick = INT_MAX;
+    for (int i = 0; i < NET_SNAPSHOT_RING; i++)
+    {
+        session->snapshots[i].tick = -1;
+    }
+    for (int i = 0; i < NET_INPUT_RING; i++)
+    {
+        session->checkTicks[i] = -1;
+    }
+    session->comparedTick = -1;
+}
+
+// Zeroes the session and opens its socket
+static bool openNetSession(NetSession *session, int localPlayer, int port)
+{
+    *session = (NetSession){ 0 };
+    session->localPlayer = localPlayer;
+    for (int i = 0; i < NET_SNAPSHOT_RING; i++)
+    {
+        initSnapshot(&session->snapshots[i]);
+    }
+    resetNetSession(session);
+    return openNetSocket(&session->socket, port);
+}
+
+/**
+ * @brief Starts hosting a session on port. The host plays the first player and picks
+ * the seed. The session is connected once a guest says hello.
+ *
+ * @param session
+ * @param port
+ * @param seed
+ * @return true if the socket is open
+ */
+bool hostNetSession(NetSession *session, int port, uint64_t seed)
+{
+    if (!openNetSession(session, 0, port))
+    {
+        return false;
+    }
+    session->seed = seed;
+    TraceLog(LOG_INFO, "NET: Hosting on port %d", port);
+    return true;
+}
+
+/**
+ * @brief Starts joining the session hosted at address:port. The guest plays the
+ * partner. The session is connected once the host's welcome arrives with the seed.
+ *
+ * @param session
+ * @param address
+ * @param port
+ * @return true if the socket is open and the address could be read
+ */
+bool joinNetSession(NetSession *session, const char *address, int port)
+{
+    if (!openNetSession(session, 1, 0) || !setNetPeer(&session->socket, address, port))
+    {
+        return false;
+    }
+    session->lastHello = -NET_HELLO_INTERVAL;
+    TraceLog(LOG_INFO, "NET: Joining %s:%d", address, port);
+    return true;
+}
+
+/**
+ * @brief Tells whether the state at the start of tick is the same on both ends: every
+ * input before it has arrived, it was simulated with them rather than a guess, and its
+ * checksum was kept.
+ *
+ * @param session
+ * @param tick
+ * @return true if its checksum can be compared with the peer's
+ */
+static bool isNetTickConfirmed(NetSession *session, int tick)
+{
+    return tick >= 0 && tick <= session->remoteTick && tick < session->tick &&
+           (session->rollbackTick < 0 || tick <= session->rollbackTick) &&
+           session->checkTicks[tick % NET_INPUT_RING] == tick;
+}
+
+// Sends a packet of header and count inputs
+static void sendNetSessionPacket(NetSession *session, NetPacketHeader header, const NetInput *inputs, double now)
+{
+    unsigned char packet[NET_MAX_PACKET];
+    header.magic = NET_MAGIC;
+    memcpy(packet, &header, sizeof(header));
+    if (header.count > 0)
+    {
+        memcpy(packet + sizeof(header), inputs, sizeof(NetInput) * header.count);
+    }
+    sendNetPacket(&session->socket, packet, sizeof(header) + sizeof(NetInput) * header.count, now);
+    session->stats.packetsSent++;
+}
+
+/**
+ * @brief Sends every local input the peer hasn't acknowledged, up to NET_PACKET_INPUTS,
+ * so an input lost with one packet arrives with the next. The newest confirmed checksum
+ * rides along.
+ *
+ * @param session
+ * @param now
+ */
+static void sendNetInputs(NetSession *session, double now)
+{
+    NetInput inputs[NET_PACKET_INPUTS];
+    int start = session->remoteAck;
+    int count = session->localTick - start;
+    if (count > NET_PACKET_INPUTS)
+    {
+        count = NET_PACKET_INPUTS;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        inputs[i] = session->localInputs[(start + i) % NET_INPUT_RING];
+    }
+
+    // The newest confirmed tick with a checksum
+    int check = (session->remoteTick < session->tick - 1)? session->remoteTick : session->tick - 1;
+    check -= check % NET_CHECKSUM_INTERVAL;
+    bool confirmed = isNetTickConfirmed(session, check);
+
+    NetPacketHeader header = {
+        .type = NET_INPUTS,
+        .count = count,
+        .startTick = start,
+        .ackTick = session->remoteTick,
+        .checkTick = confirmed? check : -1,
+        .checksum = confirmed? session->checksums[check % NET_INPUT_RING] : 0,
+    };
+    sendNetSessionPacket(session, header, inputs, now);
+}
+
+/**
+ * @brief Takes in the peer's inputs. Inputs only count once every earlier one has
+ * arrived too. An input for a tick already simulated on a wrong guess marks the
+ * session to roll back to it.
+ *
+ * @param session
+ * @param header
+ * @param inputs
+ */
+static void receiveNetInputs(NetSession *session, const NetPacketHeader *header, const NetInput *inputs)
+{
+    if (header->ackTick > session->remoteAck && header->ackTick <= session->localTick)
+    {
+        session->remoteAck = header->ackTick;
+    }
+
+    for (int i = 0; i < header->count; i++)
+    {
+        int tick = header->startTick + i;
+        if (tick != session->remoteTick)
+        {
+            continue;
+        }
+
+        session->remoteInputs[tick % NET_INPUT_RING] = inputs[i];
+        if (tick < session->tick && !sameNetInput(inputs[i], session->usedInputs[tick % NET_INPUT_RING]) &&
+            (session->rollbackTick < 0 || tick < session->rollbackTick))
+        {
+            session->rollbackTick = tick;
+        }
+        session->remoteTick++;
+    }
+
+    // Both ends checksum the same ticks, so compare whichever of them both have confirmed
+    int check = header->checkTick;
+    if (check > session->comparedTick && isNetTickConfirmed(session, check))
+    {
+        session->comparedTick = check;
+        session->stats.checksumsCompared++;
+        if (session->checksums[check % NET_INPUT_RING] != header->checksum)
+        {
+            session->stats.desyncs++;
+            TraceLog(LOG_WARNING, "NET: Desync at tick %d, checksum %08x, peer %08x",
+                     check, session->checksums[check % NET_INPUT_RING], header->checksum);
+        }
+    }
+}
+
+/**
+ * @brief Sends what the shim held back and takes in every packet waiting: hellos,
+ * welcomes and inputs. Called by advanceNetSession(), and on its own while waiting for
+ * the peer to connect.
+ *
+ * @param session
+ * @param now The current time in seconds
+ */
+void pumpNetSession(NetSession *session, double now)
+{
+    flushNetSocket(&session->socket, now);
+
+    if (!session->connected && session->localPlayer == 1 && now - session->lastHello >= NET_HELLO_INTERVAL)
+    {
+        sendNetSessionPacket(session, (NetPacketHeader){ .type = NET_HELLO, .checkTick = -1 }, NULL, now);
+        session->lastHello = now;
+    }
+
+    unsigned char packet[NET_MAX_PACKET];
+    int size;
+    while ((size = receiveNetPacket(&session->socket, packet, sizeof(packet))) > 0)
+    {
+        NetPacketHeader header;
+        if (size < (int)sizeof(header))
+        {
+            continue;
+        }
+        memcpy(&header, packet, sizeof(header));
+        if (header.magic != NET_MAGIC || header.count < 0 || header.count > NET_PACKET_INPUTS ||
+            size < (int)(sizeof(header) + sizeof(NetInput) * header.count))
+        {
+            continue;
+        }
+        session->stats.packetsReceived++;
+
+        if (header.type == NET_HELLO && session->localPlayer == 0)
+        { // Welcomed again if the last welcome was lost
+            sendNetSessionPacket(session, (NetPacketHeader){ .type = NET_WELCOME, .checkTick = -1, .seed = session->seed }, NULL, now);
+            if (!session->connected)
+            {
+                TraceLog(LOG_INFO, "NET: Guest joined");
+                session->connected = true;
+            }
+        }
+        else if (header.type == NET_WELCOME && session->localPlayer == 1 && !session->connected)
+        {
+            TraceLog(LOG_INFO, "NET: Joined, seed %llu", (unsigned long long)header.seed);
+            session->seed = header.seed;
+            session->connected = true;
+        }
+        else if (header.type == NET_INPUTS && session->connected)
+        {
+            NetInput inputs[NET_PACKET_INPUTS];
+            memcpy(inputs, packet + sizeof(header), sizeof(NetInput) * header.count);
+            receiveNetInputs(session, &header, inputs);
+        }
+    }
+}
+
+/**
+ * @brief Simulates the session's next tick with the local input and the peer's, or a
+ * guess at it, saving the state from before it first. The guess is the last input
+ * that arrived, held, without the shot.
+ *
+ * @param session
+ * @param game
+ * @param runTick
+ */
+static void simulateNetTick(NetSession *session, GameTick *game, void (*runTick)(GameTick *game))
+{
+    int tick = session->tick;
+    Snapshot *snapshot = &session->snapshots[tick % NET_SNAPSHOT_RING];
+
+    double start = getTimerSeconds();
+    saveSnapshot(snapshot, game);
+    double seconds = getTimerSeconds() - start;
+    session->stats.saves++;
+    session->stats.saveSeconds += seconds;
+    session->stats.maxSaveSeconds = fmax(session->stats.maxSaveSeconds, seconds);
+    session->stats.snapshotBytes = snapshot->size;
+
+    // Kept whether or not the tick rests on a guess. A wrong guess is rolled back, which
+    // simulates the tick again and replaces the checksum before it is confirmed
+    if (tick % NET_CHECKSUM_INTERVAL == 0)
+    {
+        session->checkTicks[tick % NET_INPUT_RING] = tick;
+        session->checksums[tick % NET_INPUT_RING] = checksumSession(game);
+    }
+
+    NetInput remote;
+    if (tick < session->remoteTick)
+    {
+        remote = session->remoteInputs[tick % NET_INPUT_RING];
+    }
+    else
+    {
+        remote = session->remoteInputs[(session->remoteTick - 1) % NET_INPUT_RING];
+        remote.buttons &= ~NET_BUTTON_FIRE;
+    }
+    session->usedInputs[tick % NET_INPUT_RING] = remote;
+
+    NetInput local = session->localInputs[tick % NET_INPUT_RING];
+    PlayerInput inputs[2] = { unpackNetInput(local), unpackNetInput(remote) };
+    if (session->localPlayer == 1)
+    {
+        inputs[0] = unpackNetInput(remote);
+        inputs[1] = unpackNetInput(local);
+    }
+    game->input = &inputs[0];
+    game->partnerInput = &inputs[1];
+    runTick(game);
+    game->input = game->partnerInput = NULL;
+
+    session->tick++;
+}
+
+/**
+ * @brief Goes back to the first tick simulated on a wrong guess and simulates every
+ * tick since again, muted. Measured against TICK_TIME, since it happens on top of the
+ * frame's own ticks.
+ *
+ * @param session
+ * @param game
+ * @param runTick
+ */
+static void rollbackNetSession(NetSession *session, GameTick *game, void (*runTick)(GameTick *game))
+{
+    int from = session->rollbackTick;
+    session->rollbackTick = -1;
+    Snapshot *snapshot = &session->snapshots[from % NET_SNAPSHOT_RING];
+    if (snapshot->tick != from)
+    { // The stall in advanceNetSession() keeps this from happening
+        TraceLog(LOG_ERROR, "NET: No snapshot to roll back to tick %d", from);
+        return;
+    }
+
+    double start = getTimerSeconds();
+    if (!loadSnapshot(snapshot, game))
+    {
+        return;
+    }
+    double seconds = getTimerSeconds() - start;
+    session->stats.loads++;
+    session->stats.loadSeconds += seconds;
+    session->stats.maxLoadSeconds = fmax(session->stats.maxLoadSeconds, seconds);
+
+    int to = session->tick;
+    session->tick = from;
+    resimulating = true;
+    while (session->tick < to && *game->currentScreen == GAMEPLAY)
+    {
+        simulateNetTick(session, game, runTick);
+    }
+    resimulating = false;
+
+    seconds = getTimerSeconds() - start;
+    session->stats.rollbacks++;
+    session->stats.resimulatedTicks += to - from;
+    session->stats.maxRollback = (to - from > session->stats.maxRollback)? to - from : session->stats.maxRollback;
+    session->stats.rollbackSeconds += seconds;
+    session->stats.maxRollbackSeconds = fmax(session->stats.maxRollbackSeconds, seconds);
+    if (seconds > TICK_TIME)
+    {
+        session->stats.overBudget++;
+    }
+}
+
+/**
+ * @brief Advances a connected session by one tick. Takes in the peer's packets, rolls
+ * back if they show a guess was wrong, then simulates the next tick unless the session
+ * is NET_MAX_ROLLBACK ticks ahead of the peer, in which case it waits. Stops once the
+ * game leaves GAMEPLAY, but keeps rolling back if the peer's inputs say otherwise.
+ *
+ * @param session
+ * @param game The state the session simulates. Its input pointers are set per tick
+ * @param localInput Read into the tick NET_INPUT_DELAY ticks ahead. Its fire flag is
+ * cleared once taken
+ * @param runTick Simulates one tick of game
+ * @param now The current time in seconds
+ * @return true if a tick was simulated
+ */
+bool advanceNetSession(NetSession *session, GameTick *game, PlayerInput *localInput, void (*runTick)(GameTick *game), double now)
+{
+    pumpNetSession(session, now);
+    if (session->rollbackTick >= 0)
+    {
+        rollbackNetSession(session, game, runTick);
+    }
+
+    bool advanced = false;
+    if (*game->currentScreen == GAMEPLAY && session->tick < session->lastTick)
+    {
+        if (session->tick - session->remoteTick >= NET_MAX_ROLLBACK)
+        { // A late input could need a snapshot older than the ring keeps
+            session->stats.stalls++;
+        }
+        else
+        {
+            session->localInputs[session->localTick % NET_INPUT_RING] = packNetInput(localInput);
+            session->localTick++;
+            localInput->fire = false;
+
+            simulateNetTick(session, game, runTick);
+            advanced = true;
+        }
+    }
+
+    sendNetInputs(session, now);
+    return advanced;
+}
+
+// True if no tick simulated so far rests on a guess
+bool isNetSessionConfirmed(NetSession *session)
+{
+    return session->remoteTick >= session->tick && session->rollbackTick < 0;
+}
+
+// Closes the session's socket and frees its snapshots
+void closeNetSession(NetSession *session)
+{
+    closeNetSocket(&session->socket);
+    for (int i = 0; i < NET_SNAPSHOT_RING; i++)
+    {
+        unloadSnapshot(&session->snapshots[i]);
+    }
+}
+#endif
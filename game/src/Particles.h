@@ -0,0 +1,273 @@
+/**
+ * @file Particles.h
+ * @author Kevin Pluas
+ * @brief Fixed capacity particle system for impacts, muzzle flashes and deaths
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _PARTICLES_H
+#define _PARTICLES_H
+
+#include <math.h>
+
+#include "Structs.h"
+#include "Globals.h"
+#include "Jobs.h"
+#include "Random.h"
+#include "Steering.h"
+#include "SpriteBatch.h"
+#include "Atlas.h"
+
+#define PARTICLE_COLUMNS 8  // Float columns, the tint column comes after them
+
+// Effects. Particles draw on the RANDOM_EFFECTS stream, so they never change gameplay
+const ParticleEmitter muzzleFlash = { 6, 2.0f, 5.0f, 0.6f, 6, 4.0f, { 255, 220, 120, 255 } };
+const ParticleEmitter impactSparks = { 10, 1.0f, 4.0f, 2.0f, 12, 3.0f, ORANGE };
+const ParticleEmitter enemyDeath = { 24, 0.5f, 3.0f, 2.0f * PI, 30, 5.0f, MAROON };
+const ParticleEmitter playerHit = { 40, 1.0f, 5.0f, 2.0f * PI, 40, 5.0f, RED };
+
+// The particles of the game. Effects are dropped until initParticles() is called, so the
+// headless runs don't pay for them
+ParticleSystem particles = { 0 };
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+bool initParticles(ParticleSystem *system, int capacity);
+
+void emitParticles(ParticleSystem *system, const ParticleEmitter *emitter, Vector2 position, Vector2 direction);
+void updateParticles(ParticleSystem *system);
+void advanceParticles(void *data, int start, int end);
+void advanceParticlesScalar(ParticleSystem *system, int start, int end);
+void renderParticles(ParticleSystem *system);
+void clearParticles(ParticleSystem *system);
+size_t getParticleBytes(ParticleSystem *system);
+void unloadParticles(ParticleSystem *system);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+/**
+ * @brief Allocates every column of the particle system at once. Nothing else is ever
+ * allocated for particles.
+ *
+ * @param system
+ * @param capacity The most particles alive at once
+ * @return true if the storage was allocated
+ */
+bool initParticles(ParticleSystem *system, int capacity)
+{
+    *system = (ParticleSystem){ 0 };
+    system->storage = MemAlloc((sizeof(float) * PARTICLE_COLUMNS + sizeof(Color)) * capacity);
+    if (system->storage == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error initializing %d particles", capacity);
+        return false;
+    }
+
+    float **columns[PARTICLE_COLUMNS] = {
+        &system->x, &system->y, &system->previousX, &system->previousY,
+        &system->velocityX, &system->velocityY, &system->life, &system->scale,
+    };
+    for (int c = 0; c < PARTICLE_COLUMNS; c++)
+    {
+        *columns[c] = (float *)system->storage + (size_t)c * capacity;
+    }
+    system->tint = (Color *)((float *)system->storage + (size_t)PARTICLE_COLUMNS * capacity);
+    system->capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief Emits a burst of particles. Particles that don't fit are dropped, and so are
+ * bursts from ticks simulated again by a rollback. Only call it from the main thread.
+ *
+ * @param system
+ * @param emitter
+ * @param position Where the burst starts
+ * @param direction Middle of the burst's fan. Ignored by bursts that spray all round
+ */
+void emitParticles(ParticleSystem *system, const ParticleEmitter *emitter, Vector2 position, Vector2 direction)
+{
+    if (resimulating)
+    {
+        return;
+    }
+
+    int count = emitter->count;
+    if (count > system->capacity - system->count)
+    {
+        count = system->capacity - system->count;
+    }
+
+    float heading = atan2f(direction.y, direction.x);
+    for (int k = 0; k < count; k++)
+    {
+        int i = system->count++;
+        float angle = heading + (randomFloat(RANDOM_EFFECTS) - 0.5f) * emitter->spread;
+        float speed = emitter->minSpeed + randomFloat(RANDOM_EFFECTS) * (emitter->maxSpeed - emitter->minSpeed);
+
+        system->x[i] = system->previousX[i] = position.x;
+        system->y[i] = system->previousY[i] = position.y;
+        system->velocityX[i] = cosf(angle) * speed;
+        system->velocityY[i] = sinf(angle) * speed;
+        system->life[i] = emitter->life * (1.0f + randomFloat(RANDOM_EFFECTS));
+        system->scale[i] = emitter->scale * (0.75f + 0.5f * randomFloat(RANDOM_EFFECTS));
+        system->tint[i] = emitter->tint;
+    }
+}
+
+/**
+ * @brief Advances every particle one tick, then removes the ones that have run out of
+ * life. The arithmetic is split across the job threads; removal swaps the last live
+ * particle into the gap, so it stays on one thread.
+ *
+ * @param system
+ */
+void updateParticles(ParticleSystem *system)
+{
+    parallelFor(system->count, UPDATE_GRAIN_SIZE, advanceParticles, system);
+
+    for (int i = system->count - 1; i >= 0; i--)
+    {
+        if (system->life[i] > 0.0f)
+        {
+            continue;
+        }
+
+        int last = --system->count;
+        system->x[i] = system->x[last];
+        system->y[i] = system->y[last];
+        system->previousX[i] = system->previousX[last];
+        system->previousY[i] = system->previousY[last];
+        system->velocityX[i] = system->velocityX[last];
+        system->velocityY[i] = system->velocityY[last];
+        system->life[i] = system->life[last];
+        system->scale[i] = system->scale[last];
+        system->tint[i] = system->tint[last];
+    }
+}
+
+/**
+ * @brief Moves particles [start, end) along their velocity, then slows, shrinks and
+ * ages them. Runs on the job threads. Like the kernels in Steering.h, the SIMD paths
+ * use the same operations in the same order as the scalar one.
+ *
+ * @param data The ParticleSystem
+ * @param start
+ * @param end
+ */
+void advanceParticles(void *data, int start, int end)
+{
+    ParticleSystem *system = (ParticleSystem *)data;
+    int i = start;
+
+#if defined(STEERING_AVX)
+    const __m256 drag = _mm256_set1_ps(PARTICLE_DRAG);
+    const __m256 shrink = _mm256_set1_ps(PARTICLE_SHRINK);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(system->x + i);
+        __m256 y = _mm256_loadu_ps(system->y + i);
+        __m256 velocityX = _mm256_loadu_ps(system->velocityX + i);
+        __m256 velocityY = _mm256_loadu_ps(system->velocityY + i);
+
+        _mm256_storeu_ps(system->previousX + i, x);
+        _mm256_storeu_ps(system->previousY + i, y);
+        _mm256_storeu_ps(system->x + i, _mm256_add_ps(x, velocityX));
+        _mm256_storeu_ps(system->y + i, _mm256_add_ps(y, velocityY));
+        _mm256_storeu_ps(system->velocityX + i, _mm256_mul_ps(velocityX, drag));
+        _mm256_storeu_ps(system->velocityY + i, _mm256_mul_ps(velocityY, drag));
+        _mm256_storeu_ps(system->life + i, _mm256_sub_ps(_mm256_loadu_ps(system->life + i), one));
+        _mm256_storeu_ps(system->scale + i, _mm256_mul_ps(_mm256_loadu_ps(system->scale + i), shrink));
+    }
+#elif defined(STEERING_SSE)
+    const __m128 drag = _mm_set1_ps(PARTICLE_DRAG);
+    const __m128 shrink = _mm_set1_ps(PARTICLE_SHRINK);
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(system->x + i);
+        __m128 y = _mm_loadu_ps(system->y + i);
+        __m128 velocityX = _mm_loadu_ps(system->velocityX + i);
+        __m128 velocityY = _mm_loadu_ps(system->velocityY + i);
+
+        _mm_storeu_ps(system->previousX + i, x);
+        _mm_storeu_ps(system->previousY + i, y);
+        _mm_storeu_ps(system->x + i, _mm_add_ps(x, velocityX));
+        _mm_storeu_ps(system->y + i, _mm_add_ps(y, velocityY));
+        _mm_storeu_ps(system->velocityX + i, _mm_mul_ps(velocityX, drag));
+        _mm_storeu_ps(system->velocityY + i, _mm_mul_ps(velocityY, drag));
+        _mm_storeu_ps(system->life + i, _mm_sub_ps(_mm_loadu_ps(system->life + i), one));
+        _mm_storeu_ps(system->scale + i, _mm_mul_ps(_mm_loadu_ps(system->scale + i), shrink));
+    }
+#endif
+
+    advanceParticlesScalar(system, i, end);
+}
+
+// Scalar version of advanceParticles()
+void advanceParticlesScalar(ParticleSystem *system, int start, int end)
+{
+    for (int i = start; i < end; i++)
+    {
+        system->previousX[i] = system->x[i];
+        system->previousY[i] = system->y[i];
+        system->x[i] += system->velocityX[i];
+        system->y[i] += system->velocityY[i];
+        system->velocityX[i] *= PARTICLE_DRAG;
+        system->velocityY[i] *= PARTICLE_DRAG;
+        system->life[i] -= 1.0f;
+        system->scale[i] *= PARTICLE_SHRINK;
+    }
+}
+
+// Queues every particle as one submission of the sprite queue, drawn over the swarm
+void renderParticles(ParticleSystem *system)
+{
+    // Tinted squares from the middle of the atlas' white square, one pixel before
+    // scaling and centred on the particle
+    SpriteLayout layout = {
+        .source = (Rectangle){ whiteSprite.x + 1, whiteSprite.y + 1, whiteSprite.width - 2, whiteSprite.height - 2 },
+        .size = (Vector2){ 1, 1 },
+        .offset = (Vector2){ -0.5f, -0.5f },
+        .origin = (Vector2){ 0.5f, 0.5f },
+    };
+    SpriteColumns columns = {
+        .x = system->x,
+        .y = system->y,
+        .previousX = system->previousX,
+        .previousY = system->previousY,
+        .scale = system->scale,
+        .tint = system->tint,
+        .count = system->count,
+    };
+
+    queueSprites(SPRITE_LAYER_PARTICLES, spriteAtlas.texture, layout, columns, WHITE);
+}
+
+// Removes every particle
+void clearParticles(ParticleSystem *system)
+{
+    system->count = 0;
+}
+
+// Returns how many bytes initParticles() allocated
+size_t getParticleBytes(ParticleSystem *system)
+{
+    return (sizeof(float) * PARTICLE_COLUMNS + sizeof(Color)) * system->capacity;
+}
+
+// Frees the particles' storage
+void unloadParticles(ParticleSystem *system)
+{
+    MemFree(system->storage);
+    *system = (ParticleSystem){ 0 };
+}
+#endif
@@ -0,0 +1,513 @@
+/**
+ * @file Patterns.h
+ * @author Kevin Pluas
+ * @brief Bullet patterns compiled from a text file into bytecode, and the runners playing them
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * A patterns file has one instruction per line. Blank lines and lines starting with #
+ * are ignored.
+ *
+ *     p <name>             starts a pattern, the instructions up to the next one are its own
+ *     fire                 fires a bullet along the heading
+ *     aim                  points the heading back at the aim point
+ *     turn <degrees>       turns the heading, clockwise on screen
+ *     speed <speed>        speed of the bullets fired after it, in pixels per tick
+ *     size <size>          size of the bullets fired after it
+ *     home <degrees>       bullets fired after it turn up to this far a tick towards the
+ *                          enemy closest to the aim point. 0 flies straight again
+ *     wait <ticks>         carries on that many ticks later
+ *     repeat <count>       runs the instructions up to the matching end count times
+ *     end
+ *
+ * Every run starts aimed at the aim point, with BULLET_SPEED and BULLET_SIZE. Players
+ * start with the first pattern, and each bullet power-up moves them on to the next one.
+ */
+
+#ifndef _PATTERNS_H
+#define _PATTERNS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+#include <limits.h>
+
+#include "Structs.h"
+#include "Globals.h"
+#include "Pool.h"
+#include "Bullet.h"
+#include "Particles.h"
+
+#define PATTERNS_FILE "resources/patterns.txt"
+#define PATTERN_MAX_STEPS 4096  // Instructions a runner may run in one tick before it has to wait for the next
+
+PatternTable patternTable = { 0 };      // The patterns players fire. Empty in the benchmarks unless one is given
+PatternRunners patternRunners = { 0 };  // The shots being played out
+int startingWeapon = 0;                 // Pattern players start a session with
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+bool loadPatterns(PatternTable *table, const char *fileName);
+void unloadPatterns(PatternTable *table);
+int findPattern(PatternTable *table, const char *name);
+
+bool firePattern(PatternRunners *runners, PatternTable *table, int pattern, int shooter, Vector2 origin, Vector2 aim, EntityPool *enemies);
+void runPatterns(PatternRunners *runners, PatternTable *table, EntityPool *bullets, const Vector2 *origins);
+void clearPatternRunners(PatternRunners *runners);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+// Appends an instruction and its operand, if it has one, to the code
+static inline void emitPatternOp(PatternTable *table, PatternOp op, const void *operand, size_t size)
+{
+    table->code[table->codeSize++] = (unsigned char)op;
+    if (size > 0)
+    {
+        memcpy(table->code + table->codeSize, operand, size);
+        table->codeSize += (int)size;
+    }
+}
+
+/**
+ * @brief Compiles text, the contents of a patterns file, into table. Counts the lines
+ * first so the patterns and their code can be carved out of one allocation.
+ *
+ * @param table Zeroed, filled in on success
+ * @param text Modified while parsing
+ * @param fileName Only used in error messages
+ * @return true if every line was valid
+ */
+static bool parsePatterns(PatternTable *table, char *text, const char *fileName)
+{
+    int patternCount = 0, lineCount = 0;
+    for (char *line = text; line != NULL; line = strchr(line, '\n'))
+    {
+        line += (*line == '\n')? 1 : 0;
+        line += strspn(line, " \t");
+        patternCount += (line[0] == 'p' && (line[1] == ' ' || line[1] == '\t'));
+        lineCount++;
+    }
+    if (patternCount == 0)
+    {
+        TraceLog(LOG_ERROR, "%s has no patterns", fileName);
+        return false;
+    }
+
+    // No instruction takes more than an op and a float, and every pattern gets an end
+    int codeCapacity = lineCount * (1 + sizeof(float)) + patternCount;
+    table->storage = MemAlloc(sizeof(BulletPattern) * patternCount + codeCapacity);
+    if (table->storage == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error allocating the patterns of %s", fileName);
+        return false;
+    }
+    table->patterns = (BulletPattern *)table->storage;
+    table->code = (unsigned char *)(table->patterns + patternCount);
+
+    BulletPattern *pattern = NULL;
+    int loopStarts[PATTERN_MAX_DEPTH];
+    int loopCounts[PATTERN_MAX_DEPTH];
+    int depth = 0;
+    double multiplier = 1.0;    // Runs of the innermost loop per run of the pattern
+
+    int lineNumber = 0;
+    char *next = text;
+    while (next != NULL)
+    {
+        char *line = next;
+        next = strchr(line, '\n');
+        if (next != NULL)
+        {
+            *next++ = '\0';
+        }
+        lineNumber++;
+        line += strspn(line, " \t\r");
+        if (*line == '#' || *line == '\0' || *line == '\r')
+        {
+            continue;
+        }
+
+        // An instruction word, then an operand for the ones that take one
+        char word[16] = "";
+        char extra[2];
+        float value = 0.0f;
+        int read = 0;
+        sscanf(line, "%15s%n", word, &read);
+        int fields = (sscanf(line + read, " %1s", extra) == 1)? 1 + sscanf(line + read, "%f %1s", &value, extra) : 1;
+        bool bare = (sscanf(line + read, " %1s", extra) != 1);
+        bool isPattern = (strcmp(word, "p") == 0);
+        if (!isPattern && pattern == NULL)
+        {
+            TraceLog(LOG_ERROR, "%s:%d: instructions have to come after a p <name>", fileName, lineNumber);
+            return false;
+        }
+
+        if (isPattern)
+        {
+            if (pattern != NULL && depth > 0)
+            {
+                TraceLog(LOG_ERROR, "%s:%d: %s has a repeat without an end", fileName, lineNumber, pattern->name);
+                return false;
+            }
+            if (pattern != NULL)
+            {
+                emitPatternOp(table, PATTERN_END, NULL, 0);
+            }
+
+            pattern = &table->patterns[table->patternCount];
+            *pattern = (BulletPattern){ 0 };
+            if (sscanf(line, "p %31s %1s", pattern->name, extra) != 1)
+            {
+                TraceLog(LOG_ERROR, "%s:%d: expected p <name>", fileName, lineNumber);
+                return false;
+            }
+            if (findPattern(table, pattern->name) >= 0)
+            {
+                TraceLog(LOG_ERROR, "%s:%d: there is already a pattern called %s", fileName, lineNumber, pattern->name);
+                return false;
+            }
+            pattern->start = table->codeSize;
+            table->patternCount++;
+            multiplier = 1.0;
+        }
+        else if (strcmp(word, "fire") == 0 || strcmp(word, "aim") == 0 || strcmp(word, "end") == 0)
+        {
+            if (!bare)
+            {
+                TraceLog(LOG_ERROR, "%s:%d: %s takes nothing after it", fileName, lineNumber, word);
+                return false;
+            }
+
+            if (word[0] == 'f')
+            {
+                emitPatternOp(table, PATTERN_FIRE, NULL, 0);
+                pattern->bullets = (int)fmin(pattern->bullets + multiplier, INT_MAX / 2);
+            }
+            else if (word[0] == 'a')
+            {
+                emitPatternOp(table, PATTERN_AIM, NULL, 0);
+            }
+            else
+            {
+                if (depth == 0)
+                {
+                    TraceLog(LOG_ERROR, "%s:%d: end without a repeat", fileName, lineNumber);
+                    return false;
+                }
+
+                // The offset is back from the end of the loop instruction
+                depth--;
+                int back = table->codeSize + 1 + (int)sizeof(uint16_t) - loopStarts[depth];
+                if (back > UINT16_MAX)
+                {
+                    TraceLog(LOG_ERROR, "%s:%d: the loop is too long", fileName, lineNumber);
+                    return false;
+                }
+                uint16_t operand = (uint16_t)back;
+                emitPatternOp(table, PATTERN_LOOP, &operand, sizeof(operand));
+                multiplier /= loopCounts[depth];
+            }
+        }
+        else if (strcmp(word, "turn") == 0 || strcmp(word, "speed") == 0 || strcmp(word, "size") == 0 ||
+                 strcmp(word, "home") == 0)
+        {
+            bool positive = (word[0] == 's');
+            if (fields != 2 || (word[0] == 'h' && value < 0.0f) || (positive && value <= 0.0f))
+            {
+                TraceLog(LOG_ERROR, "%s:%d: expected %s <%s>", fileName, lineNumber, word,
+                         (word[0] == 't')? "degrees" : (word[0] == 'h')? "degrees per tick, 0 or more" : "a number above 0");
+                return false;
+            }
+
+            PatternOp op = (word[0] == 't')? PATTERN_TURN : (word[0] == 'h')? PATTERN_HOME :
+                           (word[1] == 'p')? PATTERN_SPEED : PATTERN_SIZE;
+            emitPatternOp(table, op, &value, sizeof(value));
+            pattern->homing = pattern->homing || (op == PATTERN_HOME && value > 0.0f);
+        }
+        else if (strcmp(word, "wait") == 0 || strcmp(word, "repeat") == 0)
+        {
+            if (fields != 2 || value != floorf(value) || value < 1.0f || value > UINT16_MAX)
+            {
+                TraceLog(LOG_ERROR, "%s:%d: expected %s <%s from 1 to %d>", fileName, lineNumber, word,
+                         (word[0] == 'w')? "ticks" : "count", UINT16_MAX);
+                return false;
+            }
+
+            uint16_t operand = (uint16_t)value;
+            if (word[0] == 'w')
+            {
+                emitPatternOp(table, PATTERN_WAIT, &operand, sizeof(operand));
+                continue;
+            }
+            if (depth == PATTERN_MAX_DEPTH)
+            {
+                TraceLog(LOG_ERROR, "%s:%d: loops can only nest %d deep", fileName, lineNumber, PATTERN_MAX_DEPTH);
+                return false;
+            }
+            emitPatternOp(table, PATTERN_REPEAT, &operand, sizeof(operand));
+            loopStarts[depth] = table->codeSize;
+            loopCounts[depth++] = operand;
+            multiplier *= operand;
+        }
+        else
+        {
+            TraceLog(LOG_ERROR, "%s:%d: unknown instruction '%s'", fileName, lineNumber, word);
+            return false;
+        }
+    }
+
+    if (depth > 0)
+    {
+        TraceLog(LOG_ERROR, "%s: %s has a repeat without an end", fileName, pattern->name);
+        return false;
+    }
+    emitPatternOp(table, PATTERN_END, NULL, 0);
+    return true;
+}
+
+/**
+ * @brief Compiles the patterns in fileName into table, replacing what it held. If the
+ * file can't be read or has a mistake in it, table is left as it was. Runners point into
+ * the code, so patterns are only loaded between sessions.
+ *
+ * @param table
+ * @param fileName
+ * @return true if the patterns were loaded
+ */
+bool loadPatterns(PatternTable *table, const char *fileName)
+{
+    char *text = LoadFileText(fileName);
+    if (text == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error reading bullet patterns from %s", fileName);
+        return false;
+    }
+
+    PatternTable loaded = { 0 };
+    bool parsed = parsePatterns(&loaded, text, fileName);
+    UnloadFileText(text);
+    if (!parsed)
+    {
+        MemFree(loaded.storage);
+        return false;
+    }
+
+    unloadPatterns(table);
+    *table = loaded;
+
+    TraceLog(LOG_INFO, "Loaded %d bullet patterns, %d bytes of code, from %s", table->patternCount, table->codeSize, fileName);
+    return true;
+}
+
+// Frees the patterns and zeroes table
+void unloadPatterns(PatternTable *table)
+{
+    MemFree(table->storage);
+    *table = (PatternTable){ 0 };
+}
+
+// Returns the index of the pattern called name, or -1 if there is none
+int findPattern(PatternTable *table, const char *name)
+{
+    for (int i = 0; i < table->patternCount; i++)
+    {
+        if (strcmp(table->patterns[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Starts a shot playing pattern. The pattern runs its first tick in the next
+ * runPatterns(), so a pattern that doesn't wait fires in full on the tick it was shot.
+ *
+ * @param runners
+ * @param table
+ * @param pattern Index into table->patterns
+ * @param shooter 0 for the player, 1 for the partner
+ * @param origin Top left corner of the shooter
+ * @param aim Point the shot is aimed at
+ * @param enemies Searched for the target of a homing pattern
+ * @return true unless every runner was busy
+ */
+bool firePattern(PatternRunners *runners, PatternTable *table, int pattern, int shooter, Vector2 origin, Vector2 aim, EntityPool *enemies)
+{
+    if (runners->count == PATTERN_MAX_RUNNERS)
+    {
+        return false;
+    }
+
+    const BulletPattern *compiled = &table->patterns[pattern];
+    PatternRunner *runner = &runners->runners[runners->count++];
+    *runner = (PatternRunner){
+        .pc = compiled->start,
+        .shooter = shooter,
+        .limit = (int)fmin((double)CURRENT_MAX_BULLETS * compiled->bullets, INT_MAX / 2),
+        .aim = Vector2Normalize(Vector2Subtract(aim, origin)),
+        .speed = BULLET_SPEED,
+        .size = BULLET_SIZE,
+    };
+
+    if (compiled->homing)
+    {
+        int nearest = -1;
+        float nearestDistance = FLT_MAX;
+        for (int i = 0; i < enemies->count; i++)
+        {
+            float dx = enemies->x[i] + enemies->width[i] / 2 - aim.x;
+            float dy = enemies->y[i] + enemies->height[i] / 2 - aim.y;
+            if (dx * dx + dy * dy < nearestDistance)
+            {
+                nearestDistance = dx * dx + dy * dy;
+                nearest = i;
+            }
+        }
+        if (nearest >= 0)
+        {
+            runner->target = getEntityHandle(enemies, nearest);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Runs one runner until it waits or ends. Bullets go straight into the pool, and
+ * the shot's sound and muzzle flash play once however many were fired.
+ *
+ * @param runner
+ * @param code
+ * @param bullets
+ * @param origin Where the shooter is now
+ * @return true if the runner is waiting, false once it has ended
+ */
+static bool runPattern(PatternRunner *runner, const unsigned char *code, EntityPool *bullets, Vector2 origin)
+{
+    if (runner->wait > 0 && --runner->wait > 0)
+    {
+        return true;
+    }
+
+    int fired = 0;
+    Vector2 direction = runner->aim;
+    bool running = true;
+    for (int step = 0; running && step < PATTERN_MAX_STEPS; step++)
+    {
+        PatternOp op = (PatternOp)code[runner->pc++];
+        float value = 0.0f;
+        uint16_t count = 0;
+        if (op >= PATTERN_TURN && op <= PATTERN_HOME)
+        {
+            memcpy(&value, code + runner->pc, sizeof(value));
+            runner->pc += sizeof(value);
+        }
+        else if (op >= PATTERN_WAIT)
+        {
+            memcpy(&count, code + runner->pc, sizeof(count));
+            runner->pc += sizeof(count);
+        }
+
+        switch (op)
+        {
+        case PATTERN_FIRE:
+        {
+            direction = (runner->heading == 0.0f)? runner->aim : Vector2Rotate(runner->aim, runner->heading * DEG2RAD);
+            int bullet = spawnBullet(bullets, runner->limit, origin, direction, runner->speed, runner->size);
+            if (bullet >= 0 && runner->homing > 0.0f && bullets->turn != NULL)
+            {
+                bullets->turn[bullet] = runner->homing * DEG2RAD;
+                bullets->targetSlot[bullet] = runner->target.slot;
+                bullets->targetGeneration[bullet] = runner->target.generation;
+            }
+            fired += (bullet >= 0);
+        }
+        break;
+        case PATTERN_AIM:
+            runner->heading = 0.0f;
+            break;
+        case PATTERN_TURN:
+            runner->heading = fmodf(runner->heading + value, 360.0f);
+            break;
+        case PATTERN_SPEED:
+            runner->speed = value;
+            break;
+        case PATTERN_SIZE:
+            runner->size = value;
+            break;
+        case PATTERN_HOME:
+            runner->homing = value;
+            break;
+        case PATTERN_WAIT:
+            runner->wait = count;
+            running = false;
+            break;
+        case PATTERN_REPEAT:
+            runner->loops[runner->depth++] = count;
+            break;
+        case PATTERN_LOOP:
+            if (--runner->loops[runner->depth - 1] > 0)
+            {
+                runner->pc -= count;
+            }
+            else
+            {
+                runner->depth--;
+            }
+            break;
+        case PATTERN_END:
+        default:
+            running = false;
+            runner->pc = -1;
+            break;
+        }
+    }
+
+    if (fired > 0)
+    {
+        if (!resimulating)
+        {
+            PlaySound(gunFx);
+        }
+        emitParticles(&particles, &muzzleFlash,
+                      (Vector2){ origin.x + 5 + runner->size / 2, origin.y + 5 + runner->size / 2 }, direction);
+    }
+    return runner->pc >= 0;
+}
+
+/**
+ * @brief Plays every shot in flight for a tick, in the order they were fired, and drops
+ * the ones that have ended.
+ *
+ * @param runners
+ * @param table
+ * @param bullets
+ * @param origins Top left corner of each shooter, the player then the partner
+ */
+void runPatterns(PatternRunners *runners, PatternTable *table, EntityPool *bullets, const Vector2 *origins)
+{
+    int kept = 0;
+    for (int i = 0; i < runners->count; i++)
+    {
+        PatternRunner *runner = &runners->runners[i];
+        if (runPattern(runner, table->code, bullets, origins[runner->shooter]))
+        {
+            runners->runners[kept++] = *runner;
+        }
+    }
+    runners->count = kept;
+}
+
+// Drops every shot in flight
+void clearPatternRunners(PatternRunners *runners)
+{
+    runners->count = 0;
+}
+
+#endif
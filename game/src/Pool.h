@@ -0,0 +1,366 @@
+/**
+ * @file Pool.h
+ * @author Kevin Pluas
+ * @brief Entity pool function declarations and definitions
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _POOL_H
+#define _POOL_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "Structs.h"
+
+#define POOL_SLOT_COLUMNS 3     // slot, index, generation, which every pool has
+#define POOL_ALIGNMENT 32       // Column alignment in bytes, enough for an AVX register
+#define POOL_MIN_CAPACITY 8     // Smallest capacity a pool grows to
+
+// Every component column of EntityPool, with the component it belongs to. Expands
+// COLUMN(component, field) once per column, so code that has to touch every column
+// can't miss one
+#define POOL_COMPONENT_COLUMNS(COLUMN)      \
+    COLUMN(COMPONENT_POSITION, x)           \
+    COLUMN(COMPONENT_POSITION, y)           \
+    COLUMN(COMPONENT_PREVIOUS, previousX)   \
+    COLUMN(COMPONENT_PREVIOUS, previousY)   \
+    COLUMN(COMPONENT_DIRECTION, directionX) \
+    COLUMN(COMPONENT_DIRECTION, directionY) \
+    COLUMN(COMPONENT_SPEED, speed)          \
+    COLUMN(COMPONENT_SIZE, width)           \
+    COLUMN(COMPONENT_SIZE, height)          \
+    COLUMN(COMPONENT_HEALTH, health)        \
+    COLUMN(COMPONENT_HOMING, turn)          \
+    COLUMN(COMPONENT_HOMING, targetSlot)    \
+    COLUMN(COMPONENT_HOMING, targetGeneration)
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+EntityPool *initPool(int capacity, unsigned int components);
+bool growPool(EntityPool *pool, int capacity);
+
+int spawnEntity(EntityPool *pool, int limit);
+void despawnEntity(EntityPool *pool, int index);
+void clearPool(EntityPool *pool);
+size_t getPoolBytes(EntityPool *pool);
+void unloadPool(EntityPool *pool);
+
+EntityHandle getEntityHandle(EntityPool *pool, int index);
+int getHandleIndex(EntityPool *pool, EntityHandle handle);
+
+bool queryPool(EntityPool *pool, unsigned int components, const char *system);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+// Bytes of one column of a pool holding capacity entities. Rounded up so every
+// column stays aligned
+static inline size_t getPoolColumnBytes(int capacity)
+{
+    return sizeof(float) * ((capacity + 7) & ~7);
+}
+
+// Number of columns a pool of the given archetype allocates, slots included
+static inline int getPoolColumnCount(unsigned int components)
+{
+    #define COUNT_COLUMN(component, field) + ((components & (component)) != 0)
+    return POOL_SLOT_COLUMNS POOL_COMPONENT_COLUMNS(COUNT_COLUMN);
+    #undef COUNT_COLUMN
+}
+
+/**
+ * @brief Allocates storage for capacity entities and points the columns of the pool's
+ * components into it. Every column is carved out of one allocation and starts on a
+ * POOL_ALIGNMENT boundary. Nothing is copied and the old storage is left alone.
+ *
+ * @param pool Its components decide which columns are laid out
+ * @param capacity
+ * @return true if the allocation succeeded
+ */
+static bool layoutPool(EntityPool *pool, int capacity)
+{
+    size_t columnBytes = getPoolColumnBytes(capacity);
+    void *storage = MemAlloc(columnBytes * getPoolColumnCount(pool->components) + POOL_ALIGNMENT);
+    if (storage == NULL)
+    {
+        return false;
+    }
+
+    char *column = (char *)(((uintptr_t)storage + POOL_ALIGNMENT - 1) & ~(uintptr_t)(POOL_ALIGNMENT - 1));
+    #define LAYOUT_COLUMN(component, field)         \
+        pool->field = NULL;                         \
+        if (pool->components & (component))         \
+        {                                           \
+            pool->field = (void *)column;           \
+            column += columnBytes;                  \
+        }
+    POOL_COMPONENT_COLUMNS(LAYOUT_COLUMN)
+    #undef LAYOUT_COLUMN
+    pool->slot = (int *)column; column += columnBytes;
+    pool->index = (int *)column; column += columnBytes;
+    pool->generation = (unsigned int *)column;
+    pool->storage = storage;
+
+    return true;
+}
+
+// Hands out slots [from, to) to the indices of the same number, as fresh free slots
+static inline void initPoolSlots(EntityPool *pool, int from, int to)
+{
+    for (int i = from; i < to; i++)
+    {
+        pool->slot[i] = i;
+        pool->index[i] = i;
+        pool->generation[i] = 1;    // Generation 0 is left for the zero handle
+    }
+}
+
+/**
+ * @brief Allocates a pool with room for capacity entities. The pool grows past that
+ * on demand, so capacity is only a starting point.
+ *
+ * @param capacity The number of entities to make room for up front
+ * @param components The archetype of the pool's entities, e.g. ARCHETYPE_ENEMY
+ * @return EntityPool* or NULL if the allocation failed
+ */
+EntityPool *initPool(int capacity, unsigned int components)
+{
+    EntityPool *pool = MemAlloc(sizeof(EntityPool));
+    if (pool == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error initializing entity pool");
+        return NULL;
+    }
+
+    if (capacity < POOL_MIN_CAPACITY)
+    {
+        capacity = POOL_MIN_CAPACITY;
+    }
+    pool->components = components;
+    if (!layoutPool(pool, capacity))
+    {
+        TraceLog(LOG_ERROR, "Error initializing entity pool storage");
+        MemFree(pool);
+        return NULL;
+    }
+
+    initPoolSlots(pool, 0, capacity);
+    pool->count = 0;
+    pool->capacity = capacity;
+
+    return pool;
+}
+
+/**
+ * @brief Moves the pool into storage for capacity entities. Live entities keep their
+ * indices and handles, but every column moves.
+ *
+ * @param pool
+ * @param capacity Does nothing unless this is more than the current capacity
+ * @return true if the pool can now hold capacity entities
+ */
+bool growPool(EntityPool *pool, int capacity)
+{
+    if (capacity <= pool->capacity)
+    {
+        return true;
+    }
+
+    EntityPool grown = *pool;
+    if (!layoutPool(&grown, capacity))
+    {
+        TraceLog(LOG_ERROR, "Error growing entity pool to %d entities", capacity);
+        return false;
+    }
+
+    #define GROW_COLUMN(component, field)                                               \
+        if (pool->field != NULL)                                                        \
+        {                                                                               \
+            memcpy(grown.field, pool->field, sizeof(*pool->field) * pool->count);      \
+        }
+    POOL_COMPONENT_COLUMNS(GROW_COLUMN)
+    #undef GROW_COLUMN
+
+    // Free slots live past count and their generations matter too, so copy every slot
+    memcpy(grown.slot, pool->slot, sizeof(int) * pool->capacity);
+    memcpy(grown.index, pool->index, sizeof(int) * pool->capacity);
+    memcpy(grown.generation, pool->generation, sizeof(unsigned int) * pool->capacity);
+    initPoolSlots(&grown, pool->capacity, capacity);
+
+    MemFree(pool->storage);
+    grown.capacity = capacity;
+    *pool = grown;
+
+    return true;
+}
+
+/**
+ * @brief Takes the next free entity from the pool in O(1), doubling the pool first if
+ * it is full.
+ *
+ * @param pool
+ * @param limit The current cap on live entities, e.g. CURRENT_MAX_ENEMIES
+ * @return int The index of a zeroed entity, or -1 if the pool is at its limit or
+ * couldn't grow
+ */
+int spawnEntity(EntityPool *pool, int limit)
+{
+    if (pool->count >= limit)
+    {
+        return -1;
+    }
+    if (pool->count == pool->capacity && !growPool(pool, pool->capacity * 2))
+    {
+        return -1;
+    }
+
+    int index = pool->count++;
+    pool->index[pool->slot[index]] = index;
+    #define ZERO_COLUMN(component, field)   \
+        if (pool->field != NULL)            \
+        {                                   \
+            pool->field[index] = 0;         \
+        }
+    POOL_COMPONENT_COLUMNS(ZERO_COLUMN)
+    #undef ZERO_COLUMN
+
+    return index;
+}
+
+// Retires a slot, so every handle taken from it goes stale
+static inline void retirePoolSlot(EntityPool *pool, int slot)
+{
+    if (++pool->generation[slot] == 0)
+    { // Wrapped, skip the generation the zero handle uses
+        pool->generation[slot] = 1;
+    }
+}
+
+/**
+ * @brief Returns the entity at index to the pool in O(1). The last live entity is
+ * moved into the hole, so loops that despawn while iterating should walk backwards.
+ * Handles to the moved entity stay valid, handles to the despawned one go stale.
+ *
+ * @param pool
+ * @param index
+ */
+void despawnEntity(EntityPool *pool, int index)
+{
+    int last = --pool->count;
+    int freed = pool->slot[index];
+    retirePoolSlot(pool, freed);
+
+    if (index != last)
+    {
+        #define MOVE_COLUMN(component, field)               \
+            if (pool->field != NULL)                        \
+            {                                               \
+                pool->field[index] = pool->field[last];     \
+            }
+        POOL_COMPONENT_COLUMNS(MOVE_COLUMN)
+        #undef MOVE_COLUMN
+
+        // The moved entity takes its slot along, the freed slot goes to the free end
+        int moved = pool->slot[last];
+        pool->slot[index] = moved;
+        pool->index[moved] = index;
+        pool->slot[last] = freed;
+    }
+}
+
+// Returns the body of the entity at index
+static inline Rectangle getEntityBody(EntityPool *pool, int index)
+{
+    return (Rectangle){ pool->x[index], pool->y[index], pool->width[index], pool->height[index] };
+}
+
+// Returns the area the body of the entity at index swept through during the last tick
+static inline Rectangle getSweptBody(EntityPool *pool, int index)
+{
+    float minX = fminf(pool->previousX[index], pool->x[index]);
+    float minY = fminf(pool->previousY[index], pool->y[index]);
+    return (Rectangle){ minX, minY,
+                        fmaxf(pool->previousX[index], pool->x[index]) - minX + pool->width[index],
+                        fmaxf(pool->previousY[index], pool->y[index]) - minY + pool->height[index] };
+}
+
+// Despawns every live entity in the pool
+void clearPool(EntityPool *pool)
+{
+    for (int i = 0; i < pool->count; i++)
+    {
+        retirePoolSlot(pool, pool->slot[i]);
+    }
+    pool->count = 0;
+}
+
+// Returns how many bytes this pool has allocated
+size_t getPoolBytes(EntityPool *pool)
+{
+    return sizeof(EntityPool) + getPoolColumnBytes(pool->capacity) * getPoolColumnCount(pool->components) + POOL_ALIGNMENT;
+}
+
+// Frees the pool and its storage
+void unloadPool(EntityPool *pool)
+{
+    if (pool == NULL)
+    {
+        return;
+    }
+    MemFree(pool->storage);
+    MemFree(pool);
+}
+
+// Returns a handle to the live entity at index
+EntityHandle getEntityHandle(EntityPool *pool, int index)
+{
+    int slot = pool->slot[index];
+    return (EntityHandle){ (unsigned int)slot, pool->generation[slot] };
+}
+
+/**
+ * @brief Finds where the entity a handle refers to currently is.
+ *
+ * @param pool The pool the handle was taken from
+ * @param handle
+ * @return int The entity's index, or -1 if it has been despawned
+ */
+int getHandleIndex(EntityPool *pool, EntityHandle handle)
+{
+    if (handle.slot >= (unsigned int)pool->capacity || pool->generation[handle.slot] != handle.generation)
+    {
+        return -1;
+    }
+
+    return pool->index[handle.slot];
+}
+
+/**
+ * @brief Checks that a pool's archetype has every component a system is about to read
+ * or write. Systems call it once per run rather than per entity.
+ *
+ * @param pool
+ * @param components The components the system needs
+ * @param system Name of the system, for the error message
+ * @return true if the system can run on pool
+ */
+bool queryPool(EntityPool *pool, unsigned int components, const char *system)
+{
+    if ((pool->components & components) != components)
+    {
+        TraceLog(LOG_ERROR, "%s needs components %#x, the pool only has %#x", system, components, pool->components);
+        return false;
+    }
+
+    return true;
+}
+#endif
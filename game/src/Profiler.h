@@ -0,0 +1,235 @@
+/**
+ * @file Profiler.h
+ * @author Kevin Pluas
+ * @brief Per frame phase history, on screen overlay and CSV export
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Structs.h"
+#include "Timer.h"
+#include "SpriteBatch.h"
+
+#define PROFILER_HISTORY 240                // Frames kept, 4 seconds at 60 FPS
+#define PROFILER_TOTAL PHASE_COUNT          // History column holding the whole frame
+#define PROFILER_GRAPH_SCALE 4.0f           // Graph pixels per millisecond
+
+/**
+ * @brief Summary of one phase over the recorded frames, in milliseconds.
+ *
+ */
+typedef struct PhaseStats
+{
+    float min;
+    float avg;
+    float p99;
+} PhaseStats;
+
+float profilerHistory[PROFILER_HISTORY][PHASE_COUNT + 1];  // Milliseconds per phase, one row per frame
+int profilerFrames = 0;                                     // Frames recorded since the profiler was turned on
+double profilerFrameStart = 0.0;
+
+const Color profilerColors[PHASE_COUNT] = {
+    VIOLET, ORANGE, RED, MAROON, PINK, PURPLE, BEIGE, BROWN, GOLD, SKYBLUE, GREEN, LIME, DARKGRAY,
+};
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+void setProfilerEnabled(bool enabled);
+void beginProfilerFrame();
+void endProfilerFrame();
+
+PhaseStats getPhaseStats(int column);
+void drawProfilerOverlay(int x, int y);
+bool exportProfilerCsv(const char *fileName);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+// Turns phase timing on or off. Turning it on starts a fresh history
+void setProfilerEnabled(bool enabled)
+{
+    phaseTimingEnabled = enabled;
+    profilerFrames = 0;
+    resetPhaseTimings();
+}
+
+// Starts timing a frame
+void beginProfilerFrame()
+{
+    if (!phaseTimingEnabled)
+    {
+        return;
+    }
+
+    resetPhaseTimings();
+    profilerFrameStart = getTimerSeconds();
+}
+
+// Stores the phase totals of the frame that just ended in the history
+void endProfilerFrame()
+{
+    if (!phaseTimingEnabled)
+    {
+        return;
+    }
+
+    float *row = profilerHistory[profilerFrames % PROFILER_HISTORY];
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+        row[i] = (float)(phaseSeconds[i] * 1000.0);
+    }
+    row[PROFILER_TOTAL] = (float)((getTimerSeconds() - profilerFrameStart) * 1000.0);
+    profilerFrames++;
+}
+
+static int compareFloats(const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Min, average and 99th percentile of a history column over the recorded frames.
+ *
+ * @param column A ProfilePhase or PROFILER_TOTAL
+ * @return PhaseStats
+ */
+PhaseStats getPhaseStats(int column)
+{
+    PhaseStats stats = { 0 };
+    int count = (profilerFrames < PROFILER_HISTORY)? profilerFrames : PROFILER_HISTORY;
+    if (count == 0)
+    {
+        return stats;
+    }
+
+    float sorted[PROFILER_HISTORY];
+    float sum = 0.0f;
+    for (int i = 0; i < count; i++)
+    {
+        sorted[i] = profilerHistory[i][column];
+        sum += sorted[i];
+    }
+    qsort(sorted, count, sizeof(float), compareFloats);
+
+    stats.min = sorted[0];
+    stats.avg = sum / count;
+    stats.p99 = sorted[(count * 99 + 99) / 100 - 1];
+    return stats;
+}
+
+/**
+ * @brief Draws a table of min/avg/p99 per phase, the sprite counters of the last frame
+ * and a stacked graph of the recorded frames, newest on the right. The line across the
+ * graph is one tick.
+ *
+ * @param x
+ * @param y
+ */
+void drawProfilerOverlay(int x, int y)
+{
+    const int rowHeight = 12;
+    const int graphHeight = (int)(TICK_TIME * 1000.0f * PROFILER_GRAPH_SCALE * 2);
+    int width = PROFILER_HISTORY + 20;
+    int height = (PHASE_COUNT + 3) * rowHeight + graphHeight + 20;
+
+    DrawRectangle(x, y, width + 150, height, (Color){ 0, 0, 0, 180 });
+    x += 5;
+    y += 5;
+
+    DrawText("ms", x + 10, y, 10, WHITE);
+    DrawText(TextFormat("%6s %6s %6s", "min", "avg", "p99"), x + 170, y, 10, WHITE);
+    y += rowHeight;
+    for (int i = 0; i <= PHASE_COUNT; i++)
+    {
+        PhaseStats stats = getPhaseStats(i);
+        Color color = (i < PHASE_COUNT)? profilerColors[i] : WHITE;
+        const char *name = (i < PHASE_COUNT)? phaseNames[i] : "frame";
+
+        DrawRectangle(x, y + 2, 6, 6, color);
+        DrawText(name, x + 10, y, 10, WHITE);
+        DrawText(TextFormat("%6.2f %6.2f %6.2f", stats.min, stats.avg, stats.p99), x + 170, y, 10, WHITE);
+        y += rowHeight;
+    }
+    DrawText(TextFormat("sprites: %d drawn, %d culled, %d draws", spriteStats.drawn, spriteStats.culled, spriteStats.submissions),
+             x + 10, y, 10, WHITE);
+    y += rowHeight;
+
+    // Stacked bars, one pixel per frame
+    int count = (profilerFrames < PROFILER_HISTORY)? profilerFrames : PROFILER_HISTORY;
+    int base = y + 5 + graphHeight;
+    for (int f = 0; f < count; f++)
+    {
+        float *row = profilerHistory[(profilerFrames - count + f) % PROFILER_HISTORY];
+        float top = (float)base;
+        for (int i = 0; i < PHASE_COUNT; i++)
+        {
+            float barHeight = row[i] * PROFILER_GRAPH_SCALE;
+            if (top - barHeight < base - graphHeight)
+            { // Clip frames taller than the graph
+                barHeight = top - (base - graphHeight);
+            }
+            if (barHeight > 0)
+            {
+                DrawRectangleRec((Rectangle){ x + f, top - barHeight, 1, barHeight }, profilerColors[i]);
+                top -= barHeight;
+            }
+        }
+    }
+    int tickLine = base - (int)(TICK_TIME * 1000.0f * PROFILER_GRAPH_SCALE);
+    DrawLine(x, tickLine, x + PROFILER_HISTORY, tickLine, WHITE);
+}
+
+/**
+ * @brief Writes the recorded frames, oldest first, as one CSV row per frame.
+ *
+ * @param fileName
+ * @return true if the file was written
+ */
+bool exportProfilerCsv(const char *fileName)
+{
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error opening %s for the profiler export", fileName);
+        return false;
+    }
+
+    fprintf(file, "frame");
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+        fprintf(file, ",%s", phaseNames[i]);
+    }
+    fprintf(file, ",total\n");
+
+    int count = (profilerFrames < PROFILER_HISTORY)? profilerFrames : PROFILER_HISTORY;
+    for (int f = 0; f < count; f++)
+    {
+        int frame = profilerFrames - count + f;
+        float *row = profilerHistory[frame % PROFILER_HISTORY];
+        fprintf(file, "%d", frame);
+        for (int i = 0; i <= PHASE_COUNT; i++)
+        {
+            fprintf(file, ",%.4f", row[i]);
+        }
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+    TraceLog(LOG_INFO, "Wrote %d profiled frames to %s", count, fileName);
+    return true;
+}
+#endif
@@ -0,0 +1,155 @@
+/**
+ * @file Random.h
+ * @author Kevin Pluas
+ * @brief Seeded random number streams
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _RANDOM_H
+#define _RANDOM_H
+
+#include <stdint.h>
+
+/**
+ * @brief Independent random streams. Each system draws from its own stream so that,
+ * for example, grabbing a power-up doesn't shift every enemy spawn that follows.
+ *
+ */
+typedef enum RandomStream
+{
+    RANDOM_SPAWN = 0,   // Enemy spawn side, position and speed
+    RANDOM_POWERUP,     // Power-up effect and position
+    RANDOM_EFFECTS,     // Cosmetic effects that don't change gameplay
+    RANDOM_INPUT,       // Input generated by the headless benchmark
+    RANDOM_STREAM_COUNT,
+} RandomStream;
+
+/**
+ * @brief xoshiro128** generator state.
+ *
+ */
+typedef struct RandomState
+{
+    uint32_t s[4];
+} RandomState;
+
+uint64_t randomSeed = 0;                            // The seed of the current session
+RandomState randomStreams[RANDOM_STREAM_COUNT];
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+void seedRandom(uint64_t seed);
+
+uint32_t randomNext(RandomStream stream);
+int randomInt(RandomStream stream, int min, int max);
+float randomFloat(RandomStream stream);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+// splitmix64, only used to spread a seed over the generator state
+static inline uint64_t splitMix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint32_t rotateLeft(uint32_t x, int k)
+{
+    return (x << k) | (x >> (32 - k));
+}
+
+/**
+ * @brief Seeds every stream. The same seed always produces the same sequence on
+ * every stream, so a session with the same seed and inputs replays exactly.
+ *
+ * @param seed
+ */
+void seedRandom(uint64_t seed)
+{
+    randomSeed = seed;
+    for (int i = 0; i < RANDOM_STREAM_COUNT; i++)
+    {
+        // Mix the stream index in so streams don't share a sequence
+        uint64_t x = seed ^ (0xD1B54A32D192ED03ULL * (uint64_t)(i + 1));
+        uint64_t a = splitMix64(&x);
+        uint64_t b = splitMix64(&x);
+
+        randomStreams[i].s[0] = (uint32_t)a;
+        randomStreams[i].s[1] = (uint32_t)(a >> 32);
+        randomStreams[i].s[2] = (uint32_t)b;
+        randomStreams[i].s[3] = (uint32_t)(b >> 32);
+    }
+}
+
+// Returns the next 32 random bits from stream
+uint32_t randomNext(RandomStream stream)
+{
+    uint32_t *s = randomStreams[stream].s;
+    uint32_t result = rotateLeft(s[1] * 5, 7) * 9;
+    uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotateLeft(s[3], 11);
+
+    return result;
+}
+
+/**
+ * @brief Returns a random integer in [min, max] without modulo bias, the same way
+ * GetRandomValue() is called.
+ *
+ * @param stream
+ * @param min
+ * @param max
+ * @return int
+ */
+int randomInt(RandomStream stream, int min, int max)
+{
+    if (min > max)
+    {
+        int tmp = max;
+        max = min;
+        min = tmp;
+    }
+
+    // Lemire's multiply and reject: only the few values that would make the range
+    // uneven are drawn again
+    uint32_t range = (uint32_t)(max - min) + 1;
+    if (range == 0)
+    { // The full 32 bit range
+        return (int)randomNext(stream);
+    }
+    uint64_t m = (uint64_t)randomNext(stream) * range;
+    uint32_t low = (uint32_t)m;
+    if (low < range)
+    {
+        uint32_t threshold = (0u - range) % range;
+        while (low < threshold)
+        {
+            m = (uint64_t)randomNext(stream) * range;
+            low = (uint32_t)m;
+        }
+    }
+
+    return min + (int)(m >> 32);
+}
+
+// Returns a random float in [0, 1)
+float randomFloat(RandomStream stream)
+{
+    return (randomNext(stream) >> 8) * (1.0f / 16777216.0f);
+}
+#endif
@@ -0,0 +1,284 @@
+/**
+ * @file Replay.h
+ * @author Kevin Pluas
+ * @brief Records sessions as raylib automation events and plays them back
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+#include <string.h>
+
+#include "Structs.h"
+
+/**
+ * @brief The events a replay is made of. raylib keeps AutomationEventType private to
+ * rcore.c, so these reuse its values by hand. That way ExportAutomationEventList()
+ * labels every line of a replay file with a sensible name.
+ *
+ */
+typedef enum ReplayEventType
+{
+    REPLAY_SEED = 0,        // EVENT_NONE, params: low and high 32 bits of the seed
+    REPLAY_KEY_UP = 1,      // INPUT_KEY_UP, params: key
+    REPLAY_KEY_DOWN = 2,    // INPUT_KEY_DOWN, params: key
+    REPLAY_FIRE = 6,        // INPUT_MOUSE_BUTTON_DOWN, params: button
+    REPLAY_AIM = 7,         // INPUT_MOUSE_POSITION, params: x, y rounded, then the exact bits of x and y
+    REPLAY_END = 18,        // WINDOW_CLOSE, params: checksum, whether the checksum is valid
+} ReplayEventType;
+
+// The keys behind PlayerInput's movement flags, in the order of replayMovement()
+const int replayKeys[4] = { KEY_W, KEY_S, KEY_A, KEY_D };
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+bool startReplayRecording(Replay *replay, uint64_t seed);
+void recordReplayTick(Replay *replay, PlayerInput *input);
+bool finishReplayRecording(Replay *replay, uint32_t checksum, const char *fileName);
+
+bool loadReplay(Replay *replay, const char *fileName);
+bool playReplayTick(Replay *replay, PlayerInput *input);
+void unloadReplay(Replay *replay);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+// Points at the movement flags of input, in the order of replayKeys
+static inline void replayMovement(PlayerInput *input, bool *flags[4])
+{
+    flags[0] = &input->up;
+    flags[1] = &input->down;
+    flags[2] = &input->left;
+    flags[3] = &input->right;
+}
+
+// Appends an event at the current tick. The last slot is kept for the end event
+static bool addReplayEvent(Replay *replay, ReplayEventType type, int param0, int param1, int param2, int param3)
+{
+    AutomationEventList *list = &replay->events;
+    if (list->count + 1 >= list->capacity)
+    {
+        TraceLog(LOG_WARNING, "Replay is full, recording stopped at tick %d", replay->tick);
+        replay->length = replay->tick;
+        replay->recording = false;
+        return false;
+    }
+
+    list->events[list->count++] = (AutomationEvent){ (unsigned int)replay->tick, type, { param0, param1, param2, param3 } };
+    return true;
+}
+
+/**
+ * @brief Starts recording a session. Call it right after the session has been started
+ * with seed, then call recordReplayTick() before every tick.
+ *
+ * @param replay Zeroed, or left over from an earlier recording or playback
+ * @param seed The seed the session was started with
+ * @return true if recording started
+ */
+bool startReplayRecording(Replay *replay, uint64_t seed)
+{
+    unloadReplay(replay);
+    replay->events = LoadAutomationEventList(NULL);
+    if (replay->events.events == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error initializing replay");
+        return false;
+    }
+
+    replay->seed = seed;
+    replay->recording = true;
+    addReplayEvent(replay, REPLAY_SEED, (int)(uint32_t)seed, (int)(uint32_t)(seed >> 32), 0, 0);
+    return true;
+}
+
+/**
+ * @brief Records the input a tick is about to be simulated with. Only changes are
+ * stored, and the aim only when a shot is fired, since that is the only time the
+ * simulation reads it.
+ *
+ * @param replay
+ * @param input
+ */
+void recordReplayTick(Replay *replay, PlayerInput *input)
+{
+    if (!replay->recording)
+    {
+        return;
+    }
+
+    bool *now[4], *was[4];
+    replayMovement(input, now);
+    replayMovement(&replay->input, was);
+    for (int k = 0; k < 4; k++)
+    {
+        if (*now[k] != *was[k])
+        {
+            addReplayEvent(replay, *now[k]? REPLAY_KEY_DOWN : REPLAY_KEY_UP, replayKeys[k], 0, 0, 0);
+        }
+    }
+
+    if (input->fire)
+    {
+        int bitsX, bitsY;
+        memcpy(&bitsX, &input->aim.x, sizeof(int));
+        memcpy(&bitsY, &input->aim.y, sizeof(int));
+        addReplayEvent(replay, REPLAY_AIM, (int)roundf(input->aim.x), (int)roundf(input->aim.y), bitsX, bitsY);
+        addReplayEvent(replay, REPLAY_FIRE, MOUSE_BUTTON_LEFT, 0, 0, 0);
+    }
+
+    replay->input = *input;
+    replay->input.fire = false;
+    replay->tick++;
+}
+
+/**
+ * @brief Ends the recording and writes it to fileName as an automation events file.
+ *
+ * @param replay
+ * @param checksum checksumGame() after the last recorded tick
+ * @param fileName
+ * @return true if the replay was written
+ */
+bool finishReplayRecording(Replay *replay, uint32_t checksum, const char *fileName)
+{
+    if (replay->events.events == NULL)
+    {
+        return false;
+    }
+
+    // A recording that filled up stopped early, and checksum is from a later tick
+    replay->hasChecksum = replay->recording;
+    if (replay->recording)
+    {
+        replay->length = replay->tick;
+        replay->recording = false;
+    }
+
+    AutomationEventList *list = &replay->events;
+    list->events[list->count++] = (AutomationEvent){ (unsigned int)replay->length, REPLAY_END,
+                                                     { replay->hasChecksum? (int)checksum : 0, replay->hasChecksum, 0, 0 } };
+
+    bool saved = ExportAutomationEventList(*list, fileName);
+    if (saved)
+    {
+        TraceLog(LOG_INFO, "Saved a %d tick replay to %s", replay->length, fileName);
+    }
+    else
+    {
+        TraceLog(LOG_ERROR, "Error saving replay to %s", fileName);
+    }
+
+    unloadReplay(replay);
+    return saved;
+}
+
+/**
+ * @brief Loads a replay saved by finishReplayRecording(), ready to play from its first
+ * tick. The session still has to be started with replay->seed.
+ *
+ * @param replay
+ * @param fileName
+ * @return true if the file held a complete replay
+ */
+bool loadReplay(Replay *replay, const char *fileName)
+{
+    unloadReplay(replay);
+    if (!FileExists(fileName))
+    {
+        TraceLog(LOG_ERROR, "No replay at %s", fileName);
+        return false;
+    }
+
+    replay->events = LoadAutomationEventList(fileName);
+    replay->length = -1;
+    for (unsigned int i = 0; i < replay->events.count; i++)
+    {
+        AutomationEvent *event = &replay->events.events[i];
+        if (event->type == REPLAY_SEED)
+        {
+            replay->seed = (uint64_t)(uint32_t)event->params[0] | ((uint64_t)(uint32_t)event->params[1] << 32);
+        }
+        else if (event->type == REPLAY_END)
+        {
+            replay->length = (int)event->frame;
+            replay->checksum = (uint32_t)event->params[0];
+            replay->hasChecksum = event->params[1] != 0;
+        }
+    }
+
+    if (replay->length < 0)
+    {
+        TraceLog(LOG_ERROR, "Replay %s has no end event", fileName);
+        unloadReplay(replay);
+        return false;
+    }
+
+    TraceLog(LOG_INFO, "Loaded a %d tick replay from %s", replay->length, fileName);
+    return true;
+}
+
+/**
+ * @brief Produces the input of the next tick of a loaded replay.
+ *
+ * @param replay
+ * @param input Overwritten with the recorded input
+ * @return false once every tick has been played
+ */
+bool playReplayTick(Replay *replay, PlayerInput *input)
+{
+    if (replay->tick >= replay->length)
+    {
+        return false;
+    }
+
+    bool *flags[4];
+    replayMovement(&replay->input, flags);
+    AutomationEventList *list = &replay->events;
+    for (; replay->cursor < (int)list->count && (int)list->events[replay->cursor].frame <= replay->tick; replay->cursor++)
+    {
+        AutomationEvent *event = &list->events[replay->cursor];
+        switch (event->type)
+        {
+        case REPLAY_KEY_UP:
+        case REPLAY_KEY_DOWN:
+            for (int k = 0; k < 4; k++)
+            {
+                if (event->params[0] == replayKeys[k])
+                {
+                    *flags[k] = (event->type == REPLAY_KEY_DOWN);
+                }
+            }
+            break;
+        case REPLAY_AIM:
+            memcpy(&replay->input.aim.x, &event->params[2], sizeof(float));
+            memcpy(&replay->input.aim.y, &event->params[3], sizeof(float));
+            break;
+        case REPLAY_FIRE:
+            replay->input.fire = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    *input = replay->input;
+    replay->input.fire = false;
+    replay->tick++;
+    return true;
+}
+
+// Frees the replay's events and zeroes it
+void unloadReplay(Replay *replay)
+{
+    UnloadAutomationEventList(&replay->events);
+    *replay = (Replay){ 0 };
+}
+#endif
@@ -0,0 +1,363 @@
+/**
+ * @file Snapshot.h
+ * @author Kevin Pluas
+ * @brief Snapshots of the simulation state, for rolling back, and its checksum
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+#include <string.h>
+
+#include "Structs.h"
+#include "Globals.h"
+#include "Pool.h"
+#include "Random.h"
+#include "Patterns.h"
+
+#define SNAPSHOT_MIN_CAPACITY 4096  // Bytes a snapshot starts with, it doubles from there
+
+// Expands to the address and size of value, for writeSnapshot() and readSnapshot()
+#define SNAPSHOT_VALUE(value) &(value), sizeof(value)
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+void initSnapshot(Snapshot *snapshot);
+bool saveSnapshot(Snapshot *snapshot, GameTick *tick);
+bool loadSnapshot(Snapshot *snapshot, GameTick *tick);
+void unloadSnapshot(Snapshot *snapshot);
+
+uint32_t checksumGame(Entity *player, EntityPool *bullets, EntityPool *enemies);
+uint32_t checksumSession(GameTick *tick);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+// Empties snapshot. Nothing is allocated until the first save
+void initSnapshot(Snapshot *snapshot)
+{
+    *snapshot = (Snapshot){ 0 };
+    snapshot->tick = -1;
+}
+
+// Appends size bytes to the snapshot, growing it if they don't fit
+static bool writeSnapshot(Snapshot *snapshot, const void *data, size_t size)
+{
+    if (snapshot->size + size > snapshot->capacity)
+    {
+        size_t capacity = (snapshot->capacity > 0)? snapshot->capacity : SNAPSHOT_MIN_CAPACITY;
+        while (capacity < snapshot->size + size)
+        {
+            capacity *= 2;
+        }
+
+        unsigned char *data = MemRealloc(snapshot->data, capacity);
+        if (data == NULL)
+        {
+            TraceLog(LOG_ERROR, "Error growing a snapshot to %zu bytes", capacity);
+            return false;
+        }
+        snapshot->data = data;
+        snapshot->capacity = capacity;
+    }
+
+    memcpy(snapshot->data + snapshot->size, data, size);
+    snapshot->size += size;
+    return true;
+}
+
+// Copies the size bytes at *cursor out of the snapshot and moves the cursor past them
+static inline void readSnapshot(const Snapshot *snapshot, size_t *cursor, void *data, size_t size)
+{
+    memcpy(data, snapshot->data + *cursor, size);
+    *cursor += size;
+}
+
+/**
+ * @brief Writes the live entities of a pool and every one of its slots. Only the
+ * columns of the pool's archetype are written, and only [0, count) of those, so an
+ * empty pool costs next to nothing whatever its capacity.
+ *
+ * @param snapshot
+ * @param pool
+ * @return true if it all fit
+ */
+static bool writePool(Snapshot *snapshot, EntityPool *pool)
+{
+    bool written = writeSnapshot(snapshot, SNAPSHOT_VALUE(pool->count)) &&
+                   writeSnapshot(snapshot, SNAPSHOT_VALUE(pool->capacity));
+
+    #define WRITE_COLUMN(component, field)                                                      \
+        if (pool->field != NULL)                                                                \
+        {                                                                                       \
+            written = written && writeSnapshot(snapshot, pool->field, sizeof(*pool->field) * pool->count); \
+        }
+    POOL_COMPONENT_COLUMNS(WRITE_COLUMN)
+    #undef WRITE_COLUMN
+
+    // Free slots and their generations are what the next spawns hand out
+    return written &&
+           writeSnapshot(snapshot, pool->slot, sizeof(int) * pool->capacity) &&
+           writeSnapshot(snapshot, pool->index, sizeof(int) * pool->capacity) &&
+           writeSnapshot(snapshot, pool->generation, sizeof(unsigned int) * pool->capacity);
+}
+
+/**
+ * @brief Reads back what writePool() wrote. The pool grows if it is smaller than it was
+ * then. If it has grown since, the slots past the old capacity are handed out fresh,
+ * the way growPool() would hand them out when the spawns come round again.
+ *
+ * @param snapshot
+ * @param cursor
+ * @param pool Must have the archetype it was written with
+ * @return true unless the pool couldn't grow
+ */
+static bool readPool(const Snapshot *snapshot, size_t *cursor, EntityPool *pool)
+{
+    int count;
+    int capacity;
+    readSnapshot(snapshot, cursor, SNAPSHOT_VALUE(count));
+    readSnapshot(snapshot, cursor, SNAPSHOT_VALUE(capacity));
+    if (!growPool(pool, capacity))
+    {
+        return false;
+    }
+
+    pool->count = count;
+    #define READ_COLUMN(component, field)                                               \
+        if (pool->field != NULL)                                                        \
+        {                                                                               \
+            readSnapshot(snapshot, cursor, pool->field, sizeof(*pool->field) * count);  \
+        }
+    POOL_COMPONENT_COLUMNS(READ_COLUMN)
+    #undef READ_COLUMN
+
+    readSnapshot(snapshot, cursor, pool->slot, sizeof(int) * capacity);
+    readSnapshot(snapshot, cursor, pool->index, sizeof(int) * capacity);
+    readSnapshot(snapshot, cursor, pool->generation, sizeof(unsigned int) * capacity);
+    initPoolSlots(pool, capacity, pool->capacity);
+    return true;
+}
+
+/**
+ * @brief Writes the flow field's buffers and the progress of the pass under way. The
+ * front and back buffers swap pointers, so they are copied by content. Obstacles are
+ * left out, they are only ever set between ticks.
+ *
+ * With no obstacles enemies never read the field, so nothing but that is written. The
+ * field is most of a snapshot otherwise, and an open arena is the usual case.
+ *
+ * @param snapshot
+ * @param field
+ * @return true if it all fit
+ */
+static bool writeFlowField(Snapshot *snapshot, FlowField *field)
+{
+    bool used = field->blockedCount > 0;
+    if (!writeSnapshot(snapshot, SNAPSHOT_VALUE(used)))
+    {
+        return false;
+    }
+    if (!used)
+    {
+        return true;
+    }
+
+    size_t cells = (size_t)field->columns * field->rows;
+    return writeSnapshot(snapshot, field->directionX, sizeof(float) * cells) &&
+           writeSnapshot(snapshot, field->directionY, sizeof(float) * cells) &&
+           writeSnapshot(snapshot, field->direct, cells) &&
+           writeSnapshot(snapshot, field->nextDirectionX, sizeof(float) * cells) &&
+           writeSnapshot(snapshot, field->nextDirectionY, sizeof(float) * cells) &&
+           writeSnapshot(snapshot, field->nextDirect, cells) &&
+           writeSnapshot(snapshot, field->distance, sizeof(int) * cells) &&
+           writeSnapshot(snapshot, field->queue, sizeof(int) * cells) &&
+           writeSnapshot(snapshot, SNAPSHOT_VALUE(field->readyGoal)) &&
+           writeSnapshot(snapshot, SNAPSHOT_VALUE(field->queueHead)) &&
+           writeSnapshot(snapshot, SNAPSHOT_VALUE(field->queueTail)) &&
+           writeSnapshot(snapshot, SNAPSHOT_VALUE(field->cursor)) &&
+           writeSnapshot(snapshot, SNAPSHOT_VALUE(field->goal)) &&
+           writeSnapshot(snapshot, SNAPSHOT_VALUE(field->pendingGoal));
+}
+
+// Reads back what writeFlowField() wrote. A field that wasn't written is left as it is
+static void readFlowField(const Snapshot *snapshot, size_t *cursor, FlowField *field)
+{
+    bool used;
+    readSnapshot(snapshot, cursor, SNAPSHOT_VALUE(used));
+    if (!used)
+    {
+        return;
+    }
+
+    size_t cells = (size_t)field->columns * field->rows;
+    readSnapshot(snapshot, cursor, field->directionX, sizeof(float) * cells);
+    readSnapshot(snapshot, cursor, field->directionY, sizeof(float) * cells);
+    readSnapshot(snapshot, cursor, field->direct, cells);
+    readSnapshot(snapshot, cursor, field->nextDirectionX, sizeof(float) * cells);
+    readSnapshot(snapshot, cursor, field->nextDirectionY, sizeof(float) * cells);
+    readSnapshot(snapshot, cursor, field->nextDirect, cells);
+    readSnapshot(snapshot, cursor, field->distance, sizeof(int) * cells);
+    readSnapshot(snapshot, cursor, field->queue, sizeof(int) * cells);
+    readSnapshot(snapshot, cursor, SNAPSHOT_VALUE(field->readyGoal));
+    readSnapshot(snapshot, cursor, SNAPSHOT_VALUE(field->queueHead));
+    readSnapshot(snapshot, cursor, SNAPSHOT_VALUE(field->queueTail));
+    readSnapshot(snapshot, cursor, SNAPSHOT_VALUE(field->cursor));
+    readSnapshot(snapshot, cursor, SNAPSHOT_VALUE(field->goal));
+    readSnapshot(snapshot, cursor, SNAPSHOT_VALUE(field->pendingGoal));
+}
+
+/**
+ * @brief Saves everything a tick reads and writes into snapshot, replacing what it held:
+ * the globals the game keeps its score and caps in, the random streams, the players,
+ * the power-up, the pools and the flow field. The collision grid and the flock are
+ * rebuilt from the enemies every tick and the particles are only for show, so they
+ * are left out.
+ *
+ * @param snapshot
+ * @param tick The state to save, with frame pointing at the tick it is from
+ * @return true unless the snapshot couldn't grow
+ */
+bool saveSnapshot(Snapshot *snapshot, GameTick *tick)
+{
+    snapshot->size = 0;
+    snapshot->tick = -1;
+
+    bool saved = writeSnapshot(snapshot, SNAPSHOT_VALUE(*tick->frame)) &&
+                 writeSnapshot(snapshot, SNAPSHOT_VALUE(*tick->previousScore)) &&
+                 writeSnapshot(snapshot, SNAPSHOT_VALUE(*tick->currentScreen)) &&
+                 writeSnapshot(snapshot, SNAPSHOT_VALUE(currentScore)) &&
+                 writeSnapshot(snapshot, SNAPSHOT_VALUE(CURRENT_MAX_BULLETS)) &&
+                 writeSnapshot(snapshot, SNAPSHOT_VALUE(CURRENT_MAX_ENEMIES)) &&
+                 writeSnapshot(snapshot, SNAPSHOT_VALUE(playerV)) &&
+                 writeSnapshot(snapshot, SNAPSHOT_VALUE(randomStreams)) &&
+                 writeSnapshot(snapshot, SNAPSHOT_VALUE(randomSeed)) &&
+                 writeSnapshot(snapshot, SNAPSHOT_VALUE(*tick->player)) &&
+                 (tick->partner == NULL || writeSnapshot(snapshot, SNAPSHOT_VALUE(*tick->partner))) &&
+                 writeSnapshot(snapshot, SNAPSHOT_VALUE(*tick->powerup)) &&
+                 writeSnapshot(snapshot, SNAPSHOT_VALUE(patternRunners.count)) &&
+                 writeSnapshot(snapshot, patternRunners.runners, sizeof(PatternRunner) * patternRunners.count) &&
+                 writePool(snapshot, tick->bullets) &&
+                 writePool(snapshot, tick->enemies) &&
+                 writeFlowField(snapshot, tick->flow);
+    if (!saved)
+    {
+        return false;
+    }
+
+    snapshot->tick = (int)*tick->frame;    // Co-op sessions play in real time, far from overflowing
+    return true;
+}
+
+/**
+ * @brief Puts the state saved in snapshot back, so the game carries on from the start
+ * of the tick it was saved at.
+ *
+ * @param snapshot
+ * @param tick The same objects the snapshot was saved from, or ones with the same
+ * archetypes and sizes
+ * @return true unless the snapshot is empty or a pool couldn't grow
+ */
+bool loadSnapshot(Snapshot *snapshot, GameTick *tick)
+{
+    if (snapshot->tick < 0)
+    {
+        TraceLog(LOG_ERROR, "Loading an empty snapshot");
+        return false;
+    }
+
+    size_t cursor = 0;
+    readSnapshot(snapshot, &cursor, SNAPSHOT_VALUE(*tick->frame));
+    readSnapshot(snapshot, &cursor, SNAPSHOT_VALUE(*tick->previousScore));
+    readSnapshot(snapshot, &cursor, SNAPSHOT_VALUE(*tick->currentScreen));
+    readSnapshot(snapshot, &cursor, SNAPSHOT_VALUE(currentScore));
+    readSnapshot(snapshot, &cursor, SNAPSHOT_VALUE(CURRENT_MAX_BULLETS));
+    readSnapshot(snapshot, &cursor, SNAPSHOT_VALUE(CURRENT_MAX_ENEMIES));
+    readSnapshot(snapshot, &cursor, SNAPSHOT_VALUE(playerV));
+    readSnapshot(snapshot, &cursor, SNAPSHOT_VALUE(randomStreams));
+    readSnapshot(snapshot, &cursor, SNAPSHOT_VALUE(randomSeed));
+    readSnapshot(snapshot, &cursor, SNAPSHOT_VALUE(*tick->player));
+    if (tick->partner != NULL)
+    {
+        readSnapshot(snapshot, &cursor, SNAPSHOT_VALUE(*tick->partner));
+    }
+    readSnapshot(snapshot, &cursor, SNAPSHOT_VALUE(*tick->powerup));
+    readSnapshot(snapshot, &cursor, SNAPSHOT_VALUE(patternRunners.count));
+    readSnapshot(snapshot, &cursor, patternRunners.runners, sizeof(PatternRunner) * patternRunners.count);
+    if (!readPool(snapshot, &cursor, tick->bullets) || !readPool(snapshot, &cursor, tick->enemies))
+    {
+        TraceLog(LOG_ERROR, "Error loading the snapshot of tick %d", snapshot->tick);
+        return false;
+    }
+    readFlowField(snapshot, &cursor, tick->flow);
+
+    return true;
+}
+
+// Frees the snapshot's buffer and empties it
+void unloadSnapshot(Snapshot *snapshot)
+{
+    MemFree(snapshot->data);
+    initSnapshot(snapshot);
+}
+
+// Folds size bytes of data into an FNV-1a hash
+static inline uint32_t hashBytes(uint32_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Hashes the player, bullets, enemies and score. Two sessions with the same seed
+ * and inputs must end with the same checksum.
+ *
+ * @param player
+ * @param bullets
+ * @param enemies
+ * @return uint32_t FNV-1a hash of the game state
+ */
+uint32_t checksumGame(Entity *player, EntityPool *bullets, EntityPool *enemies)
+{
+    uint32_t hash = 2166136261u;
+
+    hash = hashBytes(hash, &currentScore, sizeof(int));
+    hash = hashBytes(hash, &player->body, sizeof(Rectangle));
+    hash = hashBytes(hash, &player->health, sizeof(int));
+    for (int i = 0; i < enemies->count; i++)
+    {
+        Rectangle body = getEntityBody(enemies, i);
+        hash = hashBytes(hash, &body, sizeof(Rectangle));
+    }
+    for (int i = 0; i < bullets->count; i++)
+    {
+        Rectangle body = getEntityBody(bullets, i);
+        hash = hashBytes(hash, &body, sizeof(Rectangle));
+    }
+
+    return hash;
+}
+
+// checksumGame() with the partner folded in, when there is one
+uint32_t checksumSession(GameTick *tick)
+{
+    uint32_t hash = checksumGame(tick->player, tick->bullets, tick->enemies);
+    if (tick->partner != NULL)
+    {
+        hash = hashBytes(hash, &tick->partner->body, sizeof(Rectangle));
+        hash = hashBytes(hash, &tick->partner->health, sizeof(int));
+    }
+    return hash;
+}
+#endif
@@ -0,0 +1,172 @@
+/**
+ * @file Soak.h
+ * @author Kevin Pluas
+ * @brief CSV log of frame times, entity counts and memory over a long run
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _SOAK_H
+#define _SOAK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Structs.h"
+#include "Globals.h"
+#include "Timer.h"
+#include "Profiler.h"
+#include "Pool.h"
+#include "Particles.h"
+#include "Memory.h"
+
+#if defined(__linux__)
+    #include <unistd.h>
+#endif
+
+#define SOAK_DEFAULT_INTERVAL 3600  // Frames per row, a minute of play at 60 FPS
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+bool openSoakLog(SoakLog *log, const char *fileName, int interval);
+void addSoakFrame(SoakLog *log, double seconds);
+bool writeSoakRow(SoakLog *log, long long frame, int score, int deaths, EntityPool *bullets, EntityPool *enemies, size_t gameBytes);
+size_t getResidentBytes();
+void closeSoakLog(SoakLog *log);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+/**
+ * @brief Opens the log and writes its header. The frame time buffer is allocated here
+ * once, so logging doesn't allocate as the run goes on.
+ *
+ * @param log
+ * @param fileName
+ * @param interval Frames per row
+ * @return true if the file could be written
+ */
+bool openSoakLog(SoakLog *log, const char *fileName, int interval)
+{
+    *log = (SoakLog){ 0 };
+    log->interval = (interval > 0)? interval : SOAK_DEFAULT_INTERVAL;
+    log->frameTimes = (float *)MemAlloc(sizeof(float) * log->interval);
+    log->file = fopen(fileName, "w");
+    if (log->frameTimes == NULL || log->file == NULL)
+    {
+        TraceLog(LOG_ERROR, "SOAK: Can't write %s", fileName);
+        closeSoakLog(log);
+        return false;
+    }
+
+    fprintf(log->file, "frame,seconds,score,deaths,enemies,enemy_capacity,bullets,bullet_capacity,particles,"
+                       "frame_avg_ms,frame_p50_ms,frame_p90_ms,frame_p99_ms,frame_max_ms,game_kb,resident_kb,"
+                       "tracked_kb,tracked_blocks,allocations_per_frame\n");
+    log->start = getTimerSeconds();
+    MemoryModule total;
+    getMemoryStats(NULL, &total);
+    log->allocations = total.allocations;
+    return true;
+}
+
+// Adds the time of one frame to the row being gathered
+void addSoakFrame(SoakLog *log, double seconds)
+{
+    if (log->file != NULL && log->frameCount < log->interval)
+    {
+        log->frameTimes[log->frameCount++] = (float)(seconds * 1000.0);
+    }
+}
+
+/**
+ * @brief Writes a row once an interval of frames has been gathered, then starts the next
+ * one. Each row is flushed, so a run that is killed keeps its log.
+ *
+ * With memory tracking built in, the last columns hold the bytes and blocks live in the
+ * tracker and the allocations made per frame since the last row. A leak shows up as
+ * blocks that keep climbing, steady allocations per frame as churn worth pooling. They
+ * are left empty without it.
+ *
+ * @param log
+ * @param frame Frames since the run started
+ * @param score
+ * @param deaths
+ * @param bullets
+ * @param enemies
+ * @param gameBytes Bytes held by the game's pools, grid and other storage
+ * @return true if a row was written
+ */
+bool writeSoakRow(SoakLog *log, long long frame, int score, int deaths, EntityPool *bullets, EntityPool *enemies, size_t gameBytes)
+{
+    if (log->file == NULL || log->frameCount < log->interval)
+    {
+        return false;
+    }
+
+    float sum = 0.0f;
+    for (int i = 0; i < log->frameCount; i++)
+    {
+        sum += log->frameTimes[i];
+    }
+    qsort(log->frameTimes, log->frameCount, sizeof(float), compareFloats);
+    int count = log->frameCount;
+
+    fprintf(log->file, "%lld,%.1f,%d,%d,%d,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%zu,%zu,",
+            frame, getTimerSeconds() - log->start, score, deaths, enemies->count, enemies->capacity,
+            bullets->count, bullets->capacity, particles.count, sum / count, log->frameTimes[count / 2],
+            log->frameTimes[(count * 90 + 99) / 100 - 1], log->frameTimes[(count * 99 + 99) / 100 - 1],
+            log->frameTimes[count - 1], gameBytes / 1024, getResidentBytes() / 1024);
+#if defined(SWARM_TRACK_MEMORY)
+    MemoryModule total;
+    getMemoryStats(NULL, &total);
+    fprintf(log->file, "%zu,%d,%.2f\n", total.liveBytes / 1024, total.liveBlocks, (double)(total.allocations - log->allocations) / count);
+    log->allocations = total.allocations;
+#else
+    fprintf(log->file, ",,\n");
+#endif
+    fflush(log->file);
+    log->frameCount = 0;
+    log->rows++;
+    return true;
+}
+
+// Bytes of the process kept in memory. Counts raylib, audio and the driver too, which the
+// game's own numbers don't see. 0 where the platform doesn't report it
+size_t getResidentBytes()
+{
+#if defined(__linux__)
+    size_t pages = 0;
+    size_t resident = 0;
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file == NULL)
+    {
+        return 0;
+    }
+    if (fscanf(file, "%zu %zu", &pages, &resident) != 2)
+    {
+        resident = 0;
+    }
+    fclose(file);
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+// Closes the file and frees the frame times
+void closeSoakLog(SoakLog *log)
+{
+    if (log->file != NULL)
+    {
+        fclose(log->file);
+    }
+    MemFree(log->frameTimes);
+    *log = (SoakLog){ 0 };
+}
+
+#endif
@@ -0,0 +1,650 @@
+/**
+ * @file SpriteBatch.h
+ * @author Kevin Pluas
+ * @brief Instanced sprite rendering straight from entity columns
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _SPRITEBATCH_H
+#define _SPRITEBATCH_H
+
+#include <math.h>
+#include <string.h>
+
+#include "Structs.h"
+#include "rlgl.h"
+
+#define SPRITE_BATCH_CAPACITY 131072    // Sprites per instanced draw, MAX_PARTICLES so the particles take one. Bigger batches are split
+#define SPRITE_QUEUE_CAPACITY 32        // drawSprites() calls queued per frame
+
+/**
+ * @brief Per-sprite columns for drawSprites(). Positions are required, everything
+ * else is optional and falls back to a uniform value when NULL:
+ * no previous position means no interpolation, no rotation means upright,
+ * no scale means 1 and no tint means the tint passed to drawSprites().
+ *
+ * Rotation is a unit direction (cos, sin) rather than an angle, which is what the
+ * entity pools already store, so nobody has to call atan2f or sinf/cosf for it.
+ */
+typedef struct SpriteColumns
+{
+    const float *x;             /**< Top left corner of the sprite's body this tick */
+    const float *y;
+    const float *previousX;     /**< Top left corner of the sprite's body last tick */
+    const float *previousY;
+    const float *rotationX;     /**< Cosine of the rotation */
+    const float *rotationY;     /**< Sine of the rotation */
+    const float *scale;
+    const Color *tint;
+    int count;
+} SpriteColumns;
+
+/**
+ * @brief How every sprite in one drawSprites() call is laid out relative to its
+ * position.
+ */
+typedef struct SpriteLayout
+{
+    Rectangle source;           /**< Region of the texture to draw */
+    Vector2 size;               /**< Size on screen before scaling */
+    Vector2 offset;             /**< Added to the position to get the sprite's top left corner */
+    Vector2 origin;             /**< Rotation and scaling pivot, relative to the top left corner */
+} SpriteLayout;
+
+typedef enum SpriteAttribute
+{
+    SPRITE_CORNER = 0,
+    SPRITE_X,
+    SPRITE_Y,
+    SPRITE_PREVIOUS_X,
+    SPRITE_PREVIOUS_Y,
+    SPRITE_ROTATION_X,
+    SPRITE_ROTATION_Y,
+    SPRITE_SCALE,
+    SPRITE_TINT,
+    SPRITE_ATTRIBUTE_COUNT,
+} SpriteAttribute;
+
+typedef enum SpriteUniform
+{
+    SPRITE_MVP = 0,
+    SPRITE_ALPHA,
+    SPRITE_SIZE,
+    SPRITE_OFFSET,
+    SPRITE_ORIGIN,
+    SPRITE_SOURCE,
+    SPRITE_TEXTURE,
+    SPRITE_UNIFORM_COUNT,
+} SpriteUniform;
+
+/**
+ * @brief GPU state for instanced sprites. One vertex buffer per column, so a pool's
+ * columns are uploaded as they are without packing them into vertices first.
+ */
+typedef struct SpriteBatch
+{
+    bool instanced;                                 /**< False when the GPU path isn't available and sprites go through DrawTexturePro() */
+    unsigned int shader;
+    unsigned int vao;
+    unsigned int buffers[SPRITE_ATTRIBUTE_COUNT];
+    int attributes[SPRITE_ATTRIBUTE_COUNT];
+    int uniforms[SPRITE_UNIFORM_COUNT];
+} SpriteBatch;
+
+SpriteBatch spriteBatch = { 0 };
+
+/**
+ * @brief Draw order of queued sprites, back to front.
+ *
+ */
+typedef enum SpriteLayer
+{
+    SPRITE_LAYER_BULLETS = 0,
+    SPRITE_LAYER_ENEMIES,
+    SPRITE_LAYER_PARTICLES,
+    SPRITE_LAYER_COUNT,
+} SpriteLayer;
+
+/**
+ * @brief One queued drawSprites() call. If some of its sprites were culled, the visible
+ * ones were copied into the queue's storage, starting at offset, one column after
+ * another, and columns points at them once the queue is drawn.
+ */
+typedef struct SpriteSubmission
+{
+    SpriteLayer layer;
+    Texture2D texture;
+    SpriteLayout layout;
+    SpriteColumns columns;
+    Color tint;
+    bool compacted;             /**< True if the visible sprites live in the queue's storage. */
+    size_t offset;              /**< Where they start, in bytes. */
+} SpriteSubmission;
+
+/**
+ * @brief Counters for the sprites queued during the last frame.
+ *
+ */
+typedef struct SpriteStats
+{
+    int submitted;              /**< Sprites passed to queueSprites(). */
+    int culled;                 /**< Sprites outside the view, never sent to the GPU. */
+    int drawn;                  /**< Sprites that were drawn. */
+    int submissions;            /**< drawSprites() calls made for the queue. */
+} SpriteStats;
+
+/**
+ * @brief Sprites waiting to be culled against the view and drawn in layer order.
+ *
+ */
+typedef struct SpriteQueue
+{
+    SpriteSubmission submissions[SPRITE_QUEUE_CAPACITY];
+    int count;
+    Rectangle view;             /**< Area of the world on screen. */
+    unsigned char *storage;     /**< Visible sprites of partly culled submissions. */
+    size_t storageUsed;
+    size_t storageCapacity;
+    int *visible;               /**< Scratch list of visible sprites while culling. */
+    size_t visibleCapacity;     /**< Size of visible in bytes. */
+    SpriteStats stats;          /**< Counters since beginSpriteQueue(). */
+} SpriteQueue;
+
+SpriteQueue spriteQueue = { 0 };
+SpriteStats spriteStats = { 0 };  // Counters of the last drawn queue
+
+static const char *spriteVertexShader =
+    "#version 330\n"
+    "in vec2 corner;\n"
+    "in float x;\n"
+    "in float y;\n"
+    "in float previousX;\n"
+    "in float previousY;\n"
+    "in float rotationX;\n"
+    "in float rotationY;\n"
+    "in float scale;\n"
+    "in vec4 tint;\n"
+    "uniform mat4 mvp;\n"
+    "uniform float alpha;\n"
+    "uniform vec2 spriteSize;\n"
+    "uniform vec2 spriteOffset;\n"
+    "uniform vec2 spriteOrigin;\n"
+    "uniform vec4 source;\n"
+    "out vec2 fragTexCoord;\n"
+    "out vec4 fragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 position = mix(vec2(previousX, previousY), vec2(x, y), alpha) + spriteOffset + spriteOrigin;\n"
+    "    vec2 local = (corner*spriteSize - spriteOrigin)*scale;\n"
+    "    vec2 rotated = vec2(local.x*rotationX - local.y*rotationY, local.x*rotationY + local.y*rotationX);\n"
+    "    fragTexCoord = source.xy + corner*source.zw;\n"
+    "    fragColor = tint;\n"
+    "    gl_Position = mvp*vec4(position + rotated, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *spriteFragmentShader =
+    "#version 330\n"
+    "in vec2 fragTexCoord;\n"
+    "in vec4 fragColor;\n"
+    "uniform sampler2D texture0;\n"
+    "out vec4 finalColor;\n"
+    "void main()\n"
+    "{\n"
+    "    finalColor = texture(texture0, fragTexCoord)*fragColor;\n"
+    "}\n";
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+void initSpriteBatch();
+void drawSprites(Texture2D texture, SpriteLayout layout, SpriteColumns columns, float alpha, Color tint);
+void unloadSpriteBatch();
+
+void beginSpriteQueue(Rectangle view);
+void queueSprites(SpriteLayer layer, Texture2D texture, SpriteLayout layout, SpriteColumns columns, Color tint);
+void drawSpriteQueue(float alpha);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+/**
+ * @brief Compiles the sprite shader and creates the instance buffers. Needs a window.
+ * On anything older than OpenGL 3.3 the batch stays in fallback mode.
+ *
+ */
+void initSpriteBatch()
+{
+    spriteBatch = (SpriteBatch){ 0 };
+
+    int version = rlGetVersion();
+    if (version != RL_OPENGL_33 && version != RL_OPENGL_43)
+    {
+        TraceLog(LOG_WARNING, "Instanced sprites need OpenGL 3.3, drawing sprites one by one");
+        return;
+    }
+
+    spriteBatch.shader = rlLoadShaderCode(spriteVertexShader, spriteFragmentShader);
+    if (spriteBatch.shader == 0 || spriteBatch.shader == rlGetShaderIdDefault())
+    {
+        TraceLog(LOG_ERROR, "Error loading sprite shader, drawing sprites one by one");
+        spriteBatch.shader = 0;
+        return;
+    }
+
+    static const char *attributeNames[SPRITE_ATTRIBUTE_COUNT] = {
+        "corner", "x", "y", "previousX", "previousY", "rotationX", "rotationY", "scale", "tint"
+    };
+    static const char *uniformNames[SPRITE_UNIFORM_COUNT] = {
+        "mvp", "alpha", "spriteSize", "spriteOffset", "spriteOrigin", "source", "texture0"
+    };
+    for (int i = 0; i < SPRITE_ATTRIBUTE_COUNT; i++)
+    {
+        spriteBatch.attributes[i] = rlGetLocationAttrib(spriteBatch.shader, attributeNames[i]);
+    }
+    for (int i = 0; i < SPRITE_UNIFORM_COUNT; i++)
+    {
+        spriteBatch.uniforms[i] = rlGetLocationUniform(spriteBatch.shader, uniformNames[i]);
+    }
+
+    // Two triangles covering the unit square, shared by every instance
+    static const float corners[12] = { 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0 };
+
+    spriteBatch.vao = rlLoadVertexArray();
+    rlEnableVertexArray(spriteBatch.vao);
+    for (int i = 0; i < SPRITE_ATTRIBUTE_COUNT; i++)
+    {
+        int location = spriteBatch.attributes[i];
+        if (i == SPRITE_CORNER)
+        {
+            spriteBatch.buffers[i] = rlLoadVertexBuffer(corners, sizeof(corners), false);
+        }
+        else if (i == SPRITE_TINT)
+        {
+            spriteBatch.buffers[i] = rlLoadVertexBuffer(NULL, SPRITE_BATCH_CAPACITY * sizeof(Color), true);
+        }
+        else
+        {
+            spriteBatch.buffers[i] = rlLoadVertexBuffer(NULL, SPRITE_BATCH_CAPACITY * sizeof(float), true);
+        }
+        if (location < 0)
+        { // Compiled out by the driver, nothing to bind
+            continue;
+        }
+
+        if (i == SPRITE_CORNER)
+        {
+            rlSetVertexAttribute(location, 2, RL_FLOAT, false, 0, 0);
+        }
+        else if (i == SPRITE_TINT)
+        {
+            rlSetVertexAttribute(location, 4, RL_UNSIGNED_BYTE, true, 0, 0);
+            rlSetVertexAttributeDivisor(location, 1);
+        }
+        else
+        {
+            rlSetVertexAttribute(location, 1, RL_FLOAT, false, 0, 0);
+            rlSetVertexAttributeDivisor(location, 1);
+        }
+        rlEnableVertexAttribute(location);
+    }
+    rlDisableVertexArray();
+    rlDisableVertexBuffer();
+
+    spriteBatch.instanced = true;
+    TraceLog(LOG_INFO, "Instanced sprites enabled");
+}
+
+// Uploads count values of a column, or switches its attribute to a constant value
+// when the column is NULL
+static void setSpriteColumn(SpriteAttribute attribute, const void *column, int elementSize, int count, const float *fallback, int fallbackType)
+{
+    int location = spriteBatch.attributes[attribute];
+    if (location < 0)
+    {
+        return;
+    }
+
+    if (column == NULL)
+    {
+        rlDisableVertexAttribute(location);
+        rlSetVertexAttributeDefault(location, fallback, fallbackType, (fallbackType == SHADER_ATTRIB_VEC4)? 4 : 1);
+    }
+    else
+    {
+        rlUpdateVertexBuffer(spriteBatch.buffers[attribute], column, count * elementSize, 0);
+        rlEnableVertexAttribute(location);
+    }
+}
+
+// Advances a column pointer by offset elements, leaving missing columns missing
+static inline const float *offsetColumn(const float *column, int offset)
+{
+    return (column == NULL)? NULL : column + offset;
+}
+
+/**
+ * @brief Draws columns.count copies of one texture region. On the GPU path that is one
+ * instanced draw per SPRITE_BATCH_CAPACITY sprites, with interpolation, rotation and
+ * scaling all done in the vertex shader.
+ *
+ * Anything already queued on raylib's batch is flushed first so draw order is kept.
+ *
+ * @param texture
+ * @param layout
+ * @param columns
+ * @param alpha How far the current frame is between the last tick and the next one
+ * @param tint Used for every sprite when columns.tint is NULL
+ */
+void drawSprites(Texture2D texture, SpriteLayout layout, SpriteColumns columns, float alpha, Color tint)
+{
+    if (columns.count <= 0)
+    {
+        return;
+    }
+
+    if (!spriteBatch.instanced)
+    { // Fallback: one quad at a time through raylib's batch
+        for (int i = 0; i < columns.count; i++)
+        {
+            Vector2 position = { columns.x[i], columns.y[i] };
+            if (columns.previousX != NULL)
+            {
+                position.x = Lerp(columns.previousX[i], position.x, alpha);
+                position.y = Lerp(columns.previousY[i], position.y, alpha);
+            }
+            float scale = (columns.scale != NULL)? columns.scale[i] : 1.0f;
+            float rotation = (columns.rotationX != NULL)? atan2f(columns.rotationY[i], columns.rotationX[i]) * RAD2DEG : 0.0f;
+            Vector2 origin = Vector2Scale(layout.origin, scale);
+
+            DrawTexturePro(texture,
+                           layout.source,
+                           (Rectangle){ position.x + layout.offset.x + layout.origin.x, position.y + layout.offset.y + layout.origin.y,
+                                        layout.size.x * scale, layout.size.y * scale },
+                           origin,
+                           rotation,
+                           (columns.tint != NULL)? columns.tint[i] : tint);
+        }
+        return;
+    }
+
+    rlDrawRenderBatchActive();
+
+    Matrix mvp = MatrixMultiply(MatrixMultiply(rlGetMatrixTransform(), rlGetMatrixModelview()), rlGetMatrixProjection());
+    float interpolation = (columns.previousX != NULL)? alpha : 1.0f;
+    float source[4] = {
+        layout.source.x / texture.width, layout.source.y / texture.height,
+        layout.source.width / texture.width, layout.source.height / texture.height
+    };
+    float tintValue[4] = { tint.r / 255.0f, tint.g / 255.0f, tint.b / 255.0f, tint.a / 255.0f };
+    float zero = 0.0f;
+    float one = 1.0f;
+
+    rlEnableShader(spriteBatch.shader);
+    rlSetUniformMatrix(spriteBatch.uniforms[SPRITE_MVP], mvp);
+    rlSetUniform(spriteBatch.uniforms[SPRITE_ALPHA], &interpolation, SHADER_UNIFORM_FLOAT, 1);
+    rlSetUniform(spriteBatch.uniforms[SPRITE_SIZE], &layout.size, SHADER_UNIFORM_VEC2, 1);
+    rlSetUniform(spriteBatch.uniforms[SPRITE_OFFSET], &layout.offset, SHADER_UNIFORM_VEC2, 1);
+    rlSetUniform(spriteBatch.uniforms[SPRITE_ORIGIN], &layout.origin, SHADER_UNIFORM_VEC2, 1);
+    rlSetUniform(spriteBatch.uniforms[SPRITE_SOURCE], source, SHADER_UNIFORM_VEC4, 1);
+    int slot = 0;
+    rlSetUniform(spriteBatch.uniforms[SPRITE_TEXTURE], &slot, SHADER_UNIFORM_SAMPLER2D, 1);
+
+    rlEnableVertexArray(spriteBatch.vao);
+    rlActiveTextureSlot(0);
+    rlEnableTexture(texture.id);
+
+    for (int start = 0; start < columns.count; start += SPRITE_BATCH_CAPACITY)
+    {
+        int count = columns.count - start;
+        if (count > SPRITE_BATCH_CAPACITY)
+        {
+            count = SPRITE_BATCH_CAPACITY;
+        }
+
+        // Without a previous position the current one is drawn as is (alpha is 1)
+        setSpriteColumn(SPRITE_X, columns.x + start, sizeof(float), count, NULL, 0);
+        setSpriteColumn(SPRITE_Y, columns.y + start, sizeof(float), count, NULL, 0);
+        setSpriteColumn(SPRITE_PREVIOUS_X, offsetColumn(columns.previousX, start), sizeof(float), count, &zero, SHADER_ATTRIB_FLOAT);
+        setSpriteColumn(SPRITE_PREVIOUS_Y, offsetColumn(columns.previousY, start), sizeof(float), count, &zero, SHADER_ATTRIB_FLOAT);
+        setSpriteColumn(SPRITE_ROTATION_X, offsetColumn(columns.rotationX, start), sizeof(float), count, &one, SHADER_ATTRIB_FLOAT);
+        setSpriteColumn(SPRITE_ROTATION_Y, offsetColumn(columns.rotationY, start), sizeof(float), count, &zero, SHADER_ATTRIB_FLOAT);
+        setSpriteColumn(SPRITE_SCALE, offsetColumn(columns.scale, start), sizeof(float), count, &one, SHADER_ATTRIB_FLOAT);
+        setSpriteColumn(SPRITE_TINT, (columns.tint == NULL)? NULL : columns.tint + start, sizeof(Color), count, tintValue, SHADER_ATTRIB_VEC4);
+
+        rlDrawVertexArrayInstanced(0, 6, count);
+    }
+
+    rlDisableTexture();
+    rlDisableVertexArray();
+    rlDisableShader();
+}
+
+/**
+ * @brief Starts queueing the sprites of a frame. Queued sprites are culled against view
+ * and drawn by drawSpriteQueue().
+ *
+ * @param view Area of the world on screen
+ */
+void beginSpriteQueue(Rectangle view)
+{
+    spriteQueue.count = 0;
+    spriteQueue.storageUsed = 0;
+    spriteQueue.view = view;
+    spriteQueue.stats = (SpriteStats){ 0 };
+}
+
+// Grows a scratch buffer to hold at least size bytes. Returns false if it couldn't
+static bool reserveSpriteScratch(void **buffer, size_t *capacity, size_t size)
+{
+    if (size <= *capacity)
+    {
+        return true;
+    }
+
+    size_t grown = (*capacity > 0)? *capacity : 4096;
+    while (grown < size)
+    {
+        grown *= 2;
+    }
+    void *resized = MemRealloc(*buffer, grown);
+    if (resized == NULL)
+    {
+        TraceLog(LOG_WARNING, "Error growing the sprite queue to %zu bytes, drawing without culling", grown);
+        return false;
+    }
+    *buffer = resized;
+    *capacity = grown;
+    return true;
+}
+
+// The columns of a submission, in the order they are packed into the queue's storage
+static inline int getSpriteColumnPointers(SpriteColumns *columns, const void ***pointers)
+{
+    pointers[0] = (const void **)&columns->x;
+    pointers[1] = (const void **)&columns->y;
+    pointers[2] = (const void **)&columns->previousX;
+    pointers[3] = (const void **)&columns->previousY;
+    pointers[4] = (const void **)&columns->rotationX;
+    pointers[5] = (const void **)&columns->rotationY;
+    pointers[6] = (const void **)&columns->scale;
+    pointers[7] = (const void **)&columns->tint;
+    return 8;
+}
+
+/**
+ * @brief Queues a drawSprites() call, dropping the sprites that can't reach the view.
+ * The bounds are conservative: a sprite is kept if it could be on screen anywhere
+ * between its previous and current position, at any rotation. When every sprite is
+ * visible the columns are drawn where they are, so they have to stay unchanged until
+ * drawSpriteQueue().
+ *
+ * @param layer Where the sprites go in the draw order
+ * @param texture
+ * @param layout
+ * @param columns
+ * @param tint
+ */
+void queueSprites(SpriteLayer layer, Texture2D texture, SpriteLayout layout, SpriteColumns columns, Color tint)
+{
+    if (columns.count <= 0)
+    {
+        return;
+    }
+    if (spriteQueue.count == SPRITE_QUEUE_CAPACITY)
+    {
+        TraceLog(LOG_WARNING, "Sprite queue is full, drawing out of order");
+        drawSprites(texture, layout, columns, 1.0f, tint);
+        return;
+    }
+
+    // Bounds of a sprite relative to its position, before scaling. Rotated sprites can
+    // reach as far as the corner furthest from their pivot
+    Vector2 pivot = Vector2Add(layout.offset, layout.origin);
+    Vector2 low = Vector2Negate(layout.origin);
+    Vector2 high = Vector2Subtract(layout.size, layout.origin);
+    if (columns.rotationX != NULL)
+    {
+        float reach = sqrtf(fmaxf(low.x * low.x, high.x * high.x) + fmaxf(low.y * low.y, high.y * high.y));
+        low = (Vector2){ -reach, -reach };
+        high = (Vector2){ reach, reach };
+    }
+
+    SpriteSubmission *submission = &spriteQueue.submissions[spriteQueue.count++];
+    *submission = (SpriteSubmission){ layer, texture, layout, columns, tint, false, 0 };
+    spriteQueue.stats.submitted += columns.count;
+
+    if (!reserveSpriteScratch((void **)&spriteQueue.visible, &spriteQueue.visibleCapacity, columns.count * sizeof(int)))
+    {
+        return;
+    }
+
+    Rectangle view = spriteQueue.view;
+    int visibleCount = 0;
+    for (int i = 0; i < columns.count; i++)
+    {
+        float scale = (columns.scale != NULL)? columns.scale[i] : 1.0f;
+        float fromX = (columns.previousX != NULL)? columns.previousX[i] : columns.x[i];
+        float fromY = (columns.previousY != NULL)? columns.previousY[i] : columns.y[i];
+        float minX = fminf(fromX, columns.x[i]) + pivot.x + low.x * scale;
+        float minY = fminf(fromY, columns.y[i]) + pivot.y + low.y * scale;
+        float maxX = fmaxf(fromX, columns.x[i]) + pivot.x + high.x * scale;
+        float maxY = fmaxf(fromY, columns.y[i]) + pivot.y + high.y * scale;
+        if (maxX >= view.x && minX <= view.x + view.width && maxY >= view.y && minY <= view.y + view.height)
+        {
+            spriteQueue.visible[visibleCount++] = i;
+        }
+    }
+
+    spriteQueue.stats.culled += columns.count - visibleCount;
+    if (visibleCount == columns.count)
+    {
+        return;
+    }
+
+    // Pack the visible sprites' columns into the queue's storage. Pointers to it are only
+    // taken when drawing, since it may move while the frame is queued
+    const void **pointers[8];
+    int columnCount = getSpriteColumnPointers(&submission->columns, pointers);
+    size_t needed = spriteQueue.storageUsed + (size_t)columnCount * visibleCount * sizeof(float);
+    if (!reserveSpriteScratch((void **)&spriteQueue.storage, &spriteQueue.storageCapacity, needed))
+    {
+        spriteQueue.stats.culled -= columns.count - visibleCount;
+        return;
+    }
+
+    submission->compacted = true;
+    submission->offset = spriteQueue.storageUsed;
+    submission->columns.count = visibleCount;
+    for (int c = 0; c < columnCount; c++)
+    {
+        const uint32_t *source = *pointers[c];
+        if (source == NULL)
+        {
+            continue;
+        }
+        // Every column holds 4 byte elements, floats or Colors
+        uint32_t *packed = (uint32_t *)(spriteQueue.storage + spriteQueue.storageUsed);
+        for (int k = 0; k < visibleCount; k++)
+        {
+            packed[k] = source[spriteQueue.visible[k]];
+        }
+        spriteQueue.storageUsed += visibleCount * sizeof(uint32_t);
+    }
+}
+
+/**
+ * @brief Draws everything queued since beginSpriteQueue(), back to front by layer and,
+ * within a layer, grouped by texture. Submissions that tie keep the order they were
+ * queued in. The counters end up in spriteStats.
+ *
+ * @param alpha How far the current frame is between the last tick and the next one
+ */
+void drawSpriteQueue(float alpha)
+{
+    // Insertion sort, the queue is a handful of submissions and has to stay stable
+    SpriteSubmission *submissions = spriteQueue.submissions;
+    for (int i = 1; i < spriteQueue.count; i++)
+    {
+        SpriteSubmission moving = submissions[i];
+        int j = i - 1;
+        while (j >= 0 && (submissions[j].layer > moving.layer ||
+               (submissions[j].layer == moving.layer && submissions[j].texture.id > moving.texture.id)))
+        {
+            submissions[j + 1] = submissions[j];
+            j--;
+        }
+        submissions[j + 1] = moving;
+    }
+
+    for (int i = 0; i < spriteQueue.count; i++)
+    {
+        SpriteSubmission *submission = &submissions[i];
+        if (submission->compacted)
+        {
+            const void **pointers[8];
+            int columnCount = getSpriteColumnPointers(&submission->columns, pointers);
+            size_t offset = submission->offset;
+            for (int c = 0; c < columnCount; c++)
+            {
+                if (*pointers[c] != NULL)
+                {
+                    *pointers[c] = spriteQueue.storage + offset;
+                    offset += submission->columns.count * sizeof(uint32_t);
+                }
+            }
+        }
+
+        drawSprites(submission->texture, submission->layout, submission->columns, alpha, submission->tint);
+        spriteQueue.stats.drawn += submission->columns.count;
+        spriteQueue.stats.submissions += (submission->columns.count > 0);
+    }
+
+    spriteStats = spriteQueue.stats;
+    spriteQueue.count = 0;
+}
+
+// Frees the shader and buffers, and the queue's storage
+void unloadSpriteBatch()
+{
+    MemFree(spriteQueue.storage);
+    MemFree(spriteQueue.visible);
+    spriteQueue = (SpriteQueue){ 0 };
+    if (!spriteBatch.instanced)
+    {
+        return;
+    }
+
+    for (int i = 0; i < SPRITE_ATTRIBUTE_COUNT; i++)
+    {
+        rlUnloadVertexBuffer(spriteBatch.buffers[i]);
+    }
+    rlUnloadVertexArray(spriteBatch.vao);
+    rlUnloadShaderProgram(spriteBatch.shader);
+    spriteBatch = (SpriteBatch){ 0 };
+}
+#endif
@@ -0,0 +1,303 @@
+/**
+ * @file Steering.h
+ * @author Kevin Pluas
+ * @brief SIMD movement kernels for enemies and bullets
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _STEERING_H
+#define _STEERING_H
+
+#include <math.h>
+
+#include "Structs.h"
+
+// Pick the widest instruction set the compiler was allowed to use. Define SWARM_NO_SIMD
+// to force the scalar kernels.
+#if !defined(SWARM_NO_SIMD)
+    #if defined(__AVX__)
+        #define STEERING_AVX
+        #include <immintrin.h>
+    #elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+        #define STEERING_SSE
+        #include <emmintrin.h>
+    #endif
+#endif
+
+#if defined(STEERING_AVX)
+    const char *steeringBackend = "AVX";
+#elif defined(STEERING_SSE)
+    const char *steeringBackend = "SSE2";
+#else
+    const char *steeringBackend = "scalar";
+#endif
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+void chaseTarget(EntityPool *pool, int start, int end, Vector2 target);
+void chaseNearest(EntityPool *pool, int start, int end, Vector2 first, Vector2 second);
+void advanceEntities(EntityPool *pool, int start, int end);
+
+void chaseTargetScalar(EntityPool *pool, int start, int end, Vector2 target);
+void chaseNearestScalar(EntityPool *pool, int start, int end, Vector2 first, Vector2 second);
+void advanceEntitiesScalar(EntityPool *pool, int start, int end);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+/**
+ * @brief Points entities [start, end) at target and moves them one tick along that
+ * direction. The SIMD paths use the same operations in the same order as the scalar
+ * one, so every backend produces bit for bit the same positions.
+ *
+ * @param pool
+ * @param start
+ * @param end
+ * @param target
+ */
+void chaseTarget(EntityPool *pool, int start, int end, Vector2 target)
+{
+    int i = start;
+
+#if defined(STEERING_AVX)
+    __m256 targetX = _mm256_set1_ps(target.x);
+    __m256 targetY = _mm256_set1_ps(target.y);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 one = _mm256_set1_ps(1.0f);
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(pool->x + i);
+        __m256 y = _mm256_loadu_ps(pool->y + i);
+        __m256 dx = _mm256_sub_ps(targetX, x);
+        __m256 dy = _mm256_sub_ps(targetY, y);
+        __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        __m256 inverse = _mm256_div_ps(one, length);
+        __m256 valid = _mm256_cmp_ps(length, zero, _CMP_GT_OQ);     // Zero length stays a zero direction
+        __m256 directionX = _mm256_and_ps(valid, _mm256_mul_ps(dx, inverse));
+        __m256 directionY = _mm256_and_ps(valid, _mm256_mul_ps(dy, inverse));
+        __m256 speed = _mm256_loadu_ps(pool->speed + i);
+
+        _mm256_storeu_ps(pool->previousX + i, x);
+        _mm256_storeu_ps(pool->previousY + i, y);
+        _mm256_storeu_ps(pool->directionX + i, directionX);
+        _mm256_storeu_ps(pool->directionY + i, directionY);
+        _mm256_storeu_ps(pool->x + i, _mm256_add_ps(x, _mm256_mul_ps(directionX, speed)));
+        _mm256_storeu_ps(pool->y + i, _mm256_add_ps(y, _mm256_mul_ps(directionY, speed)));
+    }
+#elif defined(STEERING_SSE)
+    __m128 targetX = _mm_set1_ps(target.x);
+    __m128 targetY = _mm_set1_ps(target.y);
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(pool->x + i);
+        __m128 y = _mm_loadu_ps(pool->y + i);
+        __m128 dx = _mm_sub_ps(targetX, x);
+        __m128 dy = _mm_sub_ps(targetY, y);
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        __m128 inverse = _mm_div_ps(one, length);
+        __m128 valid = _mm_cmpgt_ps(length, zero);                  // Zero length stays a zero direction
+        __m128 directionX = _mm_and_ps(valid, _mm_mul_ps(dx, inverse));
+        __m128 directionY = _mm_and_ps(valid, _mm_mul_ps(dy, inverse));
+        __m128 speed = _mm_loadu_ps(pool->speed + i);
+
+        _mm_storeu_ps(pool->previousX + i, x);
+        _mm_storeu_ps(pool->previousY + i, y);
+        _mm_storeu_ps(pool->directionX + i, directionX);
+        _mm_storeu_ps(pool->directionY + i, directionY);
+        _mm_storeu_ps(pool->x + i, _mm_add_ps(x, _mm_mul_ps(directionX, speed)));
+        _mm_storeu_ps(pool->y + i, _mm_add_ps(y, _mm_mul_ps(directionY, speed)));
+    }
+#endif
+
+    // Whatever doesn't fill a whole register
+    chaseTargetScalar(pool, i, end, target);
+}
+
+/**
+ * @brief chaseTarget() with two targets, used when two players share the world. Each
+ * entity chases whichever target is nearer, the first one on a tie. Like chaseTarget(),
+ * every backend produces bit for bit the same positions.
+ *
+ * @param pool
+ * @param start
+ * @param end
+ * @param first
+ * @param second
+ */
+void chaseNearest(EntityPool *pool, int start, int end, Vector2 first, Vector2 second)
+{
+    int i = start;
+
+#if defined(STEERING_AVX)
+    __m256 firstX = _mm256_set1_ps(first.x);
+    __m256 firstY = _mm256_set1_ps(first.y);
+    __m256 secondX = _mm256_set1_ps(second.x);
+    __m256 secondY = _mm256_set1_ps(second.y);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 one = _mm256_set1_ps(1.0f);
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(pool->x + i);
+        __m256 y = _mm256_loadu_ps(pool->y + i);
+        __m256 firstDX = _mm256_sub_ps(firstX, x);
+        __m256 firstDY = _mm256_sub_ps(firstY, y);
+        __m256 secondDX = _mm256_sub_ps(secondX, x);
+        __m256 secondDY = _mm256_sub_ps(secondY, y);
+        __m256 nearer = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(secondDX, secondDX), _mm256_mul_ps(secondDY, secondDY)),
+                                      _mm256_add_ps(_mm256_mul_ps(firstDX, firstDX), _mm256_mul_ps(firstDY, firstDY)), _CMP_LT_OQ);
+        __m256 dx = _mm256_blendv_ps(firstDX, secondDX, nearer);
+        __m256 dy = _mm256_blendv_ps(firstDY, secondDY, nearer);
+        __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        __m256 inverse = _mm256_div_ps(one, length);
+        __m256 valid = _mm256_cmp_ps(length, zero, _CMP_GT_OQ);
+        __m256 directionX = _mm256_and_ps(valid, _mm256_mul_ps(dx, inverse));
+        __m256 directionY = _mm256_and_ps(valid, _mm256_mul_ps(dy, inverse));
+        __m256 speed = _mm256_loadu_ps(pool->speed + i);
+
+        _mm256_storeu_ps(pool->previousX + i, x);
+        _mm256_storeu_ps(pool->previousY + i, y);
+        _mm256_storeu_ps(pool->directionX + i, directionX);
+        _mm256_storeu_ps(pool->directionY + i, directionY);
+        _mm256_storeu_ps(pool->x + i, _mm256_add_ps(x, _mm256_mul_ps(directionX, speed)));
+        _mm256_storeu_ps(pool->y + i, _mm256_add_ps(y, _mm256_mul_ps(directionY, speed)));
+    }
+#elif defined(STEERING_SSE)
+    __m128 firstX = _mm_set1_ps(first.x);
+    __m128 firstY = _mm_set1_ps(first.y);
+    __m128 secondX = _mm_set1_ps(second.x);
+    __m128 secondY = _mm_set1_ps(second.y);
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(pool->x + i);
+        __m128 y = _mm_loadu_ps(pool->y + i);
+        __m128 firstDX = _mm_sub_ps(firstX, x);
+        __m128 firstDY = _mm_sub_ps(firstY, y);
+        __m128 secondDX = _mm_sub_ps(secondX, x);
+        __m128 secondDY = _mm_sub_ps(secondY, y);
+        __m128 nearer = _mm_cmplt_ps(_mm_add_ps(_mm_mul_ps(secondDX, secondDX), _mm_mul_ps(secondDY, secondDY)),
+                                     _mm_add_ps(_mm_mul_ps(firstDX, firstDX), _mm_mul_ps(firstDY, firstDY)));
+        __m128 dx = _mm_or_ps(_mm_and_ps(nearer, secondDX), _mm_andnot_ps(nearer, firstDX));     // SSE2 has no blend
+        __m128 dy = _mm_or_ps(_mm_and_ps(nearer, secondDY), _mm_andnot_ps(nearer, firstDY));
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        __m128 inverse = _mm_div_ps(one, length);
+        __m128 valid = _mm_cmpgt_ps(length, zero);
+        __m128 directionX = _mm_and_ps(valid, _mm_mul_ps(dx, inverse));
+        __m128 directionY = _mm_and_ps(valid, _mm_mul_ps(dy, inverse));
+        __m128 speed = _mm_loadu_ps(pool->speed + i);
+
+        _mm_storeu_ps(pool->previousX + i, x);
+        _mm_storeu_ps(pool->previousY + i, y);
+        _mm_storeu_ps(pool->directionX + i, directionX);
+        _mm_storeu_ps(pool->directionY + i, directionY);
+        _mm_storeu_ps(pool->x + i, _mm_add_ps(x, _mm_mul_ps(directionX, speed)));
+        _mm_storeu_ps(pool->y + i, _mm_add_ps(y, _mm_mul_ps(directionY, speed)));
+    }
+#endif
+
+    chaseNearestScalar(pool, i, end, first, second);
+}
+
+/**
+ * @brief Moves entities [start, end) one tick along their direction.
+ *
+ * @param pool
+ * @param start
+ * @param end
+ */
+void advanceEntities(EntityPool *pool, int start, int end)
+{
+    int i = start;
+
+#if defined(STEERING_AVX)
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(pool->x + i);
+        __m256 y = _mm256_loadu_ps(pool->y + i);
+        __m256 speed = _mm256_loadu_ps(pool->speed + i);
+
+        _mm256_storeu_ps(pool->previousX + i, x);
+        _mm256_storeu_ps(pool->previousY + i, y);
+        _mm256_storeu_ps(pool->x + i, _mm256_add_ps(x, _mm256_mul_ps(_mm256_loadu_ps(pool->directionX + i), speed)));
+        _mm256_storeu_ps(pool->y + i, _mm256_add_ps(y, _mm256_mul_ps(_mm256_loadu_ps(pool->directionY + i), speed)));
+    }
+#elif defined(STEERING_SSE)
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(pool->x + i);
+        __m128 y = _mm_loadu_ps(pool->y + i);
+        __m128 speed = _mm_loadu_ps(pool->speed + i);
+
+        _mm_storeu_ps(pool->previousX + i, x);
+        _mm_storeu_ps(pool->previousY + i, y);
+        _mm_storeu_ps(pool->x + i, _mm_add_ps(x, _mm_mul_ps(_mm_loadu_ps(pool->directionX + i), speed)));
+        _mm_storeu_ps(pool->y + i, _mm_add_ps(y, _mm_mul_ps(_mm_loadu_ps(pool->directionY + i), speed)));
+    }
+#endif
+
+    advanceEntitiesScalar(pool, i, end);
+}
+
+// Scalar version of chaseTarget(), matching Vector2Normalize()
+void chaseTargetScalar(EntityPool *pool, int start, int end, Vector2 target)
+{
+    for (int i = start; i < end; i++)
+    {
+        float dx = target.x - pool->x[i];
+        float dy = target.y - pool->y[i];
+        float length = sqrtf((dx*dx) + (dy*dy));
+        float directionX = 0.0f;
+        float directionY = 0.0f;
+
+        if (length > 0)
+        {
+            float inverse = 1.0f/length;
+            directionX = dx*inverse;
+            directionY = dy*inverse;
+        }
+
+        pool->previousX[i] = pool->x[i];
+        pool->previousY[i] = pool->y[i];
+        pool->directionX[i] = directionX;
+        pool->directionY[i] = directionY;
+        pool->x[i] += directionX*pool->speed[i];
+        pool->y[i] += directionY*pool->speed[i];
+    }
+}
+
+// Scalar version of chaseNearest()
+void chaseNearestScalar(EntityPool *pool, int start, int end, Vector2 first, Vector2 second)
+{
+    for (int i = start; i < end; i++)
+    {
+        float firstDX = first.x - pool->x[i];
+        float firstDY = first.y - pool->y[i];
+        float secondDX = second.x - pool->x[i];
+        float secondDY = second.y - pool->y[i];
+        bool nearer = (secondDX*secondDX) + (secondDY*secondDY) < (firstDX*firstDX) + (firstDY*firstDY);
+
+        chaseTargetScalar(pool, i, i + 1, nearer? second : first);
+    }
+}
+
+// Scalar version of advanceEntities()
+void advanceEntitiesScalar(EntityPool *pool, int start, int end)
+{
+    for (int i = start; i < end; i++)
+    {
+        pool->previousX[i] = pool->x[i];
+        pool->previousY[i] = pool->y[i];
+        pool->x[i] += pool->directionX[i]*pool->speed[i];
+        pool->y[i] += pool->directionY[i]*pool->speed[i];
+    }
+}
+#endif
@@ -12,6 +12,8 @@
 #ifndef _STRUCTS_H
 #define _STRUCTS_H
 
+#include <stdint.h>
+#include <stdio.h>
 
 #ifdef __unix__
     #include "raylib.h"
@@ -23,6 +25,14 @@
     #include "..\..\raylib\src\raymath.h"
 #endif
 
+// With memory tracking built in, the game's allocations are tagged with the file they are
+// made in like raylib's. See MemoryHooks.h
+#if defined(SWARM_TRACK_MEMORY)
+    #define MemAlloc(size) trackCalloc((size), 1, __FILE__)
+    #define MemRealloc(block, size) trackRealloc((block), (size), __FILE__)
+    #define MemFree(block) trackFree(block)
+#endif
+
 typedef enum GameScreen
 {
     LOGO = 0,
@@ -46,11 +56,10 @@ typedef enum Effect
     HEALTHUP,
 } Effect;
 
-typedef void (*UpdateFunction)(Entity* entity);
 /**
- * @brief Represents an entity in the game.
- * 
- * An entity is a game object that has health, speed, a body, direction, and a sprite.
+ * @brief A lone game object, used for the player. The swarm lives in EntityPools
+ * instead.
+ *
  */
 typedef struct Entity
 {
@@ -58,18 +67,375 @@ typedef struct Entity
     float speed;            /**< The speed of the entity. */
     struct Rectangle body;  /**< The body of the entity. */
     Vector2 direction;      /**< The direction of the entity. */
-    Texture2D sprite;       /**< The sprite of the entity. */
-    UpdateFunction update;  /**< The update function of the entity. */
-    
+    Vector2 previous;       /**< Position at the start of the last tick, used to interpolate rendering. */
+    Rectangle sprite;       /**< The entity's region of the sprite atlas. */
+    int weapon;             /**< Bullet pattern the player fires, an index into the loaded PatternTable. */
 } Entity;
-typedef struct Entity
+
+/**
+ * @brief The components a pooled entity can have. Each one is one or two columns of
+ * an EntityPool, and a pool only allocates the columns of the components its
+ * archetype is made of.
+ *
+ */
+typedef enum Component
 {
-    int health;
-    float speed;
-    struct Rectangle body;
-    Vector2 direction;
-    Texture2D sprite;
-} Entity;
+    COMPONENT_POSITION = 1 << 0,    // x, y
+    COMPONENT_PREVIOUS = 1 << 1,    // previousX, previousY
+    COMPONENT_DIRECTION = 1 << 2,   // directionX, directionY
+    COMPONENT_SPEED = 1 << 3,       // speed
+    COMPONENT_SIZE = 1 << 4,        // width, height
+    COMPONENT_HEALTH = 1 << 5,      // health
+    COMPONENT_HOMING = 1 << 6,      // turn, targetSlot, targetGeneration
+} Component;
+
+// Archetypes, the sets of components each kind of pooled entity is made of
+#define ARCHETYPE_MOVER (COMPONENT_POSITION | COMPONENT_PREVIOUS | COMPONENT_DIRECTION | COMPONENT_SPEED | COMPONENT_SIZE)
+#define ARCHETYPE_BULLET (ARCHETYPE_MOVER | COMPONENT_HOMING)
+#define ARCHETYPE_ENEMY (ARCHETYPE_MOVER | COMPONENT_HEALTH)
+
+/**
+ * @brief A reference to a pooled entity that survives the entity being moved inside
+ * the pool or the pool growing. A handle whose entity has been despawned is stale,
+ * and the zero handle never refers to anything.
+ *
+ */
+typedef struct EntityHandle
+{
+    unsigned int slot;          /**< Stable slot of the entity, not its index. */
+    unsigned int generation;    /**< Generation of the slot when the handle was taken. */
+} EntityHandle;
+
+/**
+ * @brief Storage for the entities of one archetype, such as bullets or enemies.
+ *
+ * Entities are stored as a structure of arrays: each field lives in its own column,
+ * so the update kernels stream through only the fields they touch and can process
+ * several entities per SIMD instruction. Only the columns of the archetype's
+ * components are allocated, the others are NULL. Live entities are kept packed in
+ * [0, count). The storage doubles when a spawn finds it full, which moves every
+ * column, so keep handles rather than indices or pointers across spawns.
+ *
+ * Each index also owns a slot. Slots stay with their entity when it is moved, and a
+ * slot's generation is bumped when its entity is despawned, which is what lets a
+ * handle tell a live entity from a dead one.
+ */
+typedef struct EntityPool
+{
+    float *x;           /**< Left edge of the body. */
+    float *y;           /**< Top edge of the body. */
+    float *previousX;   /**< x at the start of the last tick, used to interpolate rendering. */
+    float *previousY;   /**< y at the start of the last tick. */
+    float *directionX;  /**< Normalized heading. */
+    float *directionY;
+    float *speed;       /**< Distance covered per tick. */
+    float *width;       /**< Size of the body. */
+    float *height;
+    int *health;        /**< Enemies with no health left are removed after the collision pass. */
+    float *turn;        /**< Radians a homing bullet turns towards its target per tick. 0 flies straight. */
+    unsigned int *targetSlot; /**< The enemy a homing bullet is after, as the two halves of an EntityHandle. */
+    unsigned int *targetGeneration;
+    int *slot;          /**< Slot owned by each index. Indices past count hold the free slots. */
+    int *index;         /**< Index of the entity in each slot. */
+    unsigned int *generation; /**< Per slot, bumped whenever the slot's entity is despawned. */
+    void *storage;      /**< The single allocation backing every column. */
+    unsigned int components; /**< Component mask of the pool's archetype, which columns exist. */
+    int count;          /**< The number of live entities. */
+    int capacity;       /**< The number of entities the pool can hold before it has to grow. */
+} EntityPool;
+
+/**
+ * @brief Counters from the last collision pass, used to verify the broadphase.
+ *
+ */
+typedef struct CollisionStats
+{
+    int candidatePairs;     /**< Bullet/enemy pairs that reached the narrow phase. */
+    int hits;               /**< Pairs that actually collided. */
+} CollisionStats;
+
+/**
+ * @brief Uniform grid over the playfield used as a collision broadphase.
+ *
+ * Rebuilt every tick with a counting sort, so entity indices are stored grouped
+ * by cell in one flat array: the entities of cell c are items[cellStart[c]] up to
+ * items[cellStart[c + 1]].
+ */
+typedef struct SpatialGrid
+{
+    float cellSize;         /**< Width and height of a cell in pixels. */
+    int columns;            /**< Number of cells across the playfield. */
+    int rows;               /**< Number of cells down the playfield. */
+    int *cellStart;         /**< Offset of each cell into items, columns*rows + 1 entries. */
+    int *cellFill;          /**< Scratch write cursor per cell, used while building. */
+    int *items;             /**< Entity indices grouped by cell. */
+    int itemCapacity;       /**< Size of items. */
+    int *lastQuery;         /**< Per entity stamp of the last query that returned it. */
+    int *results;           /**< Entity indices returned by the last query. */
+    int entityCapacity;     /**< Size of lastQuery. */
+    int queryStamp;         /**< Incremented on every query. */
+    CollisionStats stats;   /**< Counters from the last collision pass. */
+} SpatialGrid;
+
+/**
+ * @brief Grid of directions towards a goal cell, shared by every enemy.
+ *
+ * Enemies read the front buffers (direction and direct) while the next field is
+ * integrated into the back buffers a bounded number of cell visits per tick. The buffers
+ * are swapped once a pass is complete.
+ */
+typedef struct FlowField
+{
+    float cellSize;         /**< Width and height of a cell in pixels. */
+    int columns;            /**< Number of cells across the playfield. */
+    int rows;               /**< Number of cells down the playfield. */
+    unsigned char *blocked; /**< Non zero for cells enemies can't walk through. */
+    int blockedCount;       /**< Number of blocked cells. With none, every cell is direct. */
+    float *directionX;      /**< Unit direction to walk in, per cell. */
+    float *directionY;
+    unsigned char *direct;  /**< Non zero where enemies should head straight for the goal instead. */
+    int readyGoal;          /**< Goal cell of the front buffers, -1 before the first pass finishes. */
+    float *nextDirectionX;  /**< Back buffers of the pass in progress. */
+    float *nextDirectionY;
+    unsigned char *nextDirect;
+    int *distance;          /**< Steps from each cell to the goal of the pass in progress. */
+    int *queue;             /**< Breadth first search queue, one slot per cell. */
+    int queueHead;
+    int queueTail;
+    int cursor;             /**< Next cell to resolve once the search is done, -1 while searching. */
+    int goal;               /**< Goal cell of the pass in progress, -1 when idle. */
+    int pendingGoal;        /**< Goal cell to start on once the current pass is done. */
+} FlowField;
+
+/**
+ * @brief Separation and alignment pushes for a swarm, computed from each entity's
+ * nearest neighbours at the start of a tick.
+ *
+ */
+typedef struct Flock
+{
+    SpatialGrid *grid;  /**< Entities binned by position, in cells FLOCK_RADIUS wide. */
+    float *binnedX;     /**< Copies of the positions and headings in grid->items order, */
+    float *binnedY;     /**< so a cell's neighbours are read from consecutive memory. */
+    float *binnedDirectionX;
+    float *binnedDirectionY;
+    float *pushX;       /**< Extra movement per entity for the coming tick. */
+    float *pushY;
+    int capacity;       /**< Size of the push columns. */
+} Flock;
+
+/**
+ * @brief Cosmetic particles, stored as a structure of arrays like EntityPool. The
+ * capacity is fixed when the system is created, so effects never allocate, and live
+ * particles are kept packed in [0, count).
+ *
+ */
+typedef struct ParticleSystem
+{
+    float *x;           /**< Centre of the particle. */
+    float *y;
+    float *previousX;   /**< Centre at the start of the last tick, used to interpolate rendering. */
+    float *previousY;
+    float *velocityX;   /**< Movement per tick, slowed down by PARTICLE_DRAG every tick. */
+    float *velocityY;
+    float *life;        /**< Ticks left before the particle is removed. */
+    float *scale;       /**< Size in pixels, shrunk by PARTICLE_SHRINK every tick. */
+    Color *tint;
+    void *storage;      /**< The single allocation backing every column. */
+    int count;          /**< The number of live particles. */
+    int capacity;       /**< Particles emitted past this are dropped. */
+} ParticleSystem;
+
+/**
+ * @brief A burst of particles, emitted by emitParticles().
+ *
+ */
+typedef struct ParticleEmitter
+{
+    int count;          /**< Particles per burst. */
+    float minSpeed;     /**< Starting speed range, in pixels per tick. */
+    float maxSpeed;
+    float spread;       /**< Angle the burst fans out over, in radians. 2*PI sprays all round. */
+    int life;           /**< Ticks the particles live for, up to twice this. */
+    float scale;        /**< Starting size in pixels. */
+    Color tint;
+} ParticleEmitter;
+
+/**
+ * @brief The arguments of a parallel entity update.
+ *
+ */
+typedef struct UpdateJob
+{
+    EntityPool *pool;   /**< The entities being updated. */
+    Vector2 target;     /**< Where the entities are heading, if anywhere. */
+    const Vector2 *partner; /**< Second target, chased instead of target by the entities nearer to it, or NULL. */
+    FlowField *field;   /**< Flow field to follow around obstacles, or NULL. */
+    Flock *flock;       /**< Pushes away from and along with neighbours, or NULL. */
+} UpdateJob;
+
+/**
+ * @brief The player's input for one tick, read from the keyboard and mouse or
+ * generated by the headless benchmark.
+ *
+ */
+typedef struct PlayerInput
+{
+    bool up;        /**< Move up. */
+    bool down;      /**< Move down. */
+    bool left;      /**< Move left. */
+    bool right;     /**< Move right. */
+    bool fire;      /**< Fire a bullet. Stays set until a tick fires it. */
+    Vector2 aim;    /**< Where the bullet is fired at. */
+} PlayerInput;
+
+/**
+ * @brief State of the bot that plays in place of the keyboard and mouse. Everything else
+ * it decides on is read from the game each tick, so a bot plays the same on every run.
+ *
+ */
+typedef struct Bot
+{
+    Vector2 heading;        /**< Direction the bot walked last tick. Smooths its path so it doesn't twitch between keys. */
+    float orbit;            /**< 1 or -1, the way the bot circles the swarm. Flips when it runs into a wall. */
+    int wallTicks;          /**< Ticks the bot has been pinned against a wall. */
+} Bot;
+
+/**
+ * @brief A CSV log of a long run, one row every interval ticks or frames. Each row holds
+ * the frame time percentiles of the frames since the last one, so a slowdown late in
+ * the run shows up in the rows it happened in rather than being averaged away.
+ *
+ */
+typedef struct SoakLog
+{
+    FILE *file;
+    int interval;           /**< Frames per row. */
+    float *frameTimes;      /**< Milliseconds of each frame since the last row. */
+    int frameCount;
+    int rows;               /**< Rows written so far. */
+    double start;           /**< When the log was opened. */
+    long long allocations;  /**< Tracked allocations made before the frames since the last row. */
+} SoakLog;
+
+#define MEMORY_MAX_MODULES 64   // Files allocations are counted for. Files past this count towards the last one
+
+/**
+ * @brief Allocations made from one source file, see Memory.h. Sizes are what was asked
+ * for, not counting the tracker's header or the C library's own overhead.
+ *
+ */
+typedef struct MemoryModule
+{
+    const char *file;       /**< __FILE__ of its first allocation. */
+    const char *name;       /**< The file's name without its directories, e.g. "Pool.h". */
+    size_t liveBytes;
+    size_t peakBytes;       /**< Most liveBytes has been. */
+    int liveBlocks;         /**< Allocations not yet freed. */
+    long long allocations;  /**< Made since the start, reallocations included. */
+    int frameAllocations;   /**< Made since beginMemoryFrame(). */
+    size_t frameBytes;      /**< Asked for since beginMemoryFrame(). */
+    float allocationRate;   /**< Allocations per frame, averaged over the last second or so. */
+    float byteRate;         /**< Bytes asked for per frame, averaged the same way. */
+} MemoryModule;
+
+/**
+ * @brief Instructions of the bullet pattern bytecode. Each is one byte, followed by its
+ * operand if it has one: a float for the PATTERN_FLOAT_OPS, a uint16_t for the others
+ * marked below. Patterns are compiled from text by loadPatterns().
+ *
+ */
+typedef enum PatternOp
+{
+    PATTERN_END = 0,    // Ends the run
+    PATTERN_FIRE,       // Fires a bullet along the heading
+    PATTERN_AIM,        // Points the heading back at the aim point
+    PATTERN_TURN,       // float: degrees added to the heading
+    PATTERN_SPEED,      // float: speed of the bullets fired after it, in pixels per tick
+    PATTERN_SIZE,       // float: size of the bullets fired after it
+    PATTERN_HOME,       // float: degrees per tick the bullets fired after it turn towards the target
+    PATTERN_WAIT,       // uint16_t: ticks to wait before carrying on
+    PATTERN_REPEAT,     // uint16_t: times to run the instructions up to the matching PATTERN_LOOP
+    PATTERN_LOOP,       // uint16_t: offset of the first instruction after the matching PATTERN_REPEAT
+} PatternOp;
+
+#define PATTERN_MAX_DEPTH 4     // Loops a pattern can nest
+#define PATTERN_MAX_RUNNERS 64  // Patterns in flight at once. A shot fired with every runner busy is dropped
+
+/**
+ * @brief A named pattern, the stretch of PatternTable code it starts at.
+ *
+ */
+typedef struct BulletPattern
+{
+    char name[32];          /**< Name used in the patterns file, e.g. "spread". */
+    int start;              /**< Offset of its first instruction. */
+    int bullets;            /**< Bullets one run fires. A shot may have this many times CURRENT_MAX_BULLETS in flight. */
+    bool homing;            /**< Fires homing bullets, so a shot has to pick a target. */
+} BulletPattern;
+
+/**
+ * @brief Every pattern of a patterns file, compiled into one block of bytecode.
+ *
+ */
+typedef struct PatternTable
+{
+    BulletPattern *patterns;
+    int patternCount;       /**< 0 when nothing is loaded. Shots then fire the one bullet they always did. */
+    unsigned char *code;
+    int codeSize;
+    void *storage;          /**< The single allocation backing the tables. */
+} PatternTable;
+
+/**
+ * @brief One shot's pattern being played out. Patterns that wait run over several ticks,
+ * firing from wherever the shooter is by then.
+ *
+ */
+typedef struct PatternRunner
+{
+    int pc;                 /**< Offset of the next instruction. */
+    int wait;               /**< Ticks left before the runner carries on. */
+    int shooter;            /**< 0 for the player, 1 for the partner. */
+    int limit;              /**< Bullets allowed in flight while it fires. */
+    Vector2 aim;            /**< Unit direction to the aim point when the shot was fired. */
+    float heading;          /**< Degrees off aim of the next bullet. */
+    float speed;            /**< Of the next bullet, in pixels per tick. */
+    float size;
+    float homing;           /**< Degrees per tick the next bullet turns towards target. */
+    EntityHandle target;    /**< Enemy closest to the aim point when the shot was fired. */
+    int loops[PATTERN_MAX_DEPTH]; /**< Runs left of each loop the runner is in, innermost last. */
+    int depth;              /**< Loops the runner is in. */
+} PatternRunner;
+
+/**
+ * @brief The patterns in flight, in the order they were fired.
+ *
+ */
+typedef struct PatternRunners
+{
+    PatternRunner runners[PATTERN_MAX_RUNNERS];
+    int count;
+} PatternRunners;
+
+/**
+ * @brief A recorded session: its seed and the input of every tick, stored as changes in
+ * a raylib AutomationEventList. Events are keyed by tick rather than rendered frame, so
+ * a replay doesn't depend on how fast the recording machine drew.
+ *
+ */
+typedef struct Replay
+{
+    AutomationEventList events; /**< The session's events. Their frame field holds the tick. */
+    uint64_t seed;              /**< Seed the session was started with. */
+    uint32_t checksum;          /**< checksumGame() at the end of the session. */
+    int length;                 /**< Ticks in the session. */
+    int tick;                   /**< Ticks recorded or played so far. */
+    int cursor;                 /**< Next event to play. */
+    PlayerInput input;          /**< Input as of the last recorded or played tick. */
+    bool hasChecksum;           /**< False if the recording was cut short, so there is nothing to verify. */
+    bool recording;             /**< Set between startReplayRecording() and finishReplayRecording(). */
+} Replay;
 
 /**
  * @brief  PowerUp struct
@@ -81,17 +447,251 @@ typedef struct PowerUp
     Effect effect;
     Color color;
     bool isActive;
-    Texture2D sprite;
+    Rectangle sprite;       /**< The power-up's region of the sprite atlas. */
 } PowerUp;
 
+/**
+ * @brief Everything the systems of a tick read and write, gathered by updateGameplay().
+ *
+ */
+typedef struct GameTick
+{
+    Entity *player;
+    Entity *partner;            /**< The second player of a co-op session, or NULL. */
+    EntityPool *bullets;
+    EntityPool *enemies;
+    SpatialGrid *grid;
+    FlowField *flow;
+    Flock *flock;
+    PowerUp *powerup;
+    PlayerInput *input;         /**< The fire flag is cleared once the shot is fired. */
+    PlayerInput *partnerInput;  /**< The second player's input, NULL without a partner. */
+    long long *frame;           /**< Ticks simulated before this one. 64 bits, unattended runs go on for days. */
+    int *previousScore;
+    GameScreen *currentScreen;
+    Rectangle view;             /**< Area of the world on screen, set once the player has moved. */
+} GameTick;
+
+/**
+ * @brief A step of the simulation, run once per tick in the order of gameSystems.
+ *
+ */
+typedef struct GameSystem
+{
+    int phase;                  /**< ProfilePhase the system is timed under. */
+    void (*run)(GameTick *tick);
+} GameSystem;
+
+/**
+ * @brief A named sub-rectangle of the sprite atlas, named after the file it came from.
+ *
+ */
+typedef struct AtlasRegion
+{
+    char name[32];          /**< File name without the extension, e.g. "zombie". */
+    Rectangle source;       /**< Where the image ended up in the atlas texture. */
+} AtlasRegion;
+
+/**
+ * @brief Every sprite packed into one texture, so drawing them never switches textures.
+ *
+ */
+typedef struct TextureAtlas
+{
+    Texture2D texture;
+    AtlasRegion *regions;
+    int count;
+} TextureAtlas;
+
+/**
+ * @brief A kind of enemy a level can spawn.
+ *
+ */
+typedef struct EnemyKind
+{
+    char name[32];          /**< Name used in the levels file, e.g. "brute". */
+    int minSpeed;           /**< Spawned enemies get a speed in [minSpeed, maxSpeed], in pixels per tick. */
+    int maxSpeed;
+    int health;             /**< Bullets it takes to kill one. */
+} EnemyKind;
+
+/**
+ * @brief The spawn rules in force once the score reaches scoreReq.
+ *
+ */
 typedef struct Level
 {
-    int EnemySpawnInterval;
-    int scoreReq;
-    int maxEnemies;
-    Texture2D floorTexture;
-    
-}Level;
+    int scoreReq;           /**< Score the level starts at. */
+    int maxEnemies;         /**< Enemies allowed on screen at once. */
+    int spawnInterval;      /**< Ticks between spawns. */
+    int spawnBudget;        /**< Enemies spawned each time the interval comes round, room permitting. */
+    int totalWeight;        /**< Sum of the level's row of LevelTable weights. */
+} Level;
+
+/**
+ * @brief Every enemy kind, level and obstacle of a levels file, parsed into flat tables.
+ *
+ * The enemy mix of level l is the row weights[l * kindCount] up to
+ * weights[(l + 1) * kindCount], one spawn weight per kind.
+ */
+typedef struct LevelTable
+{
+    EnemyKind *kinds;
+    int kindCount;
+    Level *levels;          /**< Sorted by scoreReq, the first one starting at 0. */
+    int levelCount;         /**< 0 when nothing is loaded. */
+    int *weights;
+    Rectangle *obstacles;   /**< Areas the swarm routes around, whatever the level. */
+    int obstacleCount;
+    void *storage;          /**< The single allocation backing the tables. */
+    char fileName[256];     /**< File the tables were loaded from, watched for changes. */
+    long modTime;           /**< GetFileModTime() of the file when it was last read. */
+    double checkedAt;       /**< GetTime() of the last check for changes. */
+} LevelTable;
+
+/**
+ * @brief One square of the floor, drawn once into its own texture and kept while it is
+ * near the camera.
+ *
+ */
+typedef struct FloorChunk
+{
+    RenderTexture2D target; /**< Allocated by initFloor(), reused by whichever chunk takes the slot. */
+    int column;             /**< Position in the world, in chunks. */
+    int row;
+    bool loaded;            /**< Whether target holds the chunk at column, row. */
+} FloorChunk;
+
+/**
+ * @brief The floor of the world, streamed in chunks around the camera. There is a fixed
+ * number of slots, enough for the chunks the view and its margin can overlap, so the
+ * floor takes the same memory however big the world is.
+ *
+ */
+typedef struct Floor
+{
+    FloorChunk *chunks;
+    int slotCount;
+    int generated;          /**< Chunks drawn since initFloor(). */
+    int evicted;            /**< Chunks dropped for being too far from the camera. */
+} Floor;
+
+/**
+ * @brief The whole simulation state as of the start of a tick, packed into one growable
+ * buffer. Loading it back puts every global, pool and random stream where it was, so
+ * the ticks after it can be simulated again.
+ *
+ */
+typedef struct Snapshot
+{
+    unsigned char *data;
+    size_t size;            /**< Bytes in use. */
+    size_t capacity;        /**< Bytes allocated, only ever grows. */
+    int tick;               /**< Tick the state is from, -1 when empty. */
+} Snapshot;
+
+#define NET_MAX_ROLLBACK 8                      // Most ticks a session simulates ahead of its peer's input
+#define NET_INPUT_RING 64                       // Ticks of input kept, a power of two
+#define NET_SNAPSHOT_RING (NET_MAX_ROLLBACK + 2) // Snapshots kept, enough to go back NET_MAX_ROLLBACK ticks
+#define NET_MAX_PACKET 512                      // Largest datagram sent or received
+
+/**
+ * @brief One player's input for one tick, as sent over the network.
+ *
+ */
+typedef struct NetInput
+{
+    unsigned char buttons;  /**< NET_BUTTON_* flags. */
+    float aimX;             /**< PlayerInput.aim. */
+    float aimY;
+} NetInput;
+
+/**
+ * @brief A datagram held back by the latency shim.
+ *
+ */
+typedef struct NetDelayedPacket
+{
+    double sendAt;          /**< Time it leaves, in the clock passed to the shim. */
+    int size;
+    unsigned char data[NET_MAX_PACKET];
+} NetDelayedPacket;
+
+/**
+ * @brief A non blocking UDP socket talking to one peer, with an optional shim that
+ * delays and drops what is sent, to test over loopback as if over a real link.
+ *
+ */
+typedef struct NetSocket
+{
+    intptr_t handle;        /**< OS socket, -1 when closed. */
+    uint32_t peerAddress;   /**< IPv4 address of the peer in host order, 0 until known. */
+    uint16_t peerPort;
+    float latency;          /**< Delay added to every packet, in seconds. */
+    float jitter;           /**< Up to this much more delay, at random. Packets can arrive out of order. */
+    float loss;             /**< Fraction of packets dropped, 0 to 1. */
+    uint64_t shimRandom;    /**< State of the shim's own generator, which gameplay never sees. */
+    NetDelayedPacket *delayed; /**< NET_DELAY_SLOTS packets waiting for their time. */
+    int delayedCount;
+} NetSocket;
+
+/**
+ * @brief What rolling back costs, measured by the session.
+ *
+ */
+typedef struct NetStats
+{
+    int saves;              /**< Snapshots saved. */
+    double saveSeconds;     /**< Total time spent saving them. */
+    double maxSaveSeconds;
+    int loads;              /**< Snapshots loaded to roll back. */
+    double loadSeconds;
+    double maxLoadSeconds;
+    size_t snapshotBytes;   /**< Size of the last snapshot saved. */
+    int rollbacks;          /**< Times a late input sent the session back. */
+    int resimulatedTicks;   /**< Ticks simulated again after rolling back. */
+    int maxRollback;        /**< Most ticks simulated again at once. */
+    double rollbackSeconds; /**< Total time spent loading and simulating again. */
+    double maxRollbackSeconds; /**< Worst single rollback, compared with TICK_TIME. */
+    int overBudget;         /**< Rollbacks that took longer than TICK_TIME. */
+    int stalls;             /**< Ticks held back for being NET_MAX_ROLLBACK ahead of the peer. */
+    int packetsSent;
+    int packetsReceived;
+    int checksumsCompared;  /**< Confirmed ticks checked against the peer. */
+    int desyncs;            /**< Of those, the ones that didn't match. */
+} NetStats;
+
+/**
+ * @brief A two player co-op session kept in lockstep with rollback. Both peers simulate
+ * every tick as soon as their own input is in, guessing the other's. When the real
+ * input arrives and the guess was wrong, the session loads the snapshot from before
+ * that tick and simulates the ticks since again.
+ *
+ * Inputs and snapshots live in rings indexed by tick. A ring slot only holds its tick
+ * while it is less than the ring's size behind the newest one.
+ */
+typedef struct NetSession
+{
+    NetSocket socket;
+    int localPlayer;        /**< 0 for the host, who plays the player, 1 for the guest, who plays the partner. */
+    bool connected;         /**< The handshake is done and seed is agreed. */
+    uint64_t seed;          /**< Seed of the session, picked by the host. */
+    double lastHello;       /**< When the guest last asked to join. */
+    NetInput localInputs[NET_INPUT_RING];
+    NetInput remoteInputs[NET_INPUT_RING];
+    NetInput usedInputs[NET_INPUT_RING]; /**< Remote input each simulated tick used, guessed or not. */
+    int localTick;          /**< Local inputs are stored for every tick before this. */
+    int remoteTick;         /**< Remote inputs have arrived for every tick before this. */
+    int remoteAck;          /**< The peer has every local input before this. */
+    int tick;               /**< Next tick to simulate. */
+    int rollbackTick;       /**< Earliest tick simulated with a wrong guess, or -1. */
+    int lastTick;           /**< No tick past this is simulated. */
+    Snapshot snapshots[NET_SNAPSHOT_RING]; /**< State at the start of each recent tick. */
+    int checkTicks[NET_INPUT_RING]; /**< Ticks whose checksum is kept, every NET_CHECKSUM_INTERVAL, -1 if none. */
+    uint32_t checksums[NET_INPUT_RING]; /**< checksumSession() at the start of each of checkTicks. */
+    int comparedTick;       /**< Newest tick compared with the peer's checksum. */
+    NetStats stats;
+} NetSession;
 
 // Linked List of Entities. Used for bullets and enemies
 typedef struct EntityLL
@@ -24,9 +24,30 @@
 #include "Bullet.h"
 #include "Structs.h"
 #include "Enemy.h"
+#include "Grid.h"
+#include "FlowField.h"
+#include "Flocking.h"
+#include "Timer.h"
+#include "Profiler.h"
+#include "Random.h"
+#include "SpriteBatch.h"
+#include "Atlas.h"
+#include "Replay.h"
+#include "Particles.h"
+#include "World.h"
+#include "Snapshot.h"
+#include "Net.h"
+#include "Patterns.h"
+#include "Bot.h"
+#include "Soak.h"
+#include "Memory.h"
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <assert.h>
+#include <signal.h>
 
 #if defined(PLATFORM_WEB)
 #include <emscripten/emscripten.h>
@@ -40,81 +61,394 @@ Entity *initPlayer();
 
 void loadResources();
 
-void updateLogo(int *frame, GameScreen *currentScreen);
-void updateGameplay(); //TODO: Implement this function
-
-
-void renderScreen(Entity *player, Entity **bullets, Entity **enemies, PowerUp *powerup, int frame);
+void updateLogo(long long *frame, GameScreen *currentScreen);
+void updateGameplay(Entity *player, EntityPool *bullets, EntityPool *enemies, SpatialGrid *grid, FlowField *flow, Flock *flock, PowerUp *powerup,
+                    PlayerInput *input, long long *frame, int *previousScore, GameScreen *currentScreen);
+void runTick(GameTick *tick);
+void startSession(Entity *player, Entity *partner, EntityPool *bullets, EntityPool *enemies, FlowField *flow, PowerUp *powerup,
+                  long long *frame, int *previousScore, uint64_t seed);
+
+void movePlayerSystem(GameTick *tick);
+void spawnSystem(GameTick *tick);
+void moveBulletsSystem(GameTick *tick);
+void flowFieldSystem(GameTick *tick);
+void flockingSystem(GameTick *tick);
+void moveEnemiesSystem(GameTick *tick);
+void collisionSystem(GameTick *tick);
+void bulletBoundsSystem(GameTick *tick);
+void particlesSystem(GameTick *tick);
+
+int runHeadless(int ticks, int maxEnemies, int maxBullets, bool bot, SoakLog *soak);
+int runReplay(const char *fileName, const char *timingsFile);
+int runSteeringBenchmark(int count, int iterations);
+int runNetTest(int ticks, int maxEnemies, float latencyMs, float lossPercent);
+void unloadNetTest(GameTick *games, Snapshot *states, NetSession *sessions);
+
+
+void renderScreen(Entity *player, Entity *partner, EntityPool *bullets, EntityPool *enemies, PowerUp *powerup, long long frame, float alpha);
 void renderLogo();
 void renderTitle();
 void renderEnding();
 void unloadResources();
 
 
-void playerMovementInput(Entity *player);
-void renderPlayer(Entity *player);
+void readPlayerInput(PlayerInput *input);
+void playerMovementInput(Entity *player, PlayerInput *input);
+void leashPlayers(Entity *player, Entity *partner);
+void renderPlayer(Entity *player, Vector2 aim, Color tint, float alpha);
+Vector2 getPlayerFocus(Entity *player, float alpha);
+Vector2 getSessionFocus(Entity *player, Entity *partner, float alpha);
 
-void createPowerup(PowerUp *powerup);
+void createPowerup(PowerUp *powerup, Rectangle area);
 void changeRandomEffect(PowerUp *powerup);
 void renderPowerup(PowerUp *powerup);
 
-void renderHUD(Entity *player, int frame, int currentScore);
-void resetGame(Entity *player, Entity **bullets, Entity **enemies, int *frame, int *prevScore);
+void renderHUD(Entity *player, Entity *partner, long long frame, int currentScore);
+void resetPlayer(Entity *player, float x, float y);
+void resetGame(Entity *player, EntityPool *bullets, EntityPool *enemies, long long *frame, int *prevScore);
 
 int checkCollisions(
-    Entity **enemies,
-    Entity **bullets,
+    EntityPool *enemies,
+    EntityPool *bullets,
+    SpatialGrid *grid,
     Entity *player,
     PowerUp *powerup,
     int *score);
+void applyPowerup(PowerUp *powerup, Entity *player, EntityPool *enemies, int *score);
+void fireWeapon(Entity *shooter, int index, Vector2 origin, Vector2 aim, EntityPool *bullets, EntityPool *enemies);
+bool loadWeapons(const char *fileName, const char *weaponName);
+int checkPartnerCollisions(EntityPool *enemies, Entity *partner, PowerUp *powerup, int *score);
 
-void cleanupEntities(Entity **bullets, Entity **enemies, Entity *player);
+void cleanupEntities(EntityPool *bullets, EntityPool *enemies, SpatialGrid *grid, FlowField *flow, Flock *flock, Entity *player);
+size_t getGameBytes(EntityPool *bullets, EntityPool *enemies, SpatialGrid *grid, FlowField *flow, Flock *flock);
+void stopRun(int number);
 
 Vector2 createVector2(int x, int y);
 
+// The systems of a tick, in the order updateGameplay() runs them
+const GameSystem gameSystems[] = {
+    { PHASE_MOVE_PLAYER, movePlayerSystem },    // First, every later system sees the view around the player
+    { PHASE_SPAWN, spawnSystem },
+    { PHASE_UPDATE_BULLETS, moveBulletsSystem },
+    { PHASE_FLOW_FIELD, flowFieldSystem },      // Before the enemies follow it
+    { PHASE_FLOCKING, flockingSystem },         // From where the enemies were before they move
+    { PHASE_UPDATE_ENEMIES, moveEnemiesSystem },
+    { PHASE_COLLISIONS, collisionSystem },      // After everything has moved, so whole paths are tested
+    { PHASE_BULLET_BOUNDS, bulletBoundsSystem },// After collisions, so a bullet's last stretch can still hit
+    { PHASE_PARTICLES, particlesSystem },
+};
+#define GAME_SYSTEM_COUNT (int)(sizeof(gameSystems) / sizeof(gameSystems[0]))
+
+volatile sig_atomic_t runStopped = 0; // Set by Ctrl+C during a headless run, which then ends as if it had run out of ticks
+
 //----------------------------------------------------------------------------------
 // Main entry point
 //----------------------------------------------------------------------------------
-int main(void)
+// The benchmark project compiles this file with SWARM_NO_MAIN and brings its own main()
+#if !defined(SWARM_NO_MAIN)
+int main(int argc, char *argv[])
 {
+    // Command line options:
+    // swarm [--seed N] [--threads N] [--headless [--ticks N] [--enemies N] [--bullets N]]
+    // swarm [--record FILE]                    saves the last session played as a replay
+    // swarm --replay FILE                      plays a replay back in the window at normal speed
+    // swarm --replay FILE --headless [--timings FILE]
+    //                                          plays it as fast as possible, optionally writing per tick timings
+    // swarm [--levels FILE]                    levels to play, resources/levels.txt by default. The
+    //                                          headless benchmark only uses levels when given this
+    // swarm [--patterns FILE] [--weapon NAME]  bullet patterns to fire, resources/patterns.txt by default,
+    //                                          and the one players start with. Like levels, the headless
+    //                                          benchmark only uses patterns when given this
+    // swarm --bench-steering N
+    // swarm --host PORT | --join ADDRESS:PORT  two player co-op over UDP, kept in sync by rolling back
+    //       [--net-latency MS] [--net-loss PERCENT]
+    //                                          slows down and drops what this end sends, to test on one machine
+    // swarm --net-test N [--enemies N] [--net-latency MS] [--net-loss PERCENT]
+    //                                          plays N co-op ticks between two sessions over loopback
+    // swarm --bot [--headless [--ticks N]]    the bot plays instead of the keyboard and mouse, restarting
+    //                                          whenever it dies. In the window it plays one tick per frame
+    //                                          with no frame cap. --ticks 0 runs until Ctrl+C
+    //       [--soak-log FILE [--soak-interval N]]
+    //                                          writes frame times, entity counts and memory every N frames
+    bool headless = false;
+    bool botPlays = false;
+    const char *soakFile = NULL;
+    int soakInterval = SOAK_DEFAULT_INTERVAL;
+    const char *recordFile = NULL;
+    const char *replayFile = NULL;
+    const char *timingsFile = NULL;
+    const char *levelsFile = NULL;
+    const char *patternsFile = NULL;
+    const char *weaponName = NULL;
+    int steeringCount = 0;
+    int hostPort = 0;
+    const char *joinAddress = NULL;
+    int netTestTicks = 0;
+    float netLatency = 0.0f;
+    float netLoss = 0.0f;
+    int ticks = 100000;
+    int maxEnemies = MAX_ENEMIES;
+    int maxBullets = MAX_BULLETS;
+    int threads = 0;
+    bool seedGiven = false;
+    uint64_t seed = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--headless") == 0) headless = true;
+        else if (strcmp(argv[i], "--bot") == 0) botPlays = true;
+        else if (i + 1 < argc)
+        {
+            if (strcmp(argv[i], "--ticks") == 0) ticks = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--enemies") == 0) maxEnemies = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--bullets") == 0) maxBullets = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--threads") == 0) threads = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--bench-steering") == 0) steeringCount = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--record") == 0) recordFile = argv[++i];
+            else if (strcmp(argv[i], "--replay") == 0) replayFile = argv[++i];
+            else if (strcmp(argv[i], "--timings") == 0) timingsFile = argv[++i];
+            else if (strcmp(argv[i], "--levels") == 0) levelsFile = argv[++i];
+            else if (strcmp(argv[i], "--patterns") == 0) patternsFile = argv[++i];
+            else if (strcmp(argv[i], "--weapon") == 0) weaponName = argv[++i];
+            else if (strcmp(argv[i], "--host") == 0) hostPort = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--join") == 0) joinAddress = argv[++i];
+            else if (strcmp(argv[i], "--net-test") == 0) netTestTicks = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--net-latency") == 0) netLatency = atof(argv[++i]);
+            else if (strcmp(argv[i], "--net-loss") == 0) netLoss = atof(argv[++i]);
+            else if (strcmp(argv[i], "--soak-log") == 0) soakFile = argv[++i];
+            else if (strcmp(argv[i], "--soak-interval") == 0) soakInterval = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--seed") == 0)
+            {
+                seed = strtoull(argv[++i], NULL, 10);
+                seedGiven = true;
+            }
+        }
+    }
+
+    // Benchmarks default to a fixed seed so every run gets the same workload
+    if (!seedGiven)
+    {
+        seed = (headless || netTestTicks > 0)? 1 : (uint64_t)time(NULL);
+    }
+    seedRandom(seed);
+
+    if (steeringCount > 0)
+    {
+        SetTraceLogLevel(LOG_WARNING);
+        return runSteeringBenchmark(steeringCount, 200);
+    }
+
+    if (netTestTicks > 0)
+    {
+        SetTraceLogLevel(LOG_WARNING);
+        if ((levelsFile != NULL && !loadLevels(&levelTable, levelsFile)) || !loadWeapons(patternsFile, weaponName))
+        {
+            unloadLevels(&levelTable);
+            return 1;
+        }
+        initJobSystem(threads);
+        int result = runNetTest(netTestTicks, maxEnemies, netLatency, netLoss);
+        shutdownJobSystem();
+        unloadPatterns(&patternTable);
+        unloadLevels(&levelTable);
+        SetTraceLogLevel(LOG_INFO);
+        reportMemory();
+        return result;
+    }
+
+    // Replays are of game sessions, so they need the game's levels and patterns too
+    if (!headless || replayFile != NULL)
+    {
+        levelsFile = (levelsFile != NULL)? levelsFile : LEVELS_FILE;
+        patternsFile = (patternsFile != NULL)? patternsFile : PATTERNS_FILE;
+    }
+
+    if (headless)
+    {
+        // Bullets and dropped enemies log every tick, which would swamp the timings
+        SetTraceLogLevel(LOG_WARNING);
+        if ((levelsFile != NULL && !loadLevels(&levelTable, levelsFile)) || !loadWeapons(patternsFile, weaponName))
+        {
+            unloadLevels(&levelTable);
+            return 1;
+        }
+        SoakLog soak = { 0 };
+        if (soakFile != NULL && !openSoakLog(&soak, soakFile, soakInterval))
+        {
+            unloadPatterns(&patternTable);
+            unloadLevels(&levelTable);
+            return 1;
+        }
+        initJobSystem(threads);
+        int result = (replayFile != NULL)? runReplay(replayFile, timingsFile) : runHeadless(ticks, maxEnemies, maxBullets, botPlays, &soak);
+        shutdownJobSystem();
+        closeSoakLog(&soak);
+        unloadPatterns(&patternTable);
+        unloadLevels(&levelTable);
+        SetTraceLogLevel(LOG_INFO);
+        reportMemory();
+        return result;
+    }
+
     // Initialize critical system components
     InitWindow(screenWidth, screenHeight, windowTitle);
-    SetTargetFPS(60);
+    SetTargetFPS(TARGET_FPS);
     InitAudioDevice();
 
+    // The bot plays a tick per frame as fast as frames can be drawn. Not in co-op, which
+    // has to keep time with the other end, or in a replay, which already has its input
+    bool net = hostPort > 0 || joinAddress != NULL;
+    botPlays = botPlays && replayFile == NULL;
+    bool botRushes = botPlays && !net;
+    if (botRushes)
+    {
+        SetTargetFPS(0);
+    }
+
     loadResources();
+    loadLevels(&levelTable, levelsFile);
+    loadWeapons(patternsFile, weaponName);
+    initParticles(&particles, MAX_PARTICLES);
+    initJobSystem(threads);
+    TraceLog(LOG_INFO, "SWARM: Random seed %llu", (unsigned long long)randomSeed);
 
     // Variables
-    int frame = 0;
+    long long frame = 0;
     int previousScore = 0;
-    int enemyTimer = 50;
+    float accumulator = 0.0f; // Time rendered but not yet simulated
+    PlayerInput input = {0};
+    Replay replay = {0};
+    Bot bot = {0};
+    initBot(&bot);
+    SoakLog soak = {0};
+    long long soakFrames = 0;
+    int deaths = 0;
+
+    // A co-op session. Both ends play the same session, so it can't be recorded, played
+    // back, paused or have its levels change under it
+    NetSession session = {0};
+    if (net)
+    {
+        char address[64] = "127.0.0.1";
+        int port = hostPort;
+        if (joinAddress != NULL)
+        {
+            const char *colon = strrchr(joinAddress, ':');
+            port = (colon != NULL)? atoi(colon + 1) : NET_DEFAULT_PORT;
+            snprintf(address, sizeof(address), "%.*s", (colon != NULL)? (int)(colon - joinAddress) : (int)strlen(joinAddress), joinAddress);
+        }
+
+        bool opened = (joinAddress != NULL)? joinNetSession(&session, address, port) : hostNetSession(&session, port, randomSeed);
+        if (!opened || ((netLatency > 0.0f || netLoss > 0.0f) && !setNetShim(&session.socket, netLatency, netLatency / 2, netLoss, randomSeed)))
+        {
+            closeNetSession(&session);
+            unloadLevels(&levelTable);
+            unloadPatterns(&patternTable);
+            unloadParticles(&particles);
+            shutdownJobSystem();
+            unloadResources();
+            CloseAudioDevice();
+            CloseWindow();
+            return 1;
+        }
+        recordFile = NULL;
+        replayFile = NULL;
+    }
+    if (soakFile != NULL)
+    {
+        openSoakLog(&soak, soakFile, soakInterval);
+    }
 
     // Entity initialization
     Entity *player = initPlayer();
-    Entity **bullets = initBullets();
-    Entity **enemies = initEnemies();
+    Entity *partner = net? initPlayer() : NULL;
+    EntityPool *bullets = initBullets();
+    EntityPool *enemies = initEnemies();
+    SpatialGrid *grid = initGrid(worldWidth, worldHeight, GRID_CELL_SIZE, MAX_ENEMIES, ENEMY_SIZE);
+    FlowField *flow = initFlowField(worldWidth, worldHeight, FLOW_CELL_SIZE);
+    Flock *flock = initFlock(worldWidth, worldHeight, MAX_ENEMIES);
     PowerUp powerup;
-    createPowerup(&powerup);
+    createPowerup(&powerup, getWorldView(getPlayerFocus(player, 1.0f)));
 
-    Entity **entities; 
+    GameScreen currentScreen = LOGO;
+    GameTick game = {
+        .player = player,
+        .partner = partner,
+        .bullets = bullets,
+        .enemies = enemies,
+        .grid = grid,
+        .flow = flow,
+        .flock = flock,
+        .powerup = &powerup,
+        .frame = &frame,
+        .previousScore = &previousScore,
+        .currentScreen = &currentScreen,
+    };
+
+    // Each end draws its own player as the player, facing the mouse
+    Entity *localPlayer = (net && session.localPlayer == 1)? partner : player;
+    Entity *otherPlayer = (net && session.localPlayer == 1)? player : partner;
 
     PlayMusicStream(backgroundSong);
     PlayMusicStream(introSong);
 
-    Level levels[3] = 
-    {
-        {100, 10},
-        {50, 20},
-        {25, 30}
-    };
-
-    GameScreen currentScreen = LOGO;
+    if (replayFile != NULL)
+    { // Straight into the recorded session
+        if (!loadReplay(&replay, replayFile))
+        {
+            goto EXIT;
+        }
+        startSession(player, NULL, bullets, enemies, flow, &powerup, &frame, &previousScore, replay.seed);
+        currentScreen = GAMEPLAY;
+    }
 
     // Cursor functions
     HideCursor();
 
     while (!WindowShouldClose())
     {
+        // Work out how many fixed ticks this frame covers. Whatever is left over is
+        // used to interpolate entities between their last two ticks when rendering.
+        accumulator += GetFrameTime();
+        if (accumulator > MAX_TICKS_PER_FRAME * TICK_TIME)
+        {
+            accumulator = MAX_TICKS_PER_FRAME * TICK_TIME;
+        }
+        int ticks = 0;
+        while (accumulator >= TICK_TIME)
+        {
+            accumulator -= TICK_TIME;
+            ticks++;
+        }
+        float alpha = accumulator / TICK_TIME;
+        if (botRushes)
+        {
+            ticks = 1;
+            alpha = 1.0f;
+        }
+
+        // F3 toggles the profiler overlay, F4 saves what it has recorded, F5 toggles the
+        // memory overlay
+        if (IsKeyPressed(KEY_F3))
+        {
+            setProfilerEnabled(!phaseTimingEnabled);
+        }
+        beginProfilerFrame();
+        if (IsKeyPressed(KEY_F4) && profilerFrames > 0)
+        {
+            exportProfilerCsv("profile.csv");
+        }
+        if (IsKeyPressed(KEY_F5))
+        {
+            memoryOverlayEnabled = !memoryOverlayEnabled;
+        }
+        beginMemoryFrame();
+
+        // Pick up edits to the levels file. Not while a replay is recorded or played, since
+        // it wouldn't play back the same
+        if (replayFile == NULL && !replay.recording && !net && reloadLevels(&levelTable))
+        {
+            applyLevelObstacles(&levelTable, flow);
+        }
 
         // UPDATE LOOP
         switch (currentScreen)
@@ -122,13 +456,30 @@ int main(void)
 
         case LOGO:
         {
-            updateLogo(&frame, &currentScreen);
+            for (int t = 0; t < ticks && currentScreen == LOGO; t++)
+            {
+                updateLogo(&frame, &currentScreen);
+            }
         }
         break;
         case TITLE:
         {
-            if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+            if (net)
+            { // The session starts as soon as the other end is there
+                pumpNetSession(&session, getTimerSeconds());
+                if (session.connected)
+                {
+                    startSession(player, partner, bullets, enemies, flow, &powerup, &frame, &previousScore, session.seed);
+                    currentScreen = GAMEPLAY;
+                }
+            }
+            else if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) || botPlays)
             {
+                startSession(player, NULL, bullets, enemies, flow, &powerup, &frame, &previousScore, randomSeed);
+                if (recordFile != NULL)
+                {
+                    startReplayRecording(&replay, randomSeed);
+                }
                 currentScreen = GAMEPLAY;
             }
         }
@@ -138,69 +489,60 @@ int main(void)
             // Plays background theme
             UpdateMusicStream(backgroundSong);
 
-            // get mouse position for the cursor
-            mousePos = GetMousePosition();
+            // get mouse position for the cursor, in the world the last frame showed
+            beginPhase(PHASE_INPUT);
+            mousePos = GetScreenToWorld2D(GetMousePosition(), worldCamera);
 
             // Pause function
-            if (IsKeyPressed(KEY_SPACE))
+            if (IsKeyPressed(KEY_SPACE) && !net)
             {
                 currentScreen = PAUSE;
+                endPhase(PHASE_INPUT);
                 break;
             }
-            // Input 1 frame
-            playerMovementInput(player);
 
-            // Update the players vector
-            playerV = createVector2(player->body.x, player->body.y);
-
-            if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+            // Input is sampled once per rendered frame and shared by the ticks it covers
+            if (botPlays)
             {
-                createBullet(bullets, playerV, createVector2(GetMouseX(), GetMouseY()));
-            }
-
-            if ((currentScore % 5 == 0 && currentScore > 0) && currentScore != previousScore)
-            { // Every five kills will increase the max number of enemies possible on screen at
-                CURRENT_MAX_ENEMIES++;
-                ENEMY_SPAWN_INTERVAL-= 10;
-                previousScore = currentScore;
-            }
-            if (ENEMY_SPAWN_INTERVAL > 0 && frame % ENEMY_SPAWN_INTERVAL == 0)
-            { // every nth frame, where n is enemyTimer, create an enemy
-                generateNewEnemy(enemies, playerV);
+                updateBot(&bot, &input, localPlayer, enemies, &powerup);
+                mousePos = input.aim;
             }
-            else
+            else if (replayFile == NULL)
             {
-                generateNewEnemy(enemies, playerV);
+                readPlayerInput(&input);
             }
+            endPhase(PHASE_INPUT);
 
-            if ((frame % POWERUP_SPAWN_INTERVAL == 0) && frame > 0)
+            if (net)
             {
-                // If the powerup is still on screen and has not been grabbed, shuffle its
-                // effect and position
-                if (powerup.isActive)
-                { // Change the values
-                    createPowerup(&powerup);
-                }
-                else
-                { // if the powerup is NOT active and the 300th frame has passed, make it active again
-                    powerup.isActive = true;
-                    createPowerup(&powerup);
+                for (int t = 0; t < ticks; t++)
+                {
+                    advanceNetSession(&session, &game, &input, runTick, getTimerSeconds());
                 }
+                pumpNetSession(&session, getTimerSeconds());
+                break;
             }
-            // Update 1 frame
-            updateBullets(bullets);
-            updateEnemies(enemies, playerV);
-
-            // Check collisions 1 frame
-            checkBulletCollisions(bullets);
 
-            player->health -= checkCollisions(enemies, bullets, player, &powerup, &currentScore);
-            if (player->health == 0)
+            for (int t = 0; t < ticks && currentScreen == GAMEPLAY; t++)
+            {
+                if (replayFile != NULL)
+                {
+                    if (!playReplayTick(&replay, &input))
+                    {
+                        uint32_t checksum = checksumGame(player, bullets, enemies);
+                        TraceLog((!replay.hasChecksum || checksum == replay.checksum)? LOG_INFO : LOG_WARNING,
+                                 "SWARM: Replay finished with checksum %08x, recorded %08x", checksum, replay.checksum);
+                        goto EXIT;
+                    }
+                    mousePos = input.aim;
+                }
+                recordReplayTick(&replay, &input);
+                updateGameplay(player, bullets, enemies, grid, flow, flock, &powerup, &input, &frame, &previousScore, &currentScreen);
+            }
+            if (currentScreen == ENDING && replay.recording)
             {
-                currentScreen = ENDING;
+                finishReplayRecording(&replay, checksumGame(player, bullets, enemies), recordFile);
             }
-
-            frame++;
             break;
         }
         case PAUSE:
@@ -213,10 +555,20 @@ int main(void)
         }
         case ENDING:
         {
-            if (IsKeyPressed(KEY_Y))
+            if (net)
+            { // The ending may rest on a guess, keep listening in case it gets rolled back
+                advanceNetSession(&session, &game, &input, runTick, getTimerSeconds());
+            }
+
+            if ((IsKeyPressed(KEY_Y) || botPlays) && !net)
             {
-                // Restart game
-                resetGame(player, bullets, enemies, &frame, &previousScore);
+                deaths++;
+                // Restart game. Every session gets its own seed
+                startSession(player, NULL, bullets, enemies, flow, &powerup, &frame, &previousScore, randomSeed + 1);
+                if (recordFile != NULL)
+                {
+                    startReplayRecording(&replay, randomSeed);
+                }
                 currentScreen = GAMEPLAY;
             }
             else if (IsKeyPressed(KEY_N))
@@ -231,10 +583,18 @@ int main(void)
         }
 
         // RENDER LOOP
+        beginPhase(PHASE_RENDER);
         BeginDrawing();
         {
+            // A co-op session only shows the ending once the peer's inputs confirm it
+            GameScreen shownScreen = currentScreen;
+            if (net && currentScreen == ENDING && !isNetSessionConfirmed(&session))
+            {
+                shownScreen = GAMEPLAY;
+            }
+
             ClearBackground(RAYWHITE);
-            switch (currentScreen)
+            switch (shownScreen)
             {
             case LOGO:
             {
@@ -245,20 +605,35 @@ int main(void)
             case TITLE:
             {
                 renderTitle();
+                if (net)
+                {
+                    DrawText(session.localPlayer == 0? "Waiting for the other player to join" : "Joining the host",
+                             30, screenHeight - 50, 20, GRAY);
+                }
             }
             break;
 
             case GAMEPLAY:
             {
-                renderScreen(player, bullets, enemies, &powerup, frame);
-                renderHUD(player, frame, currentScore);
+                renderScreen(localPlayer, otherPlayer, bullets, enemies, &powerup, frame, alpha);
+                renderHUD(localPlayer, otherPlayer, frame, currentScore);
+
+                #ifdef SWARM_DEBUG
+                    BeginMode2D(worldCamera);
+                    drawFlowField(flow);
+                    EndMode2D();
+
+                    // Broadphase counters from the last collision pass
+                    DrawText(TextFormat("Candidate pairs: %d\tHits: %d", grid->stats.candidatePairs, grid->stats.hits),
+                             30, screenHeight - 25, 15, BLUE);
+                #endif
             }
             break;
 
             case PAUSE:
             { // Same as gameplay except with added faded rectangle
-                renderScreen(player, bullets, enemies, &powerup, frame);
-                renderHUD(player, frame, currentScore);
+                renderScreen(localPlayer, otherPlayer, bullets, enemies, &powerup, frame, alpha);
+                renderHUD(localPlayer, otherPlayer, frame, currentScore);
 
                 DrawRectangle(0, 0, screenWidth, screenHeight, (Color){0, 0, 0, 155});
             }
@@ -276,24 +651,71 @@ int main(void)
             break;
             }
         }
+        endPhase(PHASE_RENDER);
 
+        if (phaseTimingEnabled)
+        {
+            drawProfilerOverlay(screenWidth - 420, 10);
+        }
+        if (memoryOverlayEnabled)
+        {
+            drawMemoryOverlay(10, 120);
+        }
+
+        // Flush the batch here so its cost is split from the swap in EndDrawing()
+        beginPhase(PHASE_FLUSH);
+        rlDrawRenderBatchActive();
+        endPhase(PHASE_FLUSH);
+
+        beginPhase(PHASE_PRESENT);
         EndDrawing();
+        endPhase(PHASE_PRESENT);
+        endProfilerFrame();
+
+        // GetFrameTime() now holds the frame just drawn, waiting for the frame cap included
+        if (currentScreen == GAMEPLAY)
+        {
+            addSoakFrame(&soak, GetFrameTime());
+            writeSoakRow(&soak, ++soakFrames, currentScore, deaths, bullets, enemies, getGameBytes(bullets, enemies, grid, flow, flock));
+        }
     }
 
 EXIT:
+    // A session cut short by closing the window is still saved
+    if (replay.recording)
+    {
+        finishReplayRecording(&replay, checksumGame(player, bullets, enemies), recordFile);
+    }
+    unloadReplay(&replay);
+    closeSoakLog(&soak);
+    if (net)
+    {
+        TraceLog(LOG_INFO, "NET: %d rollbacks, %d ticks simulated again, worst %.3f ms, %d stalls, %d desyncs",
+                 session.stats.rollbacks, session.stats.resimulatedTicks, session.stats.maxRollbackSeconds * 1000.0,
+                 session.stats.stalls, session.stats.desyncs);
+        closeNetSession(&session);
+    }
+
     // CLEAN UP
-    cleanupEntities(bullets, enemies, player);
+    MemFree(partner);
+    cleanupEntities(bullets, enemies, grid, flow, flock, player);
+    shutdownJobSystem();
+    unloadLevels(&levelTable);
+    unloadPatterns(&patternTable);
+    unloadParticles(&particles);
     unloadResources();
     CloseAudioDevice();
     CloseWindow();
+    reportMemory();
     return 0;
 }
+#endif
 
 //----------------------------------------------------------------------------------
 // Renders the ending screen
 void renderEnding()
 {
-    DrawTexture(floorTexture, 0, 0, RAYWHITE);
+    drawAtlasSprite(floorSprite, (Rectangle){0, 0, screenWidth, screenHeight}, Vector2Zero(), 0.0, RAYWHITE);
     DrawText(TextFormat("Game Over\n\n\n\nScore: %d", currentScore), screenWidth / 2 - 100, screenHeight / 2, 40, BLACK);
     DrawText(TextFormat("Try again? Y/N"), screenWidth / 2 - 100, screenHeight / 2 - 150, 40, BLACK);
 }
@@ -318,27 +740,50 @@ void renderLogo()
 /**
  * @brief Renders 1 frame of gameplay to the screen.
  *
- * @param player
+ * @param player The local player, who faces the mouse
+ * @param partner The other player of a co-op session, or NULL
  * @param bullets
  * @param enemies
  * @param powerup
  * @param frame
+ * @param alpha How far the current frame is between the last tick and the next one
  */
-void renderScreen(Entity *player, Entity **bullets, Entity **enemies, PowerUp *powerup, int frame)
+void renderScreen(Entity *player, Entity *partner, EntityPool *bullets, EntityPool *enemies, PowerUp *powerup, long long frame, float alpha)
 {
     if (player == NULL || bullets == NULL || enemies == NULL || powerup == NULL)
     {
         TraceLog(LOG_ERROR, "One of the entities is NULL");
         return;
     }
-    DrawTexture(floorTexture, 0, 0, RAYWHITE);
 
-    renderPlayer(player);
+    // The camera follows the players, so it moves as smoothly as they do. The floor has
+    // to catch up before the camera is set, since drawing a chunk resets it
+    Vector2 focus = getSessionFocus(player, partner, alpha);
+    Rectangle view = getWorldView(focus);
+    worldCamera = getWorldCamera(focus);
+    streamFloor(&worldFloor, view);
+
+    BeginMode2D(worldCamera);
+    drawFloor(&worldFloor, view);
+    drawLevelObstacles(&levelTable);
+
+    // The swarm goes through the sprite queue, which skips whatever is off screen and
+    // draws by layer whatever order it was queued in
+    beginSpriteQueue(view);
     renderBullets(bullets);
-    renderEnemies(enemies);
+    renderEnemies(enemies, alpha);
+    renderParticles(&particles);
+    drawSpriteQueue(alpha);
+
     renderPowerup(powerup);
+    if (partner != NULL)
+    {
+        renderPlayer(partner, Vector2Add(createVector2(partner->body.x, partner->body.y), partner->direction), SKYBLUE, alpha);
+    }
+    renderPlayer(player, mousePos, WHITE, alpha);
 
-    DrawTextureEx(crosshairTexture, mousePos, 0.0, 3.0, WHITE);
+    drawAtlasSpriteEx(crosshairSprite, mousePos, 3.0, WHITE);
+    EndMode2D();
 }
 
 //----------------------------------------------------------------------------------
@@ -360,29 +805,30 @@ void loadResources()
     introSong = LoadMusicStream("resources/intro.wav");
 
     // IMAGES
-    floorBackground = LoadImage("resources/ground.png");
-    healthTic = LoadImage("resources/health_tic.png");
-
-    ImageResize(&floorBackground, screenWidth, screenHeight);
-
-    floorTexture = LoadTextureFromImage(floorBackground);
-    healthTexture = LoadTextureFromImage(healthTic);
+    // Every sprite lives in one atlas texture, so gameplay draws never switch textures
+    loadAtlas("resources");
 
-    crosshairImage = LoadImage("resources/crosshair.png");
-    crosshairTexture = LoadTextureFromImage(crosshairImage);
-
-    zombieSprite = LoadTexture("resources/zombie.png");
-    playerSprite = LoadTexture("resources/player.png");
+    floorSprite = getAtlasRegion("ground");
+    healthSprite = getAtlasRegion("health_tic");
+    crosshairSprite = getAtlasRegion("crosshair");
+    zombieSprite = getAtlasRegion("zombie");
+    playerSprite = getAtlasRegion("player");
+    whiteSprite = getAtlasRegion(ATLAS_WHITE);
 
     for (int i = 0; i < 6; i++)
     {
-        powerupSprites[i] = LoadTexture(TextFormat("resources/powerup%d.png", i));
+        powerupSprites[i] = getAtlasRegion(TextFormat("powerup%d", i));
     }
 
+    // SHADERS
+    initSpriteBatch();
+
+    // The floor is drawn into chunks as the camera gets near them
+    initFloor(&worldFloor);
 }
 
 // Updates the logo screen
-void updateLogo(int *frame, GameScreen *currentScreen)
+void updateLogo(long long *frame, GameScreen *currentScreen)
 {
     UpdateMusicStream(introSong);
     (*frame)++;
@@ -392,6 +838,179 @@ void updateLogo(int *frame, GameScreen *currentScreen)
     }
 }
 
+/**
+ * @brief Advances single player gameplay by one fixed tick. Every interval and speed in
+ * the game is counted in ticks, so this runs at the same rate whatever the frame rate is.
+ *
+ * @param player
+ * @param bullets
+ * @param enemies
+ * @param grid
+ * @param powerup
+ * @param input The player's input. The fire flag is cleared once the shot is fired
+ * @param frame The number of ticks simulated so far
+ * @param previousScore
+ * @param currentScreen
+ */
+void updateGameplay(Entity *player, EntityPool *bullets, EntityPool *enemies, SpatialGrid *grid, FlowField *flow, Flock *flock, PowerUp *powerup,
+                    PlayerInput *input, long long *frame, int *previousScore, GameScreen *currentScreen)
+{
+    GameTick tick = {
+        .player = player,
+        .bullets = bullets,
+        .enemies = enemies,
+        .grid = grid,
+        .flow = flow,
+        .flock = flock,
+        .powerup = powerup,
+        .input = input,
+        .frame = frame,
+        .previousScore = previousScore,
+        .currentScreen = currentScreen,
+    };
+    runTick(&tick);
+}
+
+// Runs the systems of gameSystems over tick, each timed under its own phase
+void runTick(GameTick *tick)
+{
+    for (int i = 0; i < GAME_SYSTEM_COUNT; i++)
+    {
+        beginPhase(gameSystems[i].phase);
+        gameSystems[i].run(tick);
+        endPhase(gameSystems[i].phase);
+    }
+
+    (*tick->frame)++;
+}
+
+// Moves the players, then finds the part of the world on screen around them
+void movePlayerSystem(GameTick *tick)
+{
+    playerMovementInput(tick->player, tick->input);
+    if (tick->partner != NULL)
+    {
+        playerMovementInput(tick->partner, tick->partnerInput);
+        leashPlayers(tick->player, tick->partner);
+
+        // Where each player aims, for drawing the other one
+        tick->player->direction = Vector2Subtract(tick->input->aim, createVector2(tick->player->body.x, tick->player->body.y));
+        tick->partner->direction = Vector2Subtract(tick->partnerInput->aim, createVector2(tick->partner->body.x, tick->partner->body.y));
+    }
+
+    // Update the players vector
+    playerV = createVector2(tick->player->body.x, tick->player->body.y);
+    tick->view = getWorldView(getSessionFocus(tick->player, tick->partner, 1.0f));
+}
+
+// Fires the player's shot, spawns the enemies the level calls for and shuffles the power-up
+void spawnSystem(GameTick *tick)
+{
+    Vector2 origins[2] = { playerV, playerV };
+    if (tick->partner != NULL)
+    {
+        origins[1] = createVector2(tick->partner->body.x, tick->partner->body.y);
+    }
+    if (tick->input->fire)
+    {
+        fireWeapon(tick->player, 0, origins[0], tick->input->aim, tick->bullets, tick->enemies);
+        tick->input->fire = false;
+    }
+    if (tick->partner != NULL && tick->partnerInput->fire)
+    {
+        fireWeapon(tick->partner, 1, origins[1], tick->partnerInput->aim, tick->bullets, tick->enemies);
+        tick->partnerInput->fire = false;
+    }
+    runPatterns(&patternRunners, &patternTable, tick->bullets, origins);
+
+    if (currentScore != *tick->previousScore)
+    { // The score sets the level, which sets the enemy cap, spawn pace and mix
+        int level = getLevelIndex(&levelTable, currentScore);
+        if (level != getLevelIndex(&levelTable, *tick->previousScore))
+        {
+            TraceLog(LOG_INFO, "SWARM: Level %d reached at score %d", level + 1, currentScore);
+        }
+        *tick->previousScore = currentScore;
+    }
+    spawnEnemies(tick->enemies, playerV, tick->view, &levelTable, currentScore, *tick->frame);
+
+    if ((*tick->frame % POWERUP_SPAWN_INTERVAL == 0) && *tick->frame > 0)
+    {
+        // If the powerup is still on screen and has not been grabbed, shuffle its
+        // effect and position. If it was grabbed, it comes back
+        tick->powerup->isActive = true;
+        createPowerup(tick->powerup, tick->view);
+    }
+}
+
+// Moves the bullets along their direction
+void moveBulletsSystem(GameTick *tick)
+{
+    updateBullets(tick->bullets, tick->enemies);
+}
+
+// The flow field catches up with the player a bounded slice at a time. With no obstacles
+// enemies chase the player directly and never read it, so it isn't kept up to date. The
+// first obstacle queues a pass, see setFlowObstacle()
+void flowFieldSystem(GameTick *tick)
+{
+    if (tick->flow->blockedCount == 0)
+    {
+        return;
+    }
+    setFlowGoal(tick->flow, playerV);
+    stepFlowField(tick->flow, FLOW_STEPS_PER_TICK);
+}
+
+// Enemies make room for their neighbours as they move
+void flockingSystem(GameTick *tick)
+{
+    computeFlocking(tick->flock, tick->enemies);
+}
+
+// Moves the enemies towards the nearest player, around obstacles and apart from each other
+void moveEnemiesSystem(GameTick *tick)
+{
+    if (tick->partner != NULL)
+    {
+        Vector2 partnerV = createVector2(tick->partner->body.x, tick->partner->body.y);
+        updateEnemies(tick->enemies, playerV, &partnerV, tick->flow, tick->flock);
+    }
+    else
+    {
+        updateEnemies(tick->enemies, playerV, NULL, tick->flow, tick->flock);
+    }
+}
+
+// Tests the paths moved this tick for hits, and ends the game once a player is out of health
+void collisionSystem(GameTick *tick)
+{
+    tick->player->health -= checkCollisions(tick->enemies, tick->bullets, tick->grid, tick->player, tick->powerup, &currentScore);
+    if (tick->partner != NULL)
+    {
+        tick->partner->health -= checkPartnerCollisions(tick->enemies, tick->partner, tick->powerup, &currentScore);
+    }
+
+    if (tick->player->health == 0 || (tick->partner != NULL && tick->partner->health == 0))
+    {
+        *tick->currentScreen = ENDING;
+    }
+}
+
+// Removes the bullets that left the screen
+void bulletBoundsSystem(GameTick *tick)
+{
+    checkBulletCollisions(tick->bullets, tick->view);
+}
+
+// Advances the cosmetic particles. They live in the one global store every emitter in the
+// game writes to, shared by both sessions of a co-op test, so there is none on the tick
+void particlesSystem(GameTick *tick)
+{
+    (void)tick;
+    updateParticles(&particles);
+}
+
 /**
  * @brief Unloads all resources
  *
@@ -405,10 +1024,11 @@ void unloadResources()
     UnloadMusicStream(introSong);
 
     // IMAGES
-    UnloadImage(floorBackground);
-    UnloadImage(healthTic);
-    UnloadTexture(floorTexture);
-    UnloadTexture(healthTexture);
+    unloadAtlas();
+
+    // SHADERS
+    unloadSpriteBatch();
+    unloadFloor(&worldFloor);
 }
 
 /**
@@ -427,26 +1047,30 @@ Entity *initPlayer()
 
     player->body.height = PLAYER_HEIGHT;
     player->body.width = PLAYER_WIDTH;
-    player->body.x = screenWidth / 2;
-    player->body.y = screenHeight / 2;
+    player->body.x = worldWidth / 2;
+    player->body.y = worldHeight / 2;
+    player->previous = (Vector2){player->body.x, player->body.y};
 
     player->health = PLAYER_HEALTH;
     player->speed = PLAYER_SPEED;
     player->sprite = playerSprite;
+    player->weapon = startingWeapon;
 
     return player;
 }
 
-// Common code to create a powerup
-void createPowerup(PowerUp *powerup)
+// Common code to create a powerup somewhere in area, usually the view around the player
+void createPowerup(PowerUp *powerup, Rectangle area)
 {
     powerup->isActive = true;
     changeRandomEffect(powerup);
+    powerup->position.x = area.x + randomInt(RANDOM_POWERUP, 50, area.width - 50);
+    powerup->position.y = area.y + randomInt(RANDOM_POWERUP, 50, area.height - 50);
 }
 
 void changeRandomEffect(PowerUp* powerup)
 {
-    switch (GetRandomValue(MAXBULLETUP, HEALTHUP))
+    switch (randomInt(RANDOM_POWERUP, MAXBULLETUP, HEALTHUP))
     {
     case MAXBULLETUP:
         powerup->color = BLUE;
@@ -481,100 +1105,175 @@ void changeRandomEffect(PowerUp* powerup)
         TraceLog(LOG_INFO, "This shouldn't happen!");
         break;
     }
-    powerup->position.x = GetRandomValue(50, screenWidth - 50);
-    powerup->position.y = GetRandomValue(50, screenHeight - 50);
+}
 
+// Reads the keyboard and mouse into input. A click stays queued until a tick fires it,
+// since a fast frame may not run any tick at all
+void readPlayerInput(PlayerInput *input)
+{
+    input->up = IsKeyDown(KEY_W);
+    input->down = IsKeyDown(KEY_S);
+    input->left = IsKeyDown(KEY_A);
+    input->right = IsKeyDown(KEY_D);
+    input->aim = mousePos;
+    if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+    {
+        input->fire = true;
+    }
 }
 
 // Updates the player's position based on input
-void playerMovementInput(Entity *player)
+void playerMovementInput(Entity *player, PlayerInput *input)
 {
-    if (IsKeyDown(KEY_D) && player->body.x < screenWidth - player->body.width)
+    player->previous = (Vector2){player->body.x, player->body.y};
+
+    if (input->right && player->body.x < worldWidth - player->body.width)
         player->body.x += player->speed;
-    if (IsKeyDown(KEY_A) && player->body.x > 0)
+    if (input->left && player->body.x > 0)
         player->body.x -= player->speed;
-    if (IsKeyDown(KEY_W) && player->body.y > 0)
+    if (input->up && player->body.y > 0)
         player->body.y -= player->speed;
-    if (IsKeyDown(KEY_S) && player->body.y < screenHeight - player->body.height)
+    if (input->down && player->body.y < worldHeight - player->body.height)
         player->body.y += player->speed;
 }
 
+// Undoes the moves that took the players too far apart to share the screen
+void leashPlayers(Entity *player, Entity *partner)
+{
+    if (fabsf(player->body.x - partner->body.x) > screenWidth - 2 * PLAYER_WIDTH)
+    {
+        player->body.x = player->previous.x;
+        partner->body.x = partner->previous.x;
+    }
+    if (fabsf(player->body.y - partner->body.y) > screenHeight - 2 * PLAYER_HEIGHT)
+    {
+        player->body.y = player->previous.y;
+        partner->body.y = partner->previous.y;
+    }
+}
+
 /**
  * @brief Renders the player to the screen
  *
  * @param player
+ * @param aim Where the player faces
+ * @param tint WHITE, or a colour to tell the other player apart
+ * @param alpha How far the current frame is between the last tick and the next one
  */
-void renderPlayer(Entity *player)
+void renderPlayer(Entity *player, Vector2 aim, Color tint, float alpha)
 {
     Vector2 playerV;
     Vector2 rotationCenter;
 
-    playerV = createVector2(player->body.x, player->body.y);
-    rotationCenter = (Vector2){player->body.x + player->body.width, player->body.y + player->body.height};
+    playerV = Vector2Lerp(player->previous, createVector2(player->body.x, player->body.y), alpha);
+    rotationCenter = (Vector2){playerV.x + player->body.width, playerV.y + player->body.height};
 
     // DrawRectangleRec(player->body, (Color){155, 0, 0, 155});
 
-    DrawTexturePro(player->sprite,
-                   (Rectangle){0, 0, playerSprite.width, playerSprite.height},
-                   (Rectangle){rotationCenter.x - player->sprite.width / 2, rotationCenter.y - player->sprite.height / 2, playerSprite.width, playerSprite.height},
-                   (Vector2){playerSprite.width / 2, playerSprite.height / 2},
-                   calculateAngle(playerV, mousePos),
-                   WHITE);
+    drawAtlasSprite(player->sprite,
+                    (Rectangle){rotationCenter.x - player->sprite.width / 2, rotationCenter.y - player->sprite.height / 2, player->sprite.width, player->sprite.height},
+                    (Vector2){player->sprite.width / 2, player->sprite.height / 2},
+                    calculateAngle(playerV, aim),
+                    tint);
+}
+
+/**
+ * @brief Finds the point the camera follows, the middle of the player's sprite.
+ *
+ * @param player
+ * @param alpha How far between the last tick and the next one. 1 gives the point as of
+ * the last tick, which is what the simulation uses
+ * @return Vector2
+ */
+Vector2 getPlayerFocus(Entity *player, float alpha)
+{
+    // renderPlayer() centres the sprite on the body's bottom right corner
+    Vector2 position = Vector2Lerp(player->previous, createVector2(player->body.x, player->body.y), alpha);
+    return (Vector2){ position.x + player->body.width, position.y + player->body.height };
+}
+
+// The point the camera follows. Two players share the screen, so it is the middle of them
+Vector2 getSessionFocus(Entity *player, Entity *partner, float alpha)
+{
+    Vector2 focus = getPlayerFocus(player, alpha);
+    if (partner != NULL)
+    {
+        focus = Vector2Lerp(focus, getPlayerFocus(partner, alpha), 0.5f);
+    }
+    return focus;
 }
 
 // Renders the powerup to the screen
 void renderPowerup(PowerUp *powerup)
 {
-    if (powerup->isActive)
+    // The sprite hangs off the bottom right of position, the circle is centred on it
+    Rectangle bounds = {powerup->position.x - 15, powerup->position.y - 15,
+                        fmaxf(powerup->sprite.width * 3.0f, 15) + 15, fmaxf(powerup->sprite.height * 3.0f, 15) + 15};
+    if (powerup->isActive && CheckCollisionRecs(bounds, spriteQueue.view))
     {
         // TraceLog(LOG_INFO, "POWERUP RENDERED");
-        DrawTextureEx(powerup->sprite, powerup->position, 0.0, 3.0, WHITE);
+        drawAtlasSpriteEx(powerup->sprite, powerup->position, 3.0, WHITE);
         DrawCircle(powerup->position.x, powerup->position.y, 15, (Color){155, 0, 0, 155});
     }
 }
 
-// Renders the HUD to the screen
-void renderHUD(Entity *player, int frame, int currentScore)
+// Renders the HUD to the screen. The partner's health goes on the right, if there is one
+void renderHUD(Entity *player, Entity *partner, long long frame, int currentScore)
 {
     if (player == NULL)
     {
         TraceLog(LOG_ERROR, "Player is NULL");
         return;
     }
-    if (healthTexture.id < 0)
+    if (spriteAtlas.texture.id == 0)
     {
-        TraceLog(LOG_ERROR, "Health texture is NULL");
+        TraceLog(LOG_ERROR, "Sprite atlas is not loaded");
         return;
     }
 
     DrawText("HEALTH", 30, 40, 20, BLUE);
     for (int i = 0; i < player->health; i++)
     {
-        DrawTextureEx(healthTexture, (Vector2){i * 30, 50}, 0.0, 6.0, WHITE);
+        drawAtlasSpriteEx(healthSprite, (Vector2){i * 30, 50}, 6.0, WHITE);
+    }
+    if (partner != NULL)
+    {
+        DrawText("PARTNER", screenWidth - 230, 40, 20, SKYBLUE);
+        for (int i = 0; i < partner->health; i++)
+        {
+            drawAtlasSpriteEx(healthSprite, (Vector2){screenWidth - 230 + i * 30, 50}, 6.0, SKYBLUE);
+        }
     }
-    DrawText(TextFormat("Score: %d\tFrame: %d\tPlayer Speed: %.1f\t Max Bullets: %d",
+    DrawText(TextFormat("Score: %d\tFrame: %lld\tPlayer Speed: %.1f\t Max Bullets: %d",
                         currentScore, frame, player->speed, CURRENT_MAX_BULLETS),
              screenWidth / 2 - 100, screenHeight - 25, 15, BLUE);
+    if (player->weapon < patternTable.patternCount)
+    {
+        DrawText(TextFormat("Weapon: %s", patternTable.patterns[player->weapon].name), 30, 90, 20, BLUE);
+    }
 }
 
-// Resets the game to its initial state
-void resetGame(Entity *player, Entity **bullets, Entity **enemies, int *frame, int *prevScore)
+// Puts a player at x, y with its starting speed and health
+void resetPlayer(Entity *player, float x, float y)
 {
-    player->body.x = screenWidth / 2;
-    player->body.y = screenHeight / 2;
+    player->body.x = x;
+    player->body.y = y;
+    player->previous = (Vector2){player->body.x, player->body.y};
+    player->direction = Vector2Zero();
     player->speed = PLAYER_SPEED;
     player->health = PLAYER_HEALTH;
+    player->weapon = startingWeapon;
+}
 
-    for (int i = 0; i < CURRENT_MAX_BULLETS; i++)
-    {
-        if (bullets[i] != NULL)
-        {
-            MemFree(bullets[i]);
-            bullets[i] = NULL;
-        }
-    }
+// Resets the game to its initial state
+void resetGame(Entity *player, EntityPool *bullets, EntityPool *enemies, long long *frame, int *prevScore)
+{
+    resetPlayer(player, worldWidth / 2, worldHeight / 2);
 
+    clearPool(bullets);
     clearEnemies(enemies);
+    clearParticles(&particles);
+    clearPatternRunners(&patternRunners);
 
     CURRENT_MAX_BULLETS = 1;
     CURRENT_MAX_ENEMIES = 1;
@@ -583,97 +1282,775 @@ void resetGame(Entity *player, Entity **bullets, Entity **enemies, int *frame, i
     *frame = 0;
 }
 
+/**
+ * @brief Seeds the random streams and puts the game in the state every session starts
+ * from. A session then only depends on its seed and inputs, which is what lets a replay
+ * reproduce it.
+ *
+ * @param player
+ * @param partner The second player of a co-op session, or NULL. The two start side by side
+ * @param bullets
+ * @param enemies
+ * @param flow
+ * @param powerup
+ * @param frame
+ * @param previousScore
+ * @param seed
+ */
+void startSession(Entity *player, Entity *partner, EntityPool *bullets, EntityPool *enemies, FlowField *flow, PowerUp *powerup,
+                  long long *frame, int *previousScore, uint64_t seed)
+{
+    seedRandom(seed);
+    resetGame(player, bullets, enemies, frame, previousScore);
+    if (partner != NULL)
+    {
+        resetPlayer(player, worldWidth / 2 - PLAYER_WIDTH, worldHeight / 2);
+        resetPlayer(partner, worldWidth / 2 + PLAYER_WIDTH, worldHeight / 2);
+    }
+    resetFlowField(flow);
+    applyLevelObstacles(&levelTable, flow);
+    createPowerup(powerup, getWorldView(getSessionFocus(player, partner, 1.0f)));
+}
+
 // Checks for collisions between the player, enemies, bullets, and powerups
-int checkCollisions(Entity **enemies, Entity **bullets, Entity *player, PowerUp *powerup, int *score)
+int checkCollisions(EntityPool *enemies, EntityPool *bullets, SpatialGrid *grid, Entity *player, PowerUp *powerup, int *score)
 {
+    if (!queryPool(enemies, COMPONENT_POSITION | COMPONENT_SIZE | COMPONENT_HEALTH, "checkCollisions") ||
+        !queryPool(bullets, COMPONENT_POSITION | COMPONENT_PREVIOUS | COMPONENT_DIRECTION | COMPONENT_SIZE, "checkCollisions"))
+    {
+        return 0;
+    }
+
     // Check for powerups first, they may possibly change the state of enemies
 
     if (powerup->isActive && CheckCollisionCircleRec(powerup->position, 15, player->body))
     {
-        switch (powerup->effect)
+        applyPowerup(powerup, player, enemies, score);
+    }
+
+    // Broadphase: bin the enemies, then only test each bullet against enemies in
+    // the cells it overlaps
+    buildGrid(grid, enemies);
+    grid->stats.candidatePairs = 0;
+    grid->stats.hits = 0;
+
+    // Bullets swap their last entity into a despawned slot, so walk them backwards.
+    // Enemies are only flagged here since the grid refers to them by index.
+    for (int j = bullets->count - 1; j >= 0; j--)
+    {
+        // Test the whole path the bullet covered this tick, and hit whatever it reached first
+        int candidates = queryGrid(grid, getSweptBody(bullets, j));
+        int hit = -1;
+        float hitTime = 0.0f;
+        for (int k = 0; k < candidates; k++)
         {
-        case ENEMYWIPE:
-            clearEnemies(enemies);
-            break;
-        case INCREASESPEED:
-            player->speed += 0.5;
-            break;
-        case PLUS10SCORE:
-            *score += 10;
-            break;
-        case PLUS50SCORE:
-            *score += 50;
-            break;
-        case MAXBULLETUP:
-            CURRENT_MAX_BULLETS++;
-            break;
-        case HEALTHUP:
-            player->health++;
-            break;
-        default:
-            break;
+            int enemy = grid->results[k];
+            if (enemies->health[enemy] <= 0)
+            {
+                continue;
+            }
+
+            grid->stats.candidatePairs++;
+            float time;
+            if (sweepBullet(bullets, j, getEntityBody(enemies, enemy), &time) && (hit < 0 || time < hitTime))
+            {
+                hit = enemy;
+                hitTime = time;
+            }
+        }
+
+        if (hit >= 0)
+        {
+            // Sparks fly back the way the bullet came, from where it struck
+            Vector2 impact = {
+                Lerp(bullets->previousX[j], bullets->x[j], hitTime) + bullets->width[j] / 2,
+                Lerp(bullets->previousY[j], bullets->y[j], hitTime) + bullets->height[j] / 2,
+            };
+            emitParticles(&particles, &impactSparks, impact, (Vector2){ -bullets->directionX[j], -bullets->directionY[j] });
+
+            grid->stats.hits++;
+            despawnEntity(bullets, j);
+            if (!resimulating)
+            {
+                PlaySound(impactFx);
+            }
+            if (--enemies->health[hit] == 0)
+            {
+                Rectangle body = getEntityBody(enemies, hit);
+                emitParticles(&particles, &enemyDeath, (Vector2){ body.x + body.width / 2, body.y + body.height / 2 }, Vector2Zero());
+                *score += 1;
+            }
         }
-        powerup->isActive = false;
     }
 
-    for (int i = 0; i < CURRENT_MAX_ENEMIES; i++)
+    int hitsTaken = 0;
+    for (int i = enemies->count - 1; i >= 0; i--)
     {
-        for (int j = 0; j < CURRENT_MAX_BULLETS; j++)
+        if (enemies->health[i] <= 0)
         {
-            if (enemies[i] != NULL && bullets[j] != NULL)
-                if (CheckCollisionRecs(enemies[i]->body, bullets[j]->body))
-                {
-                    MemFree(bullets[j]);
-                    MemFree(enemies[i]);
-                    enemies[i] = NULL;
-                    bullets[j] = NULL;
-                    PlaySound(impactFx);
-                    *score += 1;
-                }
+            despawnEntity(enemies, i);
         }
-
-        if (enemies[i] != NULL && CheckCollisionRecs(enemies[i]->body, player->body))
+        else if (hitsTaken == 0 && CheckCollisionRecs(getEntityBody(enemies, i), player->body))
         { // The enemy collided with the player. Triggering a hit point loss and a sound effect. The enemy is then removed.
-            MemFree(enemies[i]);
-            enemies[i] = NULL;
-            PlaySound(impactFx);
+            despawnEntity(enemies, i);
+            if (!resimulating)
+            {
+                PlaySound(impactFx);
+            }
+            emitParticles(&particles, &playerHit,
+                          (Vector2){ player->body.x + player->body.width / 2, player->body.y + player->body.height / 2 }, Vector2Zero());
+            hitsTaken = 1;
+        }
+    }
+    return hitsTaken;
+}
+
+// Gives the effect of the power-up to the player who grabbed it
+void applyPowerup(PowerUp *powerup, Entity *player, EntityPool *enemies, int *score)
+{
+    switch (powerup->effect)
+    {
+    case ENEMYWIPE:
+        clearEnemies(enemies);
+        break;
+    case INCREASESPEED:
+        player->speed += 0.5;
+        break;
+    case PLUS10SCORE:
+        *score += 10;
+        break;
+    case PLUS50SCORE:
+        *score += 50;
+        break;
+    case MAXBULLETUP:
+        if (CURRENT_MAX_BULLETS < BULLET_CAP_LIMIT)
+        {
+            CURRENT_MAX_BULLETS++;
+        }
+        if (player->weapon + 1 < patternTable.patternCount)
+        {
+            player->weapon++;
+        }
+        break;
+    case HEALTHUP:
+        player->health++;
+        break;
+    default:
+        break;
+    }
+    powerup->isActive = false;
+}
+
+// Fires the shooter's weapon. Without patterns loaded that is the one bullet at the aim
+void fireWeapon(Entity *shooter, int index, Vector2 origin, Vector2 aim, EntityPool *bullets, EntityPool *enemies)
+{
+    if (patternTable.patternCount == 0)
+    {
+        createBullet(bullets, origin, aim);
+        return;
+    }
+
+    int weapon = (shooter->weapon < patternTable.patternCount)? shooter->weapon : patternTable.patternCount - 1;
+    firePattern(&patternRunners, &patternTable, weapon, index, origin, aim, enemies);
+}
+
+/**
+ * @brief Loads the bullet patterns players fire and picks the one they start with.
+ *
+ * @param fileName Patterns file, NULL to fire the one bullet
+ * @param weaponName Pattern to start with, NULL for the first one
+ * @return true if the file loaded and has the named pattern
+ */
+bool loadWeapons(const char *fileName, const char *weaponName)
+{
+    if (fileName == NULL)
+    {
+        return true;
+    }
+    if (!loadPatterns(&patternTable, fileName))
+    {
+        return false;
+    }
+
+    startingWeapon = (weaponName != NULL)? findPattern(&patternTable, weaponName) : 0;
+    if (startingWeapon < 0)
+    {
+        TraceLog(LOG_ERROR, "%s has no pattern called %s", fileName, weaponName);
+        startingWeapon = 0;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief The part of checkCollisions() that is about the player, for the partner. Runs
+ * after it, so the power-up goes to the first player when both reach it on the same
+ * tick, and enemies shot this tick are already gone.
+ *
+ * @param enemies
+ * @param partner
+ * @param powerup
+ * @param score
+ * @return int The hits the partner took, at most one per tick
+ */
+int checkPartnerCollisions(EntityPool *enemies, Entity *partner, PowerUp *powerup, int *score)
+{
+    if (powerup->isActive && CheckCollisionCircleRec(powerup->position, 15, partner->body))
+    {
+        applyPowerup(powerup, partner, enemies, score);
+    }
+
+    for (int i = enemies->count - 1; i >= 0; i--)
+    {
+        if (CheckCollisionRecs(getEntityBody(enemies, i), partner->body))
+        {
+            despawnEntity(enemies, i);
+            if (!resimulating)
+            {
+                PlaySound(impactFx);
+            }
+            emitParticles(&particles, &playerHit,
+                          (Vector2){ partner->body.x + partner->body.width / 2, partner->body.y + partner->body.height / 2 }, Vector2Zero());
             return 1;
         }
     }
     return 0;
 }
 
-void initEntities(Entity **entities)
+// Frees all the memory allocated for the entities
+void cleanupEntities(EntityPool *bullets, EntityPool *enemies, SpatialGrid *grid, FlowField *flow, Flock *flock, Entity *player)
+{
+    unloadPool(bullets);
+    unloadPool(enemies);
+    unloadGrid(grid);
+    unloadFlowField(flow);
+    unloadFlock(flock);
+    MemFree(player);
+}
+
+// Bytes held by the game's pools, grid, flow field, flock and particles
+size_t getGameBytes(EntityPool *bullets, EntityPool *enemies, SpatialGrid *grid, FlowField *flow, Flock *flock)
+{
+    return getPoolBytes(bullets) + getPoolBytes(enemies) + getGridBytes(grid) + getFlowFieldBytes(flow) +
+           getFlockBytes(flock) + getParticleBytes(&particles);
+}
+
+void stopRun(int number)
+{
+    (void)number;
+    runStopped = 1;
+}
+
+/**
+ * @brief Runs the simulation without a window, audio or rendering and prints how fast
+ * it went. The player wanders and shoots at random, or the bot plays it, and is revived
+ * in place whenever it dies, so the swarm keeps building up for the requested number
+ * of ticks.
+ *
+ * @param ticks The number of ticks to simulate, 0 to run until Ctrl+C
+ * @param maxEnemies The enemy cap for the session
+ * @param maxBullets The bullet cap for the session
+ * @param bot Let the bot play instead of the random input
+ * @param soak Gets a row every interval of ticks if it is open
+ * @return int The process exit code
+ */
+int runHeadless(int ticks, int maxEnemies, int maxBullets, bool bot, SoakLog *soak)
+{
+    MAX_ENEMIES = maxEnemies;
+    MAX_BULLETS = maxBullets;
+
+    long long frame = 0;
+    int previousScore = 0;
+    int deaths = 0;
+    double liveEnemies = 0.0;
+    double liveBullets = 0.0;
+    double blockedEnemies = 0.0;
+    GameScreen currentScreen = GAMEPLAY;
+    PlayerInput input = {0};
+    Bot player1 = {0};
+    initBot(&player1);
+
+    Entity *player = initPlayer();
+    EntityPool *bullets = initBullets();
+    EntityPool *enemies = initEnemies();
+    SpatialGrid *grid = initGrid(worldWidth, worldHeight, GRID_CELL_SIZE, MAX_ENEMIES, ENEMY_SIZE);
+    FlowField *flow = initFlowField(worldWidth, worldHeight, FLOW_CELL_SIZE);
+    Flock *flock = initFlock(worldWidth, worldHeight, MAX_ENEMIES);
+    if (player == NULL || bullets == NULL || enemies == NULL || grid == NULL || flow == NULL || flock == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error initializing the headless session");
+        cleanupEntities(bullets, enemies, grid, flow, flock, player);
+        return 1;
+    }
+    PowerUp powerup;
+    createPowerup(&powerup, getWorldView(getPlayerFocus(player, 1.0f)));
+    applyLevelObstacles(&levelTable, flow);
+
+    CURRENT_MAX_ENEMIES = ENEMY_CAP_LIMIT = MAX_ENEMIES;
+    CURRENT_MAX_BULLETS = BULLET_CAP_LIMIT = MAX_BULLETS;
+
+    resetPhaseTimings();
+    phaseTimingEnabled = true;
+    runStopped = 0;
+    signal(SIGINT, stopRun);
+    double start = getTimerSeconds();
+
+    long long t = 0;
+    for (; (ticks == 0 || t < ticks) && !runStopped; t++)
+    {
+        double tickStart = getTimerSeconds();
+        beginMemoryFrame();
+        if (bot)
+        {
+            updateBot(&player1, &input, player, enemies, &powerup);
+        }
+        // Pick a new heading every half second and fire every few ticks
+        else if (t % 30 == 0)
+        {
+            input.up = randomInt(RANDOM_INPUT, 0, 1);
+            input.down = !input.up && randomInt(RANDOM_INPUT, 0, 1);
+            input.left = randomInt(RANDOM_INPUT, 0, 1);
+            input.right = !input.left && randomInt(RANDOM_INPUT, 0, 1);
+        }
+        if (!bot && t % 4 == 0)
+        {
+            input.fire = true;
+            Rectangle view = getWorldView(getPlayerFocus(player, 1.0f));
+            input.aim = createVector2(view.x + randomInt(RANDOM_INPUT, 0, screenWidth), view.y + randomInt(RANDOM_INPUT, 0, screenHeight));
+        }
+
+        updateGameplay(player, bullets, enemies, grid, flow, flock, &powerup, &input, &frame, &previousScore, &currentScreen);
+        liveEnemies += enemies->count;
+        liveBullets += bullets->count;
+        if (flow->blockedCount > 0)
+        { // Enemies routed around the obstacles shouldn't end up inside them
+            blockedEnemies += countBlockedEntities(flow, enemies);
+        }
+
+        if (currentScreen == ENDING)
+        {
+            player->health = PLAYER_HEALTH;
+            currentScreen = GAMEPLAY;
+            deaths++;
+        }
+
+        addSoakFrame(soak, getTimerSeconds() - tickStart);
+        writeSoakRow(soak, t + 1, currentScore, deaths, bullets, enemies, getGameBytes(bullets, enemies, grid, flow, flock));
+    }
+    signal(SIGINT, SIG_DFL);
+    double ran = (t > 0)? t : 1;
+
+    double elapsed = getTimerSeconds() - start;
+    phaseTimingEnabled = false;
+
+    printf("seed: %llu\nthreads: %d\ninput: %s\nticks: %lld\nenemy pool: %d\n",
+           (unsigned long long)randomSeed, jobSystem.threadCount, bot? "bot" : "random", t, maxEnemies);
+    // Levels lower the cap below the pool as the score goes up
+    if (levelTable.levelCount > 0)
+    {
+        printf("enemy cap: %d, level %d at the end\n", CURRENT_MAX_ENEMIES, getLevelIndex(&levelTable, currentScore) + 1);
+    }
+    else
+    {
+        printf("enemy cap: %d\n", CURRENT_MAX_ENEMIES);
+    }
+    printf("bullet cap: %d\n", maxBullets);
+    if (flow->blockedCount > 0)
+    {
+        printf("obstacles: %d, %d cells\navg enemies inside obstacles: %.2f\n",
+               levelTable.obstacleCount, flow->blockedCount, blockedEnemies / ran);
+    }
+    printf("avg live enemies: %.1f\navg live bullets: %.1f\ndeaths: %d\n",
+           liveEnemies / ran, liveBullets / ran, deaths);
+    printf("score: %d\nchecksum: %08x\n", currentScore, checksumGame(player, bullets, enemies));
+    printf("elapsed: %.3f s\nticks/sec: %.0f\n", elapsed, ran / elapsed);
+    for (int i = 0; i < TICK_PHASE_COUNT; i++)
+    {
+        printf("%-22s %10.3f ms total %10.3f us/tick\n",
+               phaseNames[i], phaseSeconds[i] * 1000.0, phaseSeconds[i] * 1e6 / ran);
+    }
+
+    cleanupEntities(bullets, enemies, grid, flow, flock, player);
+    return 0;
+}
+
+/**
+ * @brief Plays a replay without a window, as fast as possible, and prints the same
+ * report as runHeadless(). The checksum is compared with the recorded one, so a replay
+ * doubles as a regression test.
+ *
+ * @param fileName The replay, saved with --record
+ * @param timingsFile If not NULL, one CSV row of phase timings per tick is written here
+ * @return int The process exit code, 1 if the replay couldn't be loaded or desynced
+ */
+int runReplay(const char *fileName, const char *timingsFile)
 {
-    for(int i = 0; i < MAX_ENEMIES; i++)
+    Replay replay = {0};
+    if (!loadReplay(&replay, fileName))
     {
-        entities[i] = NULL;
+        return 1;
     }
-    for(int i = MAX_BULLETS; i < MAX_BULLETS; i++)
+
+    long long frame = 0;
+    int previousScore = 0;
+    GameScreen currentScreen = GAMEPLAY;
+    PlayerInput input = {0};
+
+    Entity *player = initPlayer();
+    EntityPool *bullets = initBullets();
+    EntityPool *enemies = initEnemies();
+    SpatialGrid *grid = initGrid(worldWidth, worldHeight, GRID_CELL_SIZE, MAX_ENEMIES, ENEMY_SIZE);
+    FlowField *flow = initFlowField(worldWidth, worldHeight, FLOW_CELL_SIZE);
+    Flock *flock = initFlock(worldWidth, worldHeight, MAX_ENEMIES);
+    if (player == NULL || bullets == NULL || enemies == NULL || grid == NULL || flow == NULL || flock == NULL)
     {
-        entities[i] = NULL;
+        TraceLog(LOG_ERROR, "Error initializing the replay session");
+        unloadReplay(&replay);
+        cleanupEntities(bullets, enemies, grid, flow, flock, player);
+        return 1;
     }
+    PowerUp powerup;
+    startSession(player, NULL, bullets, enemies, flow, &powerup, &frame, &previousScore, replay.seed);
+
+    FILE *timings = NULL;
+    if (timingsFile != NULL)
+    {
+        timings = fopen(timingsFile, "w");
+        if (timings == NULL)
+        {
+            TraceLog(LOG_ERROR, "Error opening %s for the replay timings", timingsFile);
+        }
+        else
+        {
+            fprintf(timings, "tick");
+            for (int i = 0; i < TICK_PHASE_COUNT; i++)
+            {
+                fprintf(timings, ",%s", phaseNames[i]);
+            }
+            fprintf(timings, ",total\n");
+        }
+    }
+
+    // Phases are timed one tick at a time, so keep the session totals separately
+    double totals[TICK_PHASE_COUNT] = {0};
+    double worstTick = 0.0;
+    int worstTickIndex = 0;
+    int ticks = 0;
+    phaseTimingEnabled = true;
+    double start = getTimerSeconds();
+
+    while (currentScreen == GAMEPLAY && playReplayTick(&replay, &input))
+    {
+        resetPhaseTimings();
+        double tickStart = getTimerSeconds();
+        updateGameplay(player, bullets, enemies, grid, flow, flock, &powerup, &input, &frame, &previousScore, &currentScreen);
+        double tickSeconds = getTimerSeconds() - tickStart;
+
+        for (int i = 0; i < TICK_PHASE_COUNT; i++)
+        {
+            totals[i] += phaseSeconds[i];
+        }
+        if (tickSeconds > worstTick)
+        {
+            worstTick = tickSeconds;
+            worstTickIndex = ticks;
+        }
+        if (timings != NULL)
+        {
+            fprintf(timings, "%d", ticks);
+            for (int i = 0; i < TICK_PHASE_COUNT; i++)
+            {
+                fprintf(timings, ",%.4f", phaseSeconds[i] * 1000.0);
+            }
+            fprintf(timings, ",%.4f\n", tickSeconds * 1000.0);
+        }
+        ticks++;
+    }
+
+    double elapsed = getTimerSeconds() - start;
+    phaseTimingEnabled = false;
+    if (timings != NULL)
+    {
+        fclose(timings);
+    }
+
+    // The recording ended on the tick the player died, so an earlier death is a desync too
+    uint32_t checksum = checksumGame(player, bullets, enemies);
+    bool desynced = (ticks != replay.length) || (replay.hasChecksum && checksum != replay.checksum);
+
+    printf("replay: %s\nseed: %llu\nthreads: %d\nticks: %d of %d\n",
+           fileName, (unsigned long long)replay.seed, jobSystem.threadCount, ticks, replay.length);
+    printf("score: %d\nchecksum: %08x\n", currentScore, checksum);
+    if (replay.hasChecksum)
+    {
+        printf("recorded checksum: %08x%s\n", replay.checksum, desynced? " (DESYNC)" : "");
+    }
+    printf("elapsed: %.3f s\nticks/sec: %.0f\nworst tick: %.3f ms at tick %d\n",
+           elapsed, ticks / elapsed, worstTick * 1000.0, worstTickIndex);
+    for (int i = 0; i < TICK_PHASE_COUNT; i++)
+    {
+        printf("%-22s %10.3f ms total %10.3f us/tick\n",
+               phaseNames[i], totals[i] * 1000.0, (ticks > 0)? totals[i] * 1e6 / ticks : 0.0);
+    }
+
+    unloadReplay(&replay);
+    cleanupEntities(bullets, enemies, grid, flow, flock, player);
+    return desynced? 1 : 0;
 }
 
-// Frees all the memory allocated for the entities
-void cleanupEntities(Entity **bullets, Entity **enemies, Entity *player)
+/**
+ * @brief Plays a co-op session between two sessions in this process, over two sockets
+ * on 127.0.0.1 with the latency shim in both directions. Each peer plays scripted input
+ * and the clock is simulated, one tick per frame, so the test runs as fast as it can.
+ * The peers share the game's globals, so each one's state is loaded before it runs and
+ * saved after. Prints what rolling back cost and whether both ended on the same state.
+ *
+ * @param ticks Ticks both peers play
+ * @param maxEnemies The enemy cap for the session
+ * @param latencyMs Delay each way, with up to half as much jitter on top
+ * @param lossPercent Share of the packets dropped each way
+ * @return int The process exit code, 1 if the peers didn't end on the same state
+ */
+int runNetTest(int ticks, int maxEnemies, float latencyMs, float lossPercent)
 {
-    for (int i = 0; i < MAX_BULLETS; i++)
+    // Players don't die in the test, so it plays every tick
+    PLAYER_HEALTH = INT_MAX / 2;
+    MAX_ENEMIES = maxEnemies;
+
+    long long frames[2] = {0};
+    int previousScores[2] = {0};
+    GameScreen screens[2] = { GAMEPLAY, GAMEPLAY };
+    PowerUp powerups[2];
+    PlayerInput inputs[2] = {0};
+    GameTick games[2] = {0};
+    Snapshot states[2];
+    NetSession sessions[2];
+    uint64_t scripts[2] = { randomSeed ^ 0xA5A5A5A5ULL, randomSeed ^ 0x5A5A5A5AULL };
+    int scriptedTicks[2] = { -1, -1 };
+
+    // Both peers start out empty and closed, so a failure part way through setting them
+    // up can free them like the end of the test does
+    for (int p = 0; p < 2; p++)
+    {
+        initSnapshot(&states[p]);
+        sessions[p] = (NetSession){ 0 };
+        sessions[p].socket.handle = -1;
+    }
+    for (int p = 0; p < 2; p++)
     {
-        if (bullets[i] != NULL)
+        games[p] = (GameTick){
+            .player = initPlayer(),
+            .partner = initPlayer(),
+            .bullets = initBullets(),
+            .enemies = initEnemies(),
+            .grid = initGrid(worldWidth, worldHeight, GRID_CELL_SIZE, MAX_ENEMIES, ENEMY_SIZE),
+            .flow = initFlowField(worldWidth, worldHeight, FLOW_CELL_SIZE),
+            .flock = initFlock(worldWidth, worldHeight, MAX_ENEMIES),
+            .powerup = &powerups[p],
+            .frame = &frames[p],
+            .previousScore = &previousScores[p],
+            .currentScreen = &screens[p],
+        };
+        if (games[p].player == NULL || games[p].partner == NULL || games[p].bullets == NULL || games[p].enemies == NULL ||
+            games[p].grid == NULL || games[p].flow == NULL || games[p].flock == NULL)
         {
-            MemFree(bullets[i]);
+            TraceLog(LOG_ERROR, "Error initializing the net test");
+            unloadNetTest(games, states, sessions);
+            return 1;
         }
     }
-    for (int i = 0; i < MAX_ENEMIES; i++)
+
+    bool opened = hostNetSession(&sessions[0], 0, randomSeed) &&
+                  joinNetSession(&sessions[1], "127.0.0.1", getNetSocketPort(&sessions[0].socket));
+    for (int p = 0; p < 2 && opened; p++)
+    {
+        opened = setNetShim(&sessions[p].socket, latencyMs, latencyMs / 2, lossPercent, randomSeed + p);
+    }
+
+    // Shake hands on the simulated clock, then start both ends from the agreed seed
+    int frame = 0;
+    while (opened && !(sessions[0].connected && sessions[1].connected) && frame < 600)
     {
-        if (enemies[i] != NULL)
+        for (int p = 0; p < 2; p++)
         {
-            MemFree(enemies[i]);
+            pumpNetSession(&sessions[p], frame * TICK_TIME);
         }
+        frame++;
+    }
+    if (!opened || frame == 600)
+    {
+        TraceLog(LOG_ERROR, "The net test couldn't connect over loopback");
+        unloadNetTest(games, states, sessions);
+        return 1;
+    }
+    for (int p = 0; p < 2; p++)
+    {
+        startSession(games[p].player, games[p].partner, games[p].bullets, games[p].enemies, games[p].flow, games[p].powerup,
+                     games[p].frame, games[p].previousScore, sessions[p].seed);
+        saveSnapshot(&states[p], &games[p]);
+        sessions[p].lastTick = ticks;
     }
 
-    MemFree(bullets);
-    MemFree(enemies);
-    MemFree(player);
+    // Give up if a peer waits this long, the link is too lossy to finish
+    int frameLimit = frame + ticks * 4 + 600;
+    bool finished = false;
+    double start = getTimerSeconds();
+    while (!finished && frame < frameLimit)
+    {
+        finished = true;
+        for (int p = 0; p < 2; p++)
+        {
+            loadSnapshot(&states[p], &games[p]);
+
+            // Pick a new heading every half second and fire every few ticks, keyed to
+            // the tick the input is for. A stalled peer is asked for the same tick again
+            int t = sessions[p].localTick;
+            if (t != scriptedTicks[p] && t % 30 == 0)
+            {
+                inputs[p].up = splitMix64(&scripts[p]) & 1;
+                inputs[p].down = !inputs[p].up && (splitMix64(&scripts[p]) & 1);
+                inputs[p].left = splitMix64(&scripts[p]) & 1;
+                inputs[p].right = !inputs[p].left && (splitMix64(&scripts[p]) & 1);
+            }
+            if (t != scriptedTicks[p] && t % 4 == 0)
+            {
+                Rectangle view = getWorldView(getSessionFocus(games[p].player, games[p].partner, 1.0f));
+                inputs[p].fire = true;
+                inputs[p].aim = createVector2(view.x + splitMix64(&scripts[p]) % screenWidth, view.y + splitMix64(&scripts[p]) % screenHeight);
+            }
+            scriptedTicks[p] = t;
+
+            advanceNetSession(&sessions[p], &games[p], &inputs[p], runTick, frame * TICK_TIME);
+            saveSnapshot(&states[p], &games[p]);
+            finished = finished && sessions[p].tick == ticks && isNetSessionConfirmed(&sessions[p]);
+        }
+        frame++;
+    }
+    double elapsed = getTimerSeconds() - start;
+
+    uint32_t checksums[2];
+    for (int p = 0; p < 2; p++)
+    {
+        loadSnapshot(&states[p], &games[p]);
+        checksums[p] = checksumSession(&games[p]);
+    }
+    bool desynced = !finished || checksums[0] != checksums[1] || sessions[0].stats.desyncs > 0 || sessions[1].stats.desyncs > 0;
+
+    printf("seed: %llu\nthreads: %d\nticks: %d\nenemy cap: %d\nframes: %d\nlatency: %.0f ms +%.0f ms jitter\nloss: %.1f%%\n",
+           (unsigned long long)sessions[0].seed, jobSystem.threadCount, ticks, maxEnemies, frame, latencyMs, latencyMs / 2, lossPercent);
+    printf("elapsed: %.3f s\nframe budget: %.3f ms\n", elapsed, TICK_TIME * 1000.0);
+    for (int p = 0; p < 2; p++)
+    {
+        NetStats *stats = &sessions[p].stats;
+        printf("%s:\n", (p == 0)? "host" : "guest");
+        printf("  ticks: %d\n  packets: %d sent %d received\n", sessions[p].tick, stats->packetsSent, stats->packetsReceived);
+        printf("  snapshot: %zu bytes\n", stats->snapshotBytes);
+        printf("  save: %.2f us avg %.2f us max over %d\n",
+               (stats->saves > 0)? stats->saveSeconds * 1e6 / stats->saves : 0.0, stats->maxSaveSeconds * 1e6, stats->saves);
+        printf("  load: %.2f us avg %.2f us max over %d\n",
+               (stats->loads > 0)? stats->loadSeconds * 1e6 / stats->loads : 0.0, stats->maxLoadSeconds * 1e6, stats->loads);
+        printf("  rollbacks: %d, %d ticks simulated again, %d at most\n", stats->rollbacks, stats->resimulatedTicks, stats->maxRollback);
+        printf("  rollback cost: %.3f ms avg %.3f ms max, %d over budget\n",
+               (stats->rollbacks > 0)? stats->rollbackSeconds * 1000.0 / stats->rollbacks : 0.0,
+               stats->maxRollbackSeconds * 1000.0, stats->overBudget);
+        printf("  stalls: %d\n  checksums compared: %d, %d desynced\n", stats->stalls, stats->checksumsCompared, stats->desyncs);
+        printf("  checksum: %08x\n", checksums[p]);
+    }
+    printf("result: %s\n", !finished? "UNFINISHED" : desynced? "DESYNC" : "in sync");
+
+    unloadNetTest(games, states, sessions);
+    return desynced? 1 : 0;
+}
+
+// Closes both peers of the net test and frees their games and snapshots
+void unloadNetTest(GameTick *games, Snapshot *states, NetSession *sessions)
+{
+    for (int p = 0; p < 2; p++)
+    {
+        closeNetSession(&sessions[p]);
+        unloadSnapshot(&states[p]);
+        MemFree(games[p].partner);
+        cleanupEntities(games[p].bullets, games[p].enemies, games[p].grid, games[p].flow, games[p].flock, games[p].player);
+    }
 }
+
+// Times iterations calls of a movement kernel over count entities, in nanoseconds per entity
+#define TIME_KERNEL(result, iterations, count, call) \
+    { \
+        double kernelStart = getTimerSeconds(); \
+        for (int it = 0; it < (iterations); it++) { call; } \
+        result = (getTimerSeconds() - kernelStart) * 1e9 / ((double)(iterations) * (count)); \
+    }
+
+/**
+ * @brief Microbenchmark of the movement kernels. Compares the old scalar path, one
+ * Entity at a time through raymath, against the scalar and SIMD kernels running over
+ * the pool's columns, and checks that the two kernels agree bit for bit.
+ *
+ * @param count The number of entities
+ * @param iterations The number of ticks to time
+ * @return int The process exit code
+ */
+int runSteeringBenchmark(int count, int iterations)
+{
+    Entity *entities = MemAlloc(sizeof(Entity) * count);
+    EntityPool *scalar = initPool(count, ARCHETYPE_ENEMY);
+    EntityPool *simd = initPool(count, ARCHETYPE_ENEMY);
+    if (entities == NULL || scalar == NULL || simd == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error initializing the steering benchmark");
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        Entity *entity = &entities[i];
+        entity->body = (Rectangle){ randomInt(RANDOM_SPAWN, 0, screenWidth), randomInt(RANDOM_SPAWN, 0, screenHeight), ENEMY_SIZE, ENEMY_SIZE };
+        entity->speed = randomInt(RANDOM_SPAWN, 1, 5);
+        entity->direction = Vector2Normalize((Vector2){ randomFloat(RANDOM_SPAWN) - 0.5f, randomFloat(RANDOM_SPAWN) - 0.5f });
+
+        EntityPool *pools[2] = { scalar, simd };
+        for (int p = 0; p < 2; p++)
+        {
+            spawnEntity(pools[p], count);
+            pools[p]->x[i] = entity->body.x;
+            pools[p]->y[i] = entity->body.y;
+            pools[p]->width[i] = pools[p]->height[i] = ENEMY_SIZE;
+            pools[p]->speed[i] = entity->speed;
+            pools[p]->directionX[i] = entity->direction.x;
+            pools[p]->directionY[i] = entity->direction.y;
+        }
+    }
+
+    playerV = createVector2(screenWidth / 2, screenHeight / 2);
+    double chaseEntity, chaseScalar, chaseSimd;
+    double advanceEntity, advanceScalar, advanceSimd;
+
+    TIME_KERNEL(chaseEntity, iterations, count, for (int i = 0; i < count; i++) updateEnemy(&entities[i]));
+    TIME_KERNEL(chaseScalar, iterations, count, chaseTargetScalar(scalar, 0, count, playerV));
+    TIME_KERNEL(chaseSimd, iterations, count, chaseTarget(simd, 0, count, playerV));
+    TIME_KERNEL(advanceEntity, iterations, count, for (int i = 0; i < count; i++) updateBullet(&entities[i]));
+    TIME_KERNEL(advanceScalar, iterations, count, advanceEntitiesScalar(scalar, 0, count));
+    TIME_KERNEL(advanceSimd, iterations, count, advanceEntities(simd, 0, count));
+
+    bool match = true;
+    for (int i = 0; i < count && match; i++)
+    {
+        match = (scalar->x[i] == simd->x[i]) && (scalar->y[i] == simd->y[i]) &&
+                (scalar->directionX[i] == simd->directionX[i]) && (scalar->directionY[i] == simd->directionY[i]);
+    }
+
+    printf("entities: %d\niterations: %d\nbackend: %s\n", count, iterations, steeringBackend);
+    printf("%-8s %14s %14s %14s %10s\n", "kernel", "Entity ns", "scalar ns", "simd ns", "speedup");
+    printf("%-8s %14.3f %14.3f %14.3f %9.2fx\n", "chase", chaseEntity, chaseScalar, chaseSimd, chaseEntity / chaseSimd);
+    printf("%-8s %14.3f %14.3f %14.3f %9.2fx\n", "advance", advanceEntity, advanceScalar, advanceSimd, advanceEntity / advanceSimd);
+    printf("simd matches scalar: %s\n", match? "yes" : "NO");
+
+    MemFree(entities);
+    unloadPool(scalar);
+    unloadPool(simd);
+
+    return match? 0 : 1;
+}
+
+#undef TIME_KERNEL
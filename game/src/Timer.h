@@ -0,0 +1,139 @@
+/**
+ * @file Timer.h
+ * @author Kevin Pluas
+ * @brief High resolution timer and per phase timings
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include <stdbool.h>
+
+// GetTime() needs a window, so the timer talks to the OS directly. That way the
+// headless simulation can be timed too.
+#if defined(_WIN32)
+    int __stdcall QueryPerformanceCounter(unsigned long long int *lpPerformanceCount);
+    int __stdcall QueryPerformanceFrequency(unsigned long long int *lpFrequency);
+#else
+    #include <time.h>
+#endif
+
+/**
+ * @brief The parts of a frame that can be timed. The simulation tick phases come first
+ * so the headless report can stop at TICK_PHASE_COUNT.
+ *
+ */
+typedef enum ProfilePhase
+{
+    // Simulation tick, may run several times per frame
+    PHASE_MOVE_PLAYER = 0,
+    PHASE_SPAWN,
+    PHASE_UPDATE_ENEMIES,
+    PHASE_UPDATE_BULLETS,
+    PHASE_BULLET_BOUNDS,
+    PHASE_COLLISIONS,
+    PHASE_FLOW_FIELD,
+    PHASE_FLOCKING,
+    PHASE_PARTICLES,
+    // Rendered frame
+    PHASE_INPUT,
+    PHASE_RENDER,           // Building the frame, including the instanced sprite draws
+    PHASE_FLUSH,            // rlDrawRenderBatchActive() for whatever is still queued
+    PHASE_PRESENT,          // EndDrawing(): SwapScreenBuffer(), the frame limiter and input polling
+    PHASE_COUNT,
+} ProfilePhase;
+
+#define TICK_PHASE_COUNT PHASE_INPUT
+
+const char *phaseNames[PHASE_COUNT] = {
+    "movePlayer",
+    "spawn",
+    "updateEnemies",
+    "updateBullets",
+    "checkBulletCollisions",
+    "checkCollisions",
+    "stepFlowField",
+    "computeFlocking",
+    "updateParticles",
+    "input",
+    "render",
+    "rlDrawRenderBatch",
+    "SwapScreenBuffer",
+};
+
+bool phaseTimingEnabled = false;        // Phases are only timed when this is set
+double phaseStart[PHASE_COUNT] = {0};
+double phaseSeconds[PHASE_COUNT] = {0}; // Total time spent in each phase since the last reset
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+double getTimerSeconds();
+
+static inline void beginPhase(ProfilePhase phase);
+static inline void endPhase(ProfilePhase phase);
+void resetPhaseTimings();
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+// Returns a monotonic time in seconds
+double getTimerSeconds()
+{
+#if defined(_WIN32)
+    static unsigned long long int clockFrequency = 0;
+    unsigned long long int currentTime = 0;
+
+    if (clockFrequency == 0)
+    { // Querying the frequency is costly and it never changes
+        QueryPerformanceFrequency(&clockFrequency);
+    }
+    QueryPerformanceCounter(&currentTime);
+
+    return (double)currentTime / clockFrequency;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
+
+// Marks the start of a phase. Defining SWARM_NO_PROFILER compiles phase timing out,
+// otherwise a disabled timer costs one predictable branch
+static inline void beginPhase(ProfilePhase phase)
+{
+#if !defined(SWARM_NO_PROFILER)
+    if (phaseTimingEnabled)
+    {
+        phaseStart[phase] = getTimerSeconds();
+    }
+#endif
+}
+
+// Adds the time since beginPhase() to the phase's total
+static inline void endPhase(ProfilePhase phase)
+{
+#if !defined(SWARM_NO_PROFILER)
+    if (phaseTimingEnabled)
+    {
+        phaseSeconds[phase] += getTimerSeconds() - phaseStart[phase];
+    }
+#endif
+}
+
+// Zeroes every phase total
+void resetPhaseTimings()
+{
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+        phaseSeconds[i] = 0.0;
+    }
+}
+#endif
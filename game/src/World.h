@@ -0,0 +1,276 @@
+/**
+ * @file World.h
+ * @author Kevin Pluas
+ * @brief The camera that follows the player around the world, and the floor streamed
+ * in chunks around it
+ * @version 0.1
+ * @date 2024-03-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _WORLD_H
+#define _WORLD_H
+
+#include <math.h>
+
+#include "Structs.h"
+#include "Globals.h"
+#include "Random.h"
+#include "Atlas.h"
+
+#define FLOOR_CHUNK_SIZE 512        // Pixels along each side of a floor chunk
+#define FLOOR_TILES_PER_CHUNK 2     // Floor tiles along each side of a chunk
+#define FLOOR_CHUNK_MARGIN 256      // Chunks this close to the view are kept, and drawn ahead of time
+#define FLOOR_PREFETCH_PER_FRAME 1  // Chunks in the margin drawn per frame. Chunks in view are always drawn at once
+
+Camera2D worldCamera = { 0 };  // The camera of the last frame rendered, used to aim in world space
+Floor worldFloor = { 0 };      // The floor under the world
+
+//----------------------------------------------------------------------------------
+// Function Declarations
+//----------------------------------------------------------------------------------
+Rectangle getWorldView(Vector2 focus);
+Camera2D getWorldCamera(Vector2 focus);
+
+bool initFloor(Floor *floor);
+void streamFloor(Floor *floor, Rectangle view);
+void drawFloor(Floor *floor, Rectangle view);
+size_t getFloorBytes(Floor *floor);
+void unloadFloor(Floor *floor);
+
+//----------------------------------------------------------------------------------
+// Function Definitions
+//----------------------------------------------------------------------------------
+
+/**
+ * @brief Finds the part of the world on screen when the camera follows focus. The view
+ * stops at the edges of the world instead of showing what is past them. Only depends
+ * on focus, so the simulation can use it as well as the renderer.
+ *
+ * @param focus Point the camera is centred on, when it isn't near an edge
+ * @return Rectangle The screen sized area of the world in view
+ */
+Rectangle getWorldView(Vector2 focus)
+{
+    float x = Clamp(focus.x - screenWidth / 2.0f, 0.0f, (float)(worldWidth - screenWidth));
+    float y = Clamp(focus.y - screenHeight / 2.0f, 0.0f, (float)(worldHeight - screenHeight));
+    return (Rectangle){ x, y, screenWidth, screenHeight };
+}
+
+// The camera that shows getWorldView(focus)
+Camera2D getWorldCamera(Vector2 focus)
+{
+    Rectangle view = getWorldView(focus);
+    return (Camera2D){
+        .offset = { screenWidth / 2.0f, screenHeight / 2.0f },
+        .target = { view.x + view.width / 2.0f, view.y + view.height / 2.0f },
+        .rotation = 0.0f,
+        .zoom = 1.0f,
+    };
+}
+
+// The chunks overlapping area, clamped to the world
+static inline void getFloorChunks(Rectangle area, int *minColumn, int *minRow, int *maxColumn, int *maxRow)
+{
+    *minColumn = Clamp((int)floorf(area.x / FLOOR_CHUNK_SIZE), 0, (worldWidth - 1) / FLOOR_CHUNK_SIZE);
+    *minRow = Clamp((int)floorf(area.y / FLOOR_CHUNK_SIZE), 0, (worldHeight - 1) / FLOOR_CHUNK_SIZE);
+    *maxColumn = Clamp((int)floorf((area.x + area.width) / FLOOR_CHUNK_SIZE), 0, (worldWidth - 1) / FLOOR_CHUNK_SIZE);
+    *maxRow = Clamp((int)floorf((area.y + area.height) / FLOOR_CHUNK_SIZE), 0, (worldHeight - 1) / FLOOR_CHUNK_SIZE);
+}
+
+/**
+ * @brief Allocates the floor's chunk slots. There are enough for every chunk a screen
+ * sized view and its margin can overlap, whatever the size of the world. Needs the
+ * window and the sprite atlas.
+ *
+ * @param floor
+ * @return true if every slot was allocated
+ */
+bool initFloor(Floor *floor)
+{
+    *floor = (Floor){ 0 };
+    int columns = (screenWidth + 2 * FLOOR_CHUNK_MARGIN + FLOOR_CHUNK_SIZE - 1) / FLOOR_CHUNK_SIZE + 1;
+    int rows = (screenHeight + 2 * FLOOR_CHUNK_MARGIN + FLOOR_CHUNK_SIZE - 1) / FLOOR_CHUNK_SIZE + 1;
+
+    floor->chunks = MemAlloc(sizeof(FloorChunk) * columns * rows);
+    if (floor->chunks == NULL)
+    {
+        TraceLog(LOG_ERROR, "Error initializing the floor");
+        return false;
+    }
+
+    for (floor->slotCount = 0; floor->slotCount < columns * rows; floor->slotCount++)
+    {
+        RenderTexture2D target = LoadRenderTexture(FLOOR_CHUNK_SIZE, FLOOR_CHUNK_SIZE);
+        if (target.id == 0)
+        {
+            TraceLog(LOG_ERROR, "Error initializing floor chunk %d", floor->slotCount);
+            unloadFloor(floor);
+            return false;
+        }
+        floor->chunks[floor->slotCount].target = target;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Draws the chunk at column, row into chunk's texture. Every tile is turned and
+ * shaded by a hash of where it is, so the floor doesn't repeat every tile, and a chunk
+ * drawn again after being evicted looks the same as before.
+ *
+ * @param chunk
+ * @param column
+ * @param row
+ */
+static void generateFloorChunk(FloorChunk *chunk, int column, int row)
+{
+    const float tileSize = (float)FLOOR_CHUNK_SIZE / FLOOR_TILES_PER_CHUNK;
+
+    BeginTextureMode(chunk->target);
+    for (int ty = 0; ty < FLOOR_TILES_PER_CHUNK; ty++)
+    {
+        for (int tx = 0; tx < FLOOR_TILES_PER_CHUNK; tx++)
+        {
+            uint64_t state = ((uint64_t)(uint32_t)(column * FLOOR_TILES_PER_CHUNK + tx) << 32) |
+                             (uint32_t)(row * FLOOR_TILES_PER_CHUNK + ty);
+            uint64_t hash = splitMix64(&state);
+
+            Rectangle source = floorSprite;
+            if (hash & 4)
+            {
+                source.width = -source.width;
+            }
+            unsigned char shade = 225 + (hash >> 8) % 31;
+
+            drawAtlasSprite(source,
+                            (Rectangle){ (tx + 0.5f) * tileSize, (ty + 0.5f) * tileSize, tileSize, tileSize },
+                            (Vector2){ tileSize / 2, tileSize / 2 },
+                            90.0f * (hash & 3),
+                            (Color){ shade, shade, shade, 255 });
+        }
+    }
+    EndTextureMode();
+
+    chunk->column = column;
+    chunk->row = row;
+    chunk->loaded = true;
+}
+
+// Returns the slot holding the chunk at column, row, or NULL if it isn't loaded
+static FloorChunk *findFloorChunk(Floor *floor, int column, int row)
+{
+    for (int i = 0; i < floor->slotCount; i++)
+    {
+        if (floor->chunks[i].loaded && floor->chunks[i].column == column && floor->chunks[i].row == row)
+        {
+            return &floor->chunks[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Brings the floor up to date with the view. Chunks that drifted out of the
+ * margin around the view are evicted, chunks in view are drawn straight away, and up to
+ * FLOOR_PREFETCH_PER_FRAME chunks in the margin are drawn ahead of the camera. Call it
+ * before BeginMode2D(), since drawing a chunk resets the camera.
+ *
+ * @param floor
+ * @param view Area of the world about to be drawn
+ */
+void streamFloor(Floor *floor, Rectangle view)
+{
+    Rectangle kept = { view.x - FLOOR_CHUNK_MARGIN, view.y - FLOOR_CHUNK_MARGIN,
+                       view.width + 2 * FLOOR_CHUNK_MARGIN, view.height + 2 * FLOOR_CHUNK_MARGIN };
+    int minColumn, minRow, maxColumn, maxRow;
+    getFloorChunks(kept, &minColumn, &minRow, &maxColumn, &maxRow);
+
+    for (int i = 0; i < floor->slotCount; i++)
+    {
+        FloorChunk *chunk = &floor->chunks[i];
+        if (chunk->loaded && (chunk->column < minColumn || chunk->column > maxColumn ||
+                              chunk->row < minRow || chunk->row > maxRow))
+        {
+            chunk->loaded = false;
+            floor->evicted++;
+        }
+    }
+
+    // initFloor() sized the slots so every chunk in the margin fits once the rest are evicted
+    int prefetch = FLOOR_PREFETCH_PER_FRAME;
+    int slot = 0;
+    for (int row = minRow; row <= maxRow; row++)
+    {
+        for (int column = minColumn; column <= maxColumn; column++)
+        {
+            if (findFloorChunk(floor, column, row) != NULL)
+            {
+                continue;
+            }
+
+            Rectangle area = { (float)column * FLOOR_CHUNK_SIZE, (float)row * FLOOR_CHUNK_SIZE, FLOOR_CHUNK_SIZE, FLOOR_CHUNK_SIZE };
+            if (!CheckCollisionRecs(area, view))
+            {
+                if (prefetch == 0)
+                {
+                    continue;
+                }
+                prefetch--;
+            }
+
+            while (slot < floor->slotCount && floor->chunks[slot].loaded)
+            {
+                slot++;
+            }
+            if (slot == floor->slotCount)
+            {
+                return;
+            }
+            generateFloorChunk(&floor->chunks[slot], column, row);
+            floor->generated++;
+        }
+    }
+}
+
+/**
+ * @brief Draws the loaded chunks overlapping view. Call it between BeginMode2D() and
+ * EndMode2D().
+ *
+ * @param floor
+ * @param view Area of the world on screen
+ */
+void drawFloor(Floor *floor, Rectangle view)
+{
+    for (int i = 0; i < floor->slotCount; i++)
+    {
+        FloorChunk *chunk = &floor->chunks[i];
+        Rectangle area = { (float)chunk->column * FLOOR_CHUNK_SIZE, (float)chunk->row * FLOOR_CHUNK_SIZE, FLOOR_CHUNK_SIZE, FLOOR_CHUNK_SIZE };
+        if (chunk->loaded && CheckCollisionRecs(area, view))
+        {
+            // Render textures are stored upside down
+            DrawTextureRec(chunk->target.texture, (Rectangle){ 0, 0, FLOOR_CHUNK_SIZE, -FLOOR_CHUNK_SIZE },
+                           (Vector2){ area.x, area.y }, WHITE);
+        }
+    }
+}
+
+// Returns how many bytes of video memory the floor's slots take
+size_t getFloorBytes(Floor *floor)
+{
+    return (size_t)floor->slotCount * FLOOR_CHUNK_SIZE * FLOOR_CHUNK_SIZE * 4;
+}
+
+// Frees the floor's slots and zeroes floor
+void unloadFloor(Floor *floor)
+{
+    for (int i = 0; i < floor->slotCount; i++)
+    {
+        UnloadRenderTexture(floor->chunks[i].target);
+    }
+    MemFree(floor->chunks);
+    *floor = (Floor){ 0 };
+}
+#endif
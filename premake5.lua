@@ -13,6 +13,12 @@ newoption
     default = "opengl33"
 }
 
+newoption
+{
+    trigger = "track-memory",
+    description = "build raylib and the game with the tracking allocator, F5 shows what each module holds"
+}
+
 function string.starts(String,Start)
     return string.sub(String,1,string.len(Start))==Start
 end
@@ -67,6 +73,10 @@ workspace (workspaceName)
         defines { "NDEBUG" }
         optimize "On"
 
+    -- Every project has to take the hooks, see game/src/MemoryHooks.h
+    filter "options:track-memory"
+        forceincludes { path.getabsolute("game/src/MemoryHooks.h") }
+
     filter { "platforms:x64" }
         architecture "x86_64"
 		